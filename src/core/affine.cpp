@@ -0,0 +1,27 @@
+#include "affine.h"
+
+static_assert(sizeof(glm::mat4x3) == 12 * sizeof(float), "affine transforms are stored as 12 packed floats");
+
+glm::mat4x3 composeTRS(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+    float xx = rotation.x * rotation.x, yy = rotation.y * rotation.y, zz = rotation.z * rotation.z;
+    float xy = rotation.x * rotation.y, xz = rotation.x * rotation.z, yz = rotation.y * rotation.z;
+    float wx = rotation.w * rotation.x, wy = rotation.w * rotation.y, wz = rotation.w * rotation.z;
+
+    // Same layout as glm::mat3_cast, each column scaled
+    glm::mat4x3 res;
+    res[0] = glm::vec3(1.f - 2.f * (yy + zz), 2.f * (xy + wz), 2.f * (xz - wy)) * scale.x;
+    res[1] = glm::vec3(2.f * (xy - wz), 1.f - 2.f * (xx + zz), 2.f * (yz + wx)) * scale.y;
+    res[2] = glm::vec3(2.f * (xz + wy), 2.f * (yz - wx), 1.f - 2.f * (xx + yy)) * scale.z;
+    res[3] = translation;
+    return res;
+}
+
+glm::mat4x3 concatAffine(const glm::mat4x3& a, const glm::mat4x3& b)
+{
+    glm::mat4x3 res;
+    for (int column = 0; column < 4; column++)
+        res[column] = a[0] * b[column].x + a[1] * b[column].y + a[2] * b[column].z;
+    res[3] += a[3];
+    return res;
+}
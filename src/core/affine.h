@@ -0,0 +1,27 @@
+#ifndef AFFINE_H
+#define AFFINE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/*
+* Affine transforms stored as glm::mat4x3 (rotation/scale columns, then translation),
+* the implicit last row being (0, 0, 0, 1)
+*/
+
+/*
+* Translation * rotation * scale written directly, the scale folded into the rotation columns
+*/
+glm::mat4x3 composeTRS(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+
+/*
+* a * b as affine transforms
+*/
+glm::mat4x3 concatAffine(const glm::mat4x3& a, const glm::mat4x3& b);
+
+inline glm::mat4 affineToMat4(const glm::mat4x3& m)
+{
+    return glm::mat4(glm::vec4(m[0], 0.f), glm::vec4(m[1], 0.f), glm::vec4(m[2], 0.f), glm::vec4(m[3], 1.f));
+}
+
+#endif // AFFINE_H
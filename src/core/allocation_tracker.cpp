@@ -0,0 +1,127 @@
+#include "allocation_tracker.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#ifdef ANIMATION_TRACK_ALLOCATIONS
+static std::atomic<unsigned long long> allocationCount(0);
+static std::atomic<unsigned long long> allocationBytes(0);
+
+static void* countedAllocate(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new(std::size_t size)
+{
+    void* ptr = countedAllocate(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+    void* ptr = countedAllocate(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+bool AllocationTracker::available()
+{
+    return true;
+}
+
+unsigned long long AllocationTracker::allocations()
+{
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+unsigned long long AllocationTracker::bytes()
+{
+    return allocationBytes.load(std::memory_order_relaxed);
+}
+#else
+bool AllocationTracker::available()
+{
+    return false;
+}
+
+unsigned long long AllocationTracker::allocations()
+{
+    return 0;
+}
+
+unsigned long long AllocationTracker::bytes()
+{
+    return 0;
+}
+#endif
+
+AllocationTracker::AllocationTracker(unsigned int warmupFrames) : _warmupFrames(warmupFrames), _frame(0),
+    _startAllocations(0), _startBytes(0), _frameAllocations(0)
+{
+
+}
+
+void AllocationTracker::beginFrame()
+{
+    this->_startAllocations = allocations();
+    this->_startBytes = bytes();
+}
+
+void AllocationTracker::endFrame()
+{
+    this->_frameAllocations = allocations() - this->_startAllocations;
+    unsigned long long frameBytes = bytes() - this->_startBytes;
+    this->_frame++;
+
+    if (this->_frame <= this->_warmupFrames || this->_frameAllocations == 0)
+        return;
+
+    std::cout << "WARNING::ALLOCATION_TRACKER::FRAME " << this->_frame << " made " << this->_frameAllocations
+        << " allocations (" << frameBytes << " bytes)" << std::endl;
+#ifdef ANIMATION_ASSERT_NO_ALLOCATIONS
+    std::abort();
+#endif
+}
+
+void AllocationTracker::restartWarmup()
+{
+    this->_frame = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+/*
+* Heap allocation counting through a replaced global operator new, compiled in with
+* ANIMATION_TRACK_ALLOCATIONS (counts stay at 0 otherwise). Frames after the warm-up
+* are expected not to allocate: they are reported, and abort the program when
+* ANIMATION_ASSERT_NO_ALLOCATIONS is also defined
+*/
+class AllocationTracker
+{
+public:
+    AllocationTracker(unsigned int warmupFrames = 60);
+
+    static bool available();
+
+    /*
+    * Totals since startup, across all threads
+    */
+    static unsigned long long allocations();
+    static unsigned long long bytes();
+
+    void beginFrame();
+    void endFrame();
+
+    /*
+    * Starts a new warm-up, for frames that legitimately allocate (mode switch, reload)
+    */
+    void restartWarmup();
+
+    inline unsigned long long frameAllocations() const { return this->_frameAllocations; }
+private:
+    unsigned int _warmupFrames;
+    unsigned int _frame;
+
+    unsigned long long _startAllocations;
+    unsigned long long _startBytes;
+    unsigned long long _frameAllocations;
+};
+
+#endif // ALLOCATION_TRACKER_H
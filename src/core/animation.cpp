@@ -0,0 +1,88 @@
+#include "animation.h"
+
+#include <atomic>
+#include <iostream>
+
+static RotationInterpolation DEFAULT_INTERPOLATION = RotationInterpolation::Slerp;
+// Clips are decoded from jobs, 0 is left for "no clip"
+static std::atomic<unsigned int> NEXT_REVISION(1);
+
+Animation::Revision::Revision() : value(NEXT_REVISION++)
+{
+
+}
+
+Animation::Revision::Revision(const Revision&) : value(NEXT_REVISION++)
+{
+
+}
+
+Animation::Revision& Animation::Revision::operator=(const Revision&)
+{
+	next();
+	return *this;
+}
+
+void Animation::Revision::next()
+{
+	value = NEXT_REVISION++;
+}
+
+Animation::Animation() : _duration(0.0f), _ticksPerSecond(20.0f), _interpolation(RotationInterpolation::Slerp),
+	_hasInterpolation(false), _additive(false), _boneKeyFrames({})
+{
+
+}
+
+RotationInterpolation Animation::defaultInterpolation()
+{
+	return DEFAULT_INTERPOLATION;
+}
+
+void Animation::setDefaultInterpolation(RotationInterpolation mode)
+{
+	DEFAULT_INTERPOLATION = mode;
+}
+
+void Animation::addBoneKeyFrame(std::string boneName, KeyFrame keyFrame)
+{
+	_boneKeyFrames[boneName].push_back(keyFrame);
+	_revision.next();
+}
+
+const std::vector<KeyFrame>& Animation::getBoneKeyFrames(const std::string& boneName) const
+{
+	static const std::vector<KeyFrame> NO_KEY_FRAMES;
+
+	std::unordered_map<std::string, std::vector<KeyFrame>>::const_iterator it = _boneKeyFrames.find(boneName);
+	return it == _boneKeyFrames.end() ? NO_KEY_FRAMES : it->second;
+}
+bool Animation::makeAdditive(const ReferencePose& reference)
+{
+	if (_additive)
+		return false;
+
+	for (std::unordered_map<std::string, std::vector<KeyFrame>>::iterator it = _boneKeyFrames.begin(); it != _boneKeyFrames.end();) {
+		ReferencePose::const_iterator base = reference.find(it->first);
+		if (base == reference.end()) {
+			std::cout << "WARNING::ANIMATION::NO_REFERENCE " << it->first << " in " << _name << ", track dropped" << std::endl;
+			it = _boneKeyFrames.erase(it);
+			continue;
+		}
+
+		// Inverse of the delta addLocalPose applies: base * delta on rotations, base * ratio on scales
+		const Transformation& ref = base->second;
+		glm::quat inverseRotation = glm::inverse(glm::normalize(ref.rotation()));
+		for (KeyFrame& keyFrame : it->second) {
+			Transformation& transform = keyFrame.transform;
+			transform.position() -= ref.position();
+			transform.rotation() = glm::normalize(inverseRotation * transform.rotation());
+			for (int axis = 0; axis < 3; axis++)
+				transform.scale()[axis] = ref.scale()[axis] != 0.f ? transform.scale()[axis] / ref.scale()[axis] : 1.f;
+		}
+		++it;
+	}
+	_additive = true;
+	_revision.next();
+	return true;
+}
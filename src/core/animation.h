@@ -0,0 +1,89 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bone.h"
+#include "keyframe.h"
+#include "transformation.h"
+
+/*
+* Local transform of each bone by name, e.g. the bind pose or one frame of a clip
+*/
+typedef std::unordered_map<std::string, Transformation> ReferencePose;
+
+class Animation {
+public:
+    Animation();
+
+    inline const std::string& name() const { return this->_name; }
+    inline void setName(const std::string& name) { this->_name = name; }
+    inline const float& duration() const { return this->_duration; }
+    inline void setDuration(const float& duration) { this->_duration = duration; }
+    inline const float& TPS() const { return this->_ticksPerSecond; }
+    inline void setTPS(const float& ticksPerSecond) { this->_ticksPerSecond = ticksPerSecond; }
+
+    /*
+    * Rotation interpolation of this clip, the global default unless set
+    */
+    inline RotationInterpolation interpolation() const { return _hasInterpolation ? _interpolation : defaultInterpolation(); }
+    inline void setInterpolation(RotationInterpolation mode) { _interpolation = mode; _hasInterpolation = true; }
+    inline void resetInterpolation() { _hasInterpolation = false; }
+
+    /*
+    * Additive clips store each key as a delta from a reference pose: translation offset,
+    * rotation applied on the local side and scale ratio. They are played as BlendMode::Additive layers
+    */
+    inline bool additive() const { return this->_additive; }
+    inline void setAdditive(bool additive) { this->_additive = additive; }
+
+    /*
+    * Turns the keys into deltas from the reference, once. Tracks of bones the reference does
+    * not have are dropped, false when the clip already is additive
+    */
+    bool makeAdditive(const ReferencePose& reference);
+
+    static RotationInterpolation defaultInterpolation();
+    static void setDefaultInterpolation(RotationInterpolation mode);
+
+    void addBoneKeyFrame(std::string, KeyFrame);
+
+    /*
+    * Keys of the bone, empty when the clip does not animate it
+    */
+    const std::vector<KeyFrame>& getBoneKeyFrames(const std::string& boneName) const;
+
+    inline const std::unordered_map<std::string, std::vector<KeyFrame>>& boneKeyFrames() const { return this->_boneKeyFrames; }
+
+    /*
+    * Changes with every clip created or copied and every change to its tracks, and is never
+    * given twice: a cache keyed on it notices a clip freed and another allocated at its address
+    */
+    inline unsigned int revision() const { return this->_revision.value; }
+private:
+    // Takes a new value when constructed, copied or assigned, so the default copy of Animation stays right
+    struct Revision
+    {
+        Revision();
+        Revision(const Revision&);
+        Revision& operator=(const Revision&);
+        void next();
+
+        unsigned int value;
+    };
+
+    std::string _name;
+    float _duration;
+    float _ticksPerSecond;
+
+    RotationInterpolation _interpolation;
+    bool _hasInterpolation;
+    bool _additive;
+
+    std::unordered_map<std::string, std::vector<KeyFrame>> _boneKeyFrames;
+    Revision _revision;
+};
+
+#endif // ANIMATION_H
\ No newline at end of file
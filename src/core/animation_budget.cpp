@@ -0,0 +1,97 @@
+#include "animation_budget.h"
+
+#include <algorithm>
+
+AnimationBudget::AnimationBudget(unsigned int maxUpdatesPerFrame) :
+    _tiers({ { 10.0f, 1 }, { 25.0f, 2 }, { 50.0f, 4 }, { 100.0f, 8 } }), _instances({}),
+    _maxUpdatesPerFrame(maxUpdatesPerFrame), _updatesThisFrame(0), _reservedThisFrame(0), _frame(0)
+{
+
+}
+
+unsigned int AnimationBudget::add()
+{
+    Instance instance;
+    // Never updated, the first visible frame always evaluates it
+    instance.lastUpdate = this->_frame - 1000;
+    instance.tier = 0;
+    instance.deferred = false;
+    instance.reserved = false;
+
+    this->_instances.push_back(instance);
+    return (unsigned int)this->_instances.size() - 1;
+}
+
+void AnimationBudget::beginFrame()
+{
+    this->_frame++;
+    this->_updatesThisFrame = 0;
+
+    this->_waiting.clear();
+    for (unsigned int i = 0; i < this->_instances.size(); i++) {
+        this->_instances[i].reserved = false;
+        if (this->_instances[i].deferred)
+            this->_waiting.push_back(i);
+    }
+
+    // Without a priority, the low handles would take the whole cap every frame and starve the others
+    unsigned int reserved = std::min((unsigned int)this->_waiting.size(), this->_maxUpdatesPerFrame);
+    if (reserved < this->_waiting.size()) {
+        const unsigned int frame = this->_frame;
+        const std::vector<Instance>& instances = this->_instances;
+        std::nth_element(this->_waiting.begin(), this->_waiting.begin() + reserved, this->_waiting.end(),
+            [frame, &instances](unsigned int a, unsigned int b) {
+                return frame - instances[a].lastUpdate > frame - instances[b].lastUpdate;
+            });
+    }
+    for (unsigned int i = 0; i < reserved; i++)
+        this->_instances[this->_waiting[i]].reserved = true;
+    this->_reservedThisFrame = reserved;
+}
+
+bool AnimationBudget::shouldUpdate(unsigned int handle, float distance, bool visible)
+{
+    Instance& instance = this->_instances[handle];
+    // The reservation is given back whatever the outcome, an update it lets through counts as usual
+    bool reserved = instance.reserved;
+    if (reserved) {
+        instance.reserved = false;
+        this->_reservedThisFrame--;
+    }
+
+    if (!visible)
+    {
+        instance.tier = (unsigned int)this->_tiers.size();
+        instance.deferred = false;
+        return false;
+    }
+
+    instance.tier = 0;
+    while (instance.tier + 1 < this->_tiers.size() && distance >= this->_tiers[instance.tier].distance)
+        instance.tier++;
+
+    unsigned int period = this->_tiers.empty() ? 1 : this->_tiers[instance.tier].period;
+    unsigned int age = this->_frame - instance.lastUpdate;
+
+    // Instances sharing a period are spread over its frames by handle, the ones
+    // that missed their slot (budget exhausted, tier change) go as soon as possible
+    bool slot = (this->_frame + handle) % period == 0;
+    if (age < period || (!slot && age < 2 * period))
+    {
+        instance.deferred = false;
+        return false;
+    }
+
+    // Over budget, counting the updates kept for the instances turned down earlier:
+    // the instance stays due and gets a reservation on the next frames
+    if (!reserved && this->_updatesThisFrame + this->_reservedThisFrame >= this->_maxUpdatesPerFrame)
+    {
+        instance.deferred = true;
+        return false;
+    }
+
+    instance.deferred = false;
+    instance.lastUpdate = this->_frame;
+    this->_updatesThisFrame++;
+    return true;
+}
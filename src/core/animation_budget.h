@@ -0,0 +1,80 @@
+#ifndef ANIMATION_BUDGET_H
+#define ANIMATION_BUDGET_H
+
+#include <vector>
+
+/*
+* Decides which animated instances evaluate their pose on a given frame.
+* Each instance gets an update period from its distance to the camera (full rate
+* when close, a fraction of it further away, frozen while culled), instances
+* sharing a period are spread over different frames, and no more than
+* maxUpdatesPerFrame poses are evaluated per frame whatever the crowd size.
+* Instances turned down by the cap are served first on the next frames, the
+* ones waiting the longest first, so that every instance gets its turn within
+* about (waiting instances / maxUpdatesPerFrame) frames whatever its handle.
+*/
+class AnimationBudget
+{
+public:
+    struct Tier
+    {
+        float distance; // Instances closer than this use the tier
+        unsigned int period; // Evaluate once every period frames
+    };
+
+    AnimationBudget(unsigned int maxUpdatesPerFrame = 64);
+
+    /*
+    * Registers an instance and returns its handle
+    */
+    unsigned int add();
+
+    /*
+    * Tiers sorted by increasing distance, instances further than the last one use its period
+    */
+    inline void setTiers(const std::vector<Tier>& tiers) { this->_tiers = tiers; }
+    inline const std::vector<Tier>& tiers() const { return this->_tiers; }
+
+    inline void setMaxUpdatesPerFrame(unsigned int maxUpdates) { this->_maxUpdatesPerFrame = maxUpdates; }
+
+    /*
+    * Starts a new frame, must be called before any shouldUpdate of that frame.
+    * Reserves this frame's updates for the instances the cap turned down, oldest first
+    */
+    void beginFrame();
+
+    /*
+    * Returns true when the instance has to evaluate its pose this frame,
+    * otherwise it keeps drawing its last one
+    */
+    bool shouldUpdate(unsigned int handle, float distance, bool visible);
+
+    /*
+    * Index of the tier selected for the instance by its last shouldUpdate, tiers().size() when frozen
+    */
+    inline unsigned int tier(unsigned int handle) const { return this->_instances[handle].tier; }
+
+    inline unsigned int updatesThisFrame() const { return this->_updatesThisFrame; }
+private:
+    struct Instance
+    {
+        unsigned int lastUpdate;
+        unsigned int tier;
+        bool deferred; // Due but turned down by the cap on its last shouldUpdate
+        bool reserved; // Holds one of the updates reserved by beginFrame
+    };
+
+    std::vector<Tier> _tiers;
+    std::vector<Instance> _instances;
+
+    unsigned int _maxUpdatesPerFrame;
+    unsigned int _updatesThisFrame;
+    // Updates of this frame kept for reserved instances that did not call shouldUpdate yet
+    unsigned int _reservedThisFrame;
+    unsigned int _frame;
+
+    // Scratch list of the deferred handles, sorted by age in beginFrame
+    std::vector<unsigned int> _waiting;
+};
+
+#endif // ANIMATION_BUDGET_H
@@ -0,0 +1,259 @@
+#include "animation_library.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "bone.h"
+#include "importer.h"
+#include "job_system.h"
+
+static const float QUANTIZATION_STEPS = 65535.f;
+
+static uint16_t quantize(float value, float min, float extent)
+{
+    if (extent <= 0.f)
+        return 0;
+    float normalized = std::min(std::max((value - min) / extent, 0.f), 1.f);
+    return uint16_t(std::lround(normalized * QUANTIZATION_STEPS));
+}
+
+static float dequantize(uint16_t value, float min, float extent)
+{
+    return min + value / QUANTIZATION_STEPS * extent;
+}
+
+static void appendVec3(std::vector<uint16_t>& data, const glm::vec3& value, const glm::vec3& min, const glm::vec3& extent)
+{
+    for (int c = 0; c < 3; c++)
+        data.push_back(quantize(value[c], min[c], extent[c]));
+}
+
+static glm::vec3 readVec3(const uint16_t* data, const glm::vec3& min, const glm::vec3& extent)
+{
+    return glm::vec3(dequantize(data[0], min.x, extent.x), dequantize(data[1], min.y, extent.y), dequantize(data[2], min.z, extent.z));
+}
+
+/*
+* Bounds of a position or scale channel, false when every key holds the same value
+*/
+template<typename Get>
+static bool channelRange(const std::vector<KeyFrame>& keyFrames, Get get, glm::vec3& min, glm::vec3& extent)
+{
+    min = get(keyFrames[0]);
+    glm::vec3 max = min;
+    bool varying = false;
+    for (const KeyFrame& keyFrame : keyFrames) {
+        const glm::vec3& value = get(keyFrame);
+        varying |= value != get(keyFrames[0]);
+        min = glm::min(min, value);
+        max = glm::max(max, value);
+    }
+    extent = max - min;
+    return varying;
+}
+
+AnimationLibrary::AnimationLibrary(size_t memoryBudget) :
+    _memoryBudget(memoryBudget), _encodedBytes(0), _decodedBytes(0), _decodes(0), _evictions(0)
+{}
+
+AnimationLibrary::~AnimationLibrary()
+{
+    evictAll();
+}
+
+unsigned int AnimationLibrary::import(const aiScene* scene, JobSystem* jobs)
+{
+    if (!jobs) {
+        for (unsigned int i = 0; i < scene->mNumAnimations; i++) {
+            Animation animation;
+            loadAnimation(scene, Bone(), animation, i);
+            add(animation);
+        }
+        return scene->mNumAnimations;
+    }
+
+    // Key times are shared between clips, encoding stays sequential to keep IDs and sharing unchanged
+    std::vector<Animation> animations(scene->mNumAnimations);
+    jobs->parallelFor(scene->mNumAnimations, 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++)
+            loadAnimation(scene, Bone(), animations[i], i);
+    });
+    for (const Animation& animation : animations)
+        add(animation);
+    return scene->mNumAnimations;
+}
+
+unsigned int AnimationLibrary::add(const Animation& animation)
+{
+    unsigned int id = (unsigned int)_clips.size();
+    _clips.push_back(Clip());
+    Clip& clip = _clips.back();
+    clip.name = animation.name();
+    clip.duration = animation.duration();
+    clip.ticksPerSecond = animation.TPS();
+    clip.interpolation = RotationInterpolation::Slerp;
+    clip.hasInterpolation = false;
+    clip.additive = animation.additive();
+    clip.decodedBytes = sizeof(Animation);
+    clip.decoded = nullptr;
+
+    if (!clip.name.empty() && !_ids.insert({ clip.name, id }).second)
+        std::cout << "WARNING::ANIMATION_LIBRARY::DUPLICATE_CLIP_NAME " << clip.name << ", find() returns the first one" << std::endl;
+
+    size_t timesBefore = _times.size();
+    unsigned int previousTimes = 0, previousCount = 0;
+    for (const std::pair<const std::string, std::vector<KeyFrame>>& entry : animation.boneKeyFrames()) {
+        const std::vector<KeyFrame>& keyFrames = entry.second;
+        if (keyFrames.empty())
+            continue;
+
+        Track track;
+        track.bone = entry.first;
+        track.keyCount = (unsigned int)keyFrames.size();
+
+        // Tracks of a clip are usually keyed at the same times
+        bool sameTimes = previousCount == track.keyCount;
+        for (unsigned int k = 0; sameTimes && k < track.keyCount; k++)
+            sameTimes = _times[previousTimes + k] == keyFrames[k].timeStamp;
+        if (!sameTimes) {
+            previousTimes = (unsigned int)_times.size();
+            previousCount = track.keyCount;
+            for (const KeyFrame& keyFrame : keyFrames)
+                _times.push_back(keyFrame.timeStamp);
+        }
+        track.times = previousTimes;
+
+        track.constantPosition = !channelRange(keyFrames, [](const KeyFrame& k) { return k.transform.position(); },
+            track.positionMin, track.positionExtent);
+        track.constantScale = !channelRange(keyFrames, [](const KeyFrame& k) { return k.transform.scale(); },
+            track.scaleMin, track.scaleExtent);
+        track.constantRotation = true;
+        for (const KeyFrame& keyFrame : keyFrames)
+            track.constantRotation &= keyFrame.transform.rotation() == keyFrames[0].transform.rotation();
+
+        // Constant channels keep their value exactly in the range minimum, with no stored key
+        track.positions = (unsigned int)clip.data.size();
+        if (!track.constantPosition) {
+            for (const KeyFrame& keyFrame : keyFrames)
+                appendVec3(clip.data, keyFrame.transform.position(), track.positionMin, track.positionExtent);
+        }
+        track.rotations = (unsigned int)clip.data.size();
+        for (unsigned int k = 0; k < (track.constantRotation ? 1 : track.keyCount); k++) {
+            const glm::quat& rotation = keyFrames[k].transform.rotation();
+            for (int c = 0; c < 4; c++)
+                clip.data.push_back(quantize(rotation[c], -1.f, 2.f));
+        }
+        track.scales = (unsigned int)clip.data.size();
+        if (!track.constantScale) {
+            for (const KeyFrame& keyFrame : keyFrames)
+                appendVec3(clip.data, keyFrame.transform.scale(), track.scaleMin, track.scaleExtent);
+        }
+
+        clip.tracks.push_back(track);
+        clip.decodedBytes += track.keyCount * sizeof(KeyFrame) + sizeof(std::vector<KeyFrame>) + sizeof(std::string)
+            + track.bone.size() + 2 * sizeof(void*);
+    }
+    clip.data.shrink_to_fit();
+
+    _encodedBytes += sizeof(Clip) + clip.data.size() * sizeof(uint16_t) + clip.tracks.size() * sizeof(Track)
+        + (_times.size() - timesBefore) * sizeof(float);
+    return id;
+}
+
+int AnimationLibrary::find(const std::string& name) const
+{
+    std::unordered_map<std::string, unsigned int>::const_iterator it = _ids.find(name);
+    return it == _ids.end() ? -1 : int(it->second);
+}
+
+void AnimationLibrary::setInterpolation(unsigned int id, RotationInterpolation mode)
+{
+    Clip& clip = _clips[id];
+    clip.interpolation = mode;
+    clip.hasInterpolation = true;
+    if (clip.decoded)
+        clip.decoded->setInterpolation(mode);
+}
+
+Animation* AnimationLibrary::get(unsigned int id)
+{
+    Clip& clip = _clips[id];
+    if (clip.decoded) {
+        _lru.splice(_lru.begin(), _lru, clip.lru);
+        return clip.decoded;
+    }
+
+    clip.decoded = new Animation();
+    decode(clip, *clip.decoded);
+    _lru.push_front(id);
+    clip.lru = _lru.begin();
+    _decodedBytes += clip.decodedBytes;
+    _decodes++;
+
+    enforceBudget(int(id));
+    return clip.decoded;
+}
+
+void AnimationLibrary::setMemoryBudget(size_t bytes)
+{
+    _memoryBudget = bytes;
+    enforceBudget(_lru.empty() ? -1 : int(_lru.front()));
+}
+
+void AnimationLibrary::evictAll()
+{
+    while (!_lru.empty())
+        evict(_lru.back());
+}
+
+void AnimationLibrary::decode(const Clip& clip, Animation& output) const
+{
+    output.setName(clip.name);
+    output.setDuration(clip.duration);
+    output.setTPS(clip.ticksPerSecond);
+    output.setAdditive(clip.additive);
+    if (clip.hasInterpolation)
+        output.setInterpolation(clip.interpolation);
+
+    for (const Track& track : clip.tracks) {
+        const uint16_t* positions = &clip.data[0] + track.positions;
+        const uint16_t* rotations = &clip.data[0] + track.rotations;
+        const uint16_t* scales = &clip.data[0] + track.scales;
+        for (unsigned int k = 0; k < track.keyCount; k++) {
+            unsigned int rotation = track.constantRotation ? 0 : 4 * k;
+            glm::quat q;
+            q.x = dequantize(rotations[rotation], -1.f, 2.f);
+            q.y = dequantize(rotations[rotation + 1], -1.f, 2.f);
+            q.z = dequantize(rotations[rotation + 2], -1.f, 2.f);
+            q.w = dequantize(rotations[rotation + 3], -1.f, 2.f);
+
+            KeyFrame keyFrame;
+            keyFrame.timeStamp = _times[track.times + k];
+            keyFrame.transform = Transformation(
+                track.constantPosition ? track.positionMin : readVec3(positions + 3 * k, track.positionMin, track.positionExtent),
+                glm::normalize(q),
+                track.constantScale ? track.scaleMin : readVec3(scales + 3 * k, track.scaleMin, track.scaleExtent));
+            output.addBoneKeyFrame(track.bone, keyFrame);
+        }
+    }
+}
+
+void AnimationLibrary::evict(unsigned int id)
+{
+    Clip& clip = _clips[id];
+    delete clip.decoded;
+    clip.decoded = nullptr;
+    _lru.erase(clip.lru);
+    _decodedBytes -= clip.decodedBytes;
+    _evictions++;
+}
+
+void AnimationLibrary::enforceBudget(int keep)
+{
+    while (_decodedBytes > _memoryBudget && !_lru.empty() && int(_lru.back()) != keep)
+        evict(_lru.back());
+    if (_decodedBytes > _memoryBudget && keep >= 0)
+        std::cout << "WARNING::ANIMATION_LIBRARY::OVER_BUDGET clip " << _clips[keep].name << " needs "
+            << _clips[keep].decodedBytes << " bytes" << std::endl;
+}
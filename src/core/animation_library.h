@@ -0,0 +1,130 @@
+#ifndef ANIMATION_LIBRARY_H
+#define ANIMATION_LIBRARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <assimp/scene.h>
+
+#include "animation.h"
+
+class JobSystem;
+
+/*
+* Every clip of a skeleton, indexed by ID (import order) and by name. Clips are kept quantized
+* (16 bits per key component, constant channels stored once, key times shared between tracks)
+* and decoded into an Animation when first played. Decoded clips stay resident until the memory
+* budget is exceeded, least recently played first
+*/
+class AnimationLibrary
+{
+public:
+    AnimationLibrary(size_t memoryBudget = 64 * 1024 * 1024);
+    ~AnimationLibrary();
+
+    AnimationLibrary(const AnimationLibrary&) = delete;
+    AnimationLibrary& operator=(const AnimationLibrary&) = delete;
+
+    /*
+    * Encodes every animation of the scene, returns the number of clips added. With jobs, the
+    * clips are read from the scene in parallel, then encoded in order
+    */
+    unsigned int import(const aiScene* scene, JobSystem* jobs = nullptr);
+
+    /*
+    * Encodes a clip and returns its ID, the animation is not referenced afterwards
+    */
+    unsigned int add(const Animation& animation);
+
+    inline unsigned int size() const { return (unsigned int)this->_clips.size(); }
+
+    /*
+    * ID of the clip, -1 when there is none with this name
+    */
+    int find(const std::string& name) const;
+
+    inline const std::string& name(unsigned int id) const { return this->_clips[id].name; }
+    inline float duration(unsigned int id) const { return this->_clips[id].duration; }
+    inline bool additive(unsigned int id) const { return this->_clips[id].additive; }
+
+    /*
+    * Rotation interpolation given to the clip whenever it is decoded
+    */
+    void setInterpolation(unsigned int id, RotationInterpolation mode);
+
+    /*
+    * Decoded clip, decoding it on first use. The pointer stays valid until a later get()
+    * evicts it: the clip returned by the last get() is never evicted
+    */
+    Animation* get(unsigned int id);
+
+    /*
+    * Drops decoded clips until the budget is met, or all of them with evictAll()
+    */
+    void setMemoryBudget(size_t bytes);
+    inline size_t memoryBudget() const { return this->_memoryBudget; }
+    void evictAll();
+
+    inline bool resident(unsigned int id) const { return this->_clips[id].decoded != nullptr; }
+
+    /*
+    * Quantized payload of all clips, and estimated heap size of the decoded ones
+    */
+    inline size_t encodedBytes() const { return this->_encodedBytes; }
+    inline size_t decodedBytes() const { return this->_decodedBytes; }
+
+    inline unsigned int decodes() const { return this->_decodes; }
+    inline unsigned int evictions() const { return this->_evictions; }
+private:
+    struct Track
+    {
+        std::string bone;
+        unsigned int keyCount;
+        unsigned int times; // Offset in _times, shared by tracks with the same key times
+        // Offsets in Clip::data, channels with a single stored key are constant
+        unsigned int positions, rotations, scales;
+        bool constantPosition, constantRotation, constantScale;
+        glm::vec3 positionMin, positionExtent;
+        glm::vec3 scaleMin, scaleExtent;
+    };
+
+    struct Clip
+    {
+        std::string name;
+        float duration;
+        float ticksPerSecond;
+        RotationInterpolation interpolation;
+        bool hasInterpolation;
+        bool additive;
+
+        std::vector<Track> tracks;
+        std::vector<uint16_t> data;
+        size_t decodedBytes;
+
+        Animation* decoded;
+        std::list<unsigned int>::iterator lru;
+    };
+
+    void decode(const Clip& clip, Animation& output) const;
+    void evict(unsigned int id);
+    void enforceBudget(int keep);
+private:
+    std::vector<Clip> _clips;
+    std::unordered_map<std::string, unsigned int> _ids;
+    std::vector<float> _times;
+
+    // Resident clips, most recently played first
+    std::list<unsigned int> _lru;
+
+    size_t _memoryBudget;
+    size_t _encodedBytes;
+    size_t _decodedBytes;
+    unsigned int _decodes;
+    unsigned int _evictions;
+};
+
+#endif // ANIMATION_LIBRARY_H
@@ -0,0 +1,64 @@
+#include "bone_query.h"
+
+#include <algorithm>
+
+#include "affine.h"
+#include "pose.h"
+
+BoneQuery::BoneQuery() : _skeleton(nullptr), _animation(nullptr), _time(0), _globalInverse(1.f),
+    _globals({}), _frames({}), _frame(0), _evaluated(0), _chain({})
+{
+
+}
+
+void BoneQuery::begin(const FlatSkeleton& skeleton, Animation& animation, float animationTime,
+    const glm::mat4& globalInverseTransform)
+{
+    this->_skeleton = &skeleton;
+    this->_animation = &animation;
+    this->_time = animationTime;
+    this->_globalInverse = glm::mat4x3(globalInverseTransform);
+    this->_evaluated = 0;
+
+    if (this->_frames.size() != skeleton.size()) {
+        this->_globals.resize(skeleton.size());
+        this->_frames.assign(skeleton.size(), 0);
+        this->_frame = 0;
+    }
+    // Stamp 0 never matches, including after the counter wraps
+    if (++this->_frame == 0) {
+        std::fill(this->_frames.begin(), this->_frames.end(), 0);
+        this->_frame = 1;
+    }
+}
+
+const glm::mat4x3& BoneQuery::global(unsigned int index)
+{
+    if (this->_frames[index] == this->_frame)
+        return this->_globals[index];
+
+    // Walks up to the first ancestor already known this frame, then down again
+    this->_chain.clear();
+    int bone = int(index);
+    while (bone >= 0 && this->_frames[bone] != this->_frame) {
+        this->_chain.push_back(unsigned(bone));
+        bone = this->_skeleton->parent(bone);
+    }
+
+    for (std::vector<unsigned int>::reverse_iterator it = this->_chain.rbegin(); it != this->_chain.rend(); ++it) {
+        unsigned int i = *it;
+        Transformation local(glm::vec3(0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f));
+        sampleBoneLocal(*this->_animation, this->_skeleton->name(i), this->_time, local);
+
+        int parent = this->_skeleton->parent(i);
+        this->_globals[i] = concatAffine(parent < 0 ? this->_globalInverse : this->_globals[parent], local.toAffine());
+        this->_frames[i] = this->_frame;
+        this->_evaluated++;
+    }
+    return this->_globals[index];
+}
+
+glm::mat4x3 BoneQuery::palette(unsigned int index)
+{
+    return concatAffine(global(index), this->_skeleton->offset(index));
+}
@@ -0,0 +1,61 @@
+#ifndef BONE_QUERY_H
+#define BONE_QUERY_H
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "animation.h"
+#include "flat_skeleton.h"
+
+/*
+* Transforms of single bones (sockets, look-at targets, server-side hit checks) without
+* evaluating the whole pose: only the chain from the root to the requested bone is sampled.
+* Results are kept until the next begin(), so queries on bones sharing ancestors share work
+*/
+class BoneQuery
+{
+public:
+    BoneQuery();
+
+    /*
+    * Starts a frame of queries on the clip at animationTime. Forgets the previous results
+    */
+    void begin(const FlatSkeleton& skeleton, Animation& animation, float animationTime,
+        const glm::mat4& globalInverseTransform = glm::mat4(1.f));
+
+    /*
+    * Model-space transform of the bone, by FlatSkeleton index
+    */
+    const glm::mat4x3& global(unsigned int index);
+
+    /*
+    * Skinning matrix of the bone, the entry getPoseFlat writes at the bone's ID
+    */
+    glm::mat4x3 palette(unsigned int index);
+
+    /*
+    * Index of the bone with this name, -1 when there is none
+    */
+    inline int find(const std::string& name) const { return this->_skeleton ? this->_skeleton->find(name) : -1; }
+
+    /*
+    * Bones sampled since begin()
+    */
+    inline unsigned int evaluated() const { return this->_evaluated; }
+private:
+    const FlatSkeleton* _skeleton;
+    Animation* _animation;
+    float _time;
+    glm::mat4x3 _globalInverse;
+
+    // Per bone: the frame its global was computed in, so that begin() does not clear anything
+    std::vector<glm::mat4x3> _globals;
+    std::vector<unsigned int> _frames;
+    unsigned int _frame;
+    unsigned int _evaluated;
+
+    std::vector<unsigned int> _chain;
+};
+
+#endif // BONE_QUERY_H
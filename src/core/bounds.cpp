@@ -0,0 +1,113 @@
+#include "bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+void AABB::extend(const glm::vec3& point)
+{
+    this->min = glm::min(this->min, point);
+    this->max = glm::max(this->max, point);
+}
+
+void AABB::extend(const AABB& box)
+{
+    if (box.empty())
+        return;
+    this->min = glm::min(this->min, box.min);
+    this->max = glm::max(this->max, box.max);
+}
+
+AABB AABB::transform(const glm::mat4& matrix) const
+{
+    AABB res;
+    if (empty())
+        return res;
+
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? this->max.x : this->min.x,
+                         (i & 2) ? this->max.y : this->min.y,
+                         (i & 4) ? this->max.z : this->min.z);
+        res.extend(glm::vec3(matrix * glm::vec4(corner, 1.0f)));
+    }
+    return res;
+}
+
+Frustum::Frustum(const glm::mat4& clipMatrix)
+{
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(clipMatrix[0][i], clipMatrix[1][i], clipMatrix[2][i], clipMatrix[3][i]);
+
+    // Left, right, bottom, top, near, far
+    for (int i = 0; i < 3; i++) {
+        this->_planes[i * 2] = rows[3] + rows[i];
+        this->_planes[i * 2 + 1] = rows[3] - rows[i];
+    }
+}
+
+bool Frustum::intersects(const AABB& box) const
+{
+    if (box.empty())
+        return true; // Nothing known about it, never cull
+
+    for (const glm::vec4& plane : this->_planes) {
+        // Corner the furthest along the plane normal
+        glm::vec3 corner(plane.x >= 0 ? box.max.x : box.min.x,
+                         plane.y >= 0 ? box.max.y : box.min.y,
+                         plane.z >= 0 ? box.max.z : box.min.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0)
+            return false;
+    }
+    return true;
+}
+
+const unsigned int ClipBounds::SAMPLE_COUNT = 64;
+
+ClipBounds::ClipBounds() : _duration(0.0f), _bounds(), _track({})
+{
+
+}
+
+void ClipBounds::build(const std::vector<AABB>& boneBounds, float duration, const PoseSampler& samplePose)
+{
+    this->_duration = duration;
+    this->_bounds = AABB();
+    this->_track.assign(SAMPLE_COUNT + 1, AABB());
+
+    std::vector<glm::mat4> palette(boneBounds.size(), glm::mat4(1.0f));
+    for (unsigned int i = 0; i <= SAMPLE_COUNT; i++) {
+        // The last sample is taken right before the loop point so that fmod does not wrap it to 0
+        float time = std::min(float(i) / SAMPLE_COUNT, 0.9999f) * duration;
+        samplePose(time, palette);
+
+        AABB& sample = this->_track[i];
+        for (unsigned int bone = 0; bone < boneBounds.size(); bone++)
+            sample.extend(boneBounds[bone].transform(palette[bone]));
+        this->_bounds.extend(sample);
+    }
+}
+
+void ClipBounds::extend(const ClipBounds& other)
+{
+    this->_bounds.extend(other._bounds);
+    if (this->_track.size() != other._track.size()) {
+        // Samples that do not match up: only the bounds of the whole clip stay correct
+        this->_track.clear();
+        return;
+    }
+    for (unsigned int i = 0; i < this->_track.size(); i++)
+        this->_track[i].extend(other._track[i]);
+}
+
+AABB ClipBounds::at(float animationTime) const
+{
+    if (this->_track.empty() || this->_duration <= 0.0f)
+        return this->_bounds;
+
+    float progression = std::fmod(animationTime, this->_duration) / this->_duration;
+    unsigned int idx = std::min((unsigned int)(progression * SAMPLE_COUNT), SAMPLE_COUNT - 1);
+
+    AABB res = this->_track[idx];
+    res.extend(this->_track[idx + 1]);
+    return res;
+}
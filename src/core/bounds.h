@@ -0,0 +1,74 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <cfloat>
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct AABB
+{
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    inline bool empty() const { return min.x > max.x; }
+
+    void extend(const glm::vec3& point);
+    void extend(const AABB& box);
+
+    /*
+    * Bounds of the 8 transformed corners, conservative for any affine transformation
+    */
+    AABB transform(const glm::mat4& matrix) const;
+};
+
+class Frustum
+{
+public:
+    /*
+    * Planes are extracted from the clip matrix, pass projection * view * model to test in model space
+    */
+    Frustum(const glm::mat4& clipMatrix);
+
+    bool intersects(const AABB& box) const;
+private:
+    glm::vec4 _planes[6];
+};
+
+/*
+* Conservative bounds of a skinned mesh over one clip, computed once at load from the
+* bind-space extents of each bone transformed by the palettes sampled over the clip
+*/
+class ClipBounds
+{
+public:
+    ClipBounds();
+
+    typedef std::function<void(float, std::vector<glm::mat4>&)> PoseSampler;
+
+    void build(const std::vector<AABB>& boneBounds, float duration, const PoseSampler& samplePose);
+
+    /*
+    * Bounds of the whole clip
+    */
+    inline const AABB& bounds() const { return this->_bounds; }
+
+    /*
+    * Bounds around the given animation time, from the two track samples surrounding it
+    */
+    AABB at(float animationTime) const;
+
+    /*
+    * Grows each sample to also contain the same sample of other, built over the same duration
+    */
+    void extend(const ClipBounds& other);
+
+    static const unsigned int SAMPLE_COUNT;
+private:
+    float _duration;
+
+    AABB _bounds;
+    std::vector<AABB> _track;
+};
+
+#endif // BOUNDS_H
@@ -0,0 +1,61 @@
+#include "camera_path.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+CameraPath::CameraPath() : _keys({})
+{
+
+}
+
+bool CameraPath::load(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "ERROR::CAMERA_PATH::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+        return false;
+    }
+
+    this->_keys.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream stream(line);
+        Key key;
+        if (!(stream >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch)) {
+            std::cout << "ERROR::CAMERA_PATH::INVALID_LINE " << line << std::endl;
+            return false;
+        }
+        this->_keys.push_back(key);
+    }
+
+    std::stable_sort(this->_keys.begin(), this->_keys.end(), [](const Key& a, const Key& b) { return a.time < b.time; });
+    return !this->_keys.empty();
+}
+
+CameraPath::Key CameraPath::sample(float time) const
+{
+    if (time <= this->_keys.front().time)
+        return this->_keys.front();
+    if (time >= this->_keys.back().time)
+        return this->_keys.back();
+
+    unsigned int idx = 0;
+    while (this->_keys[idx + 1].time <= time)
+        idx++;
+
+    const Key& a = this->_keys[idx];
+    const Key& b = this->_keys[idx + 1];
+    float progression = (time - a.time) / (b.time - a.time);
+
+    Key res;
+    res.time = time;
+    res.position = glm::mix(a.position, b.position, progression);
+    res.yaw = glm::mix(a.yaw, b.yaw, progression);
+    res.pitch = glm::mix(a.pitch, b.pitch, progression);
+    return res;
+}
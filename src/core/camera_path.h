@@ -0,0 +1,35 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*
+* Scripted camera for reproducible runs. The file has one key per line:
+*   time x y z yaw pitch
+* Lines starting with # are ignored, keys are linearly interpolated and clamped at both ends
+*/
+class CameraPath
+{
+public:
+    struct Key
+    {
+        float time;
+        glm::vec3 position;
+        float yaw;
+        float pitch;
+    };
+
+    CameraPath();
+
+    bool load(const std::string& path);
+
+    inline bool empty() const { return this->_keys.empty(); }
+
+    Key sample(float time) const;
+private:
+    std::vector<Key> _keys;
+};
+
+#endif // CAMERA_PATH_H
@@ -0,0 +1,36 @@
+#include "flat_skeleton.h"
+
+FlatSkeleton::FlatSkeleton() : _ids({}), _parents({}), _names({}), _offsets({})
+{
+
+}
+
+void FlatSkeleton::build(Bone& root)
+{
+    this->_ids.clear();
+    this->_parents.clear();
+    this->_names.clear();
+    this->_offsets.clear();
+    read(root, -1);
+}
+
+int FlatSkeleton::find(const std::string& name) const
+{
+    for (unsigned int i = 0; i < this->_names.size(); i++) {
+        if (this->_names[i] == name)
+            return int(i);
+    }
+    return -1;
+}
+
+void FlatSkeleton::read(Bone& bone, int parent)
+{
+    int index = (int)this->_ids.size();
+    this->_ids.push_back(bone.id());
+    this->_parents.push_back(parent);
+    this->_names.push_back(bone.name());
+    this->_offsets.push_back(glm::mat4x3(bone.offset()));
+
+    for (Bone& child : bone.children())
+        read(child, index);
+}
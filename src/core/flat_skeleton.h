@@ -0,0 +1,50 @@
+#ifndef FLAT_SKELETON_H
+#define FLAT_SKELETON_H
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "bone.h"
+
+/*
+* Bone tree stored as arrays in parent-first order, so that hierarchy passes walk the
+* bones linearly instead of recursing. Entries are indexed by position in that order,
+* id() gives the palette slot of each entry
+*/
+class FlatSkeleton
+{
+public:
+    FlatSkeleton();
+
+    void build(Bone& root);
+
+    inline unsigned int size() const { return (unsigned int)this->_ids.size(); }
+
+    inline int id(unsigned int index) const { return this->_ids[index]; }
+
+    /*
+    * Index of the parent entry, -1 for the root
+    */
+    inline int parent(unsigned int index) const { return this->_parents[index]; }
+
+    inline const std::string& name(unsigned int index) const { return this->_names[index]; }
+
+    /*
+    * Index of the bone with this name, -1 when there is none
+    */
+    int find(const std::string& name) const;
+
+    inline const glm::mat4x3& offset(unsigned int index) const { return this->_offsets[index]; }
+
+    inline const glm::mat4x3* offsets() const { return this->_offsets.data(); }
+private:
+    void read(Bone& bone, int parent);
+private:
+    std::vector<int> _ids;
+    std::vector<int> _parents;
+    std::vector<std::string> _names;
+    std::vector<glm::mat4x3> _offsets;
+};
+
+#endif // FLAT_SKELETON_H
@@ -0,0 +1,52 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+FrameArena::FrameArena(size_t capacity) : _buffer(new char[capacity]), _capacity(capacity), _offset(0),
+    _highWater(0), _overflow({}), _overflowBytes(0)
+{
+    // Blocks are only ever added when a frame overflows, room is kept so that pushing does not allocate
+    this->_overflow.reserve(16);
+}
+
+FrameArena::~FrameArena()
+{
+    for (char* block : this->_overflow)
+        delete[] block;
+    delete[] this->_buffer;
+}
+
+void* FrameArena::allocateBytes(size_t size, size_t alignment)
+{
+    uintptr_t base = reinterpret_cast<uintptr_t>(this->_buffer);
+    size_t offset = ((base + this->_offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+    if (offset + size <= this->_capacity) {
+        this->_offset = offset + size;
+        this->_highWater = std::max(this->_highWater, used());
+        return this->_buffer + offset;
+    }
+
+    // new[] alignment covers every type used for frame data
+    char* block = new char[size];
+    this->_overflow.push_back(block);
+    this->_overflowBytes += size;
+    this->_highWater = std::max(this->_highWater, used());
+    return block;
+}
+
+void FrameArena::reset()
+{
+    if (!this->_overflow.empty()) {
+        for (char* block : this->_overflow)
+            delete[] block;
+        this->_overflow.clear();
+        this->_overflowBytes = 0;
+
+        // Enough for the worst frame seen, alignment padding included
+        this->_capacity = std::max(this->_capacity * 2, this->_highWater + this->_highWater / 4);
+        delete[] this->_buffer;
+        this->_buffer = new char[this->_capacity];
+    }
+    this->_offset = 0;
+}
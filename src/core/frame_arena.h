@@ -0,0 +1,48 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+/*
+* Bump allocator for per-frame scratch memory (palettes to upload, temporary poses).
+* Everything handed out stays valid until the next reset(). A frame needing more than
+* the capacity is served from extra blocks and the arena grows at the following reset,
+* so steady-state frames never touch the heap
+*/
+class FrameArena
+{
+public:
+    FrameArena(size_t capacity = 64 * 1024);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    /*
+    * Uninitialized storage for count objects of type T
+    */
+    template<typename T>
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(allocateBytes(sizeof(T) * count, alignof(T)));
+    }
+
+    void reset();
+
+    inline size_t capacity() const { return this->_capacity; }
+    inline size_t used() const { return this->_offset + this->_overflowBytes; }
+    inline size_t highWater() const { return this->_highWater; }
+private:
+    void* allocateBytes(size_t size, size_t alignment);
+private:
+    char* _buffer;
+    size_t _capacity;
+    size_t _offset;
+    size_t _highWater;
+
+    std::vector<char*> _overflow;
+    size_t _overflowBytes;
+};
+
+#endif // FRAME_ARENA_H
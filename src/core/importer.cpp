@@ -0,0 +1,216 @@
+#include "importer.h"
+
+#include <algorithm>
+
+glm::mat4 assimpToGlmMatrix(aiMatrix4x4 mat) {
+	glm::mat4 m;
+	for (int y = 0; y < 4; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			m[x][y] = mat[y][x];
+		}
+	}
+	return m;
+}
+
+glm::vec3 assimpToGlmVec3(aiVector3D vec) {
+	return glm::vec3(vec.x, vec.y, vec.z);
+}
+
+glm::quat assimpToGlmQuat(aiQuaternion quat) {
+	glm::quat q;
+	q.x = quat.x;
+	q.y = quat.y;
+	q.z = quat.z;
+	q.w = quat.w;
+
+	return q;
+}
+
+int maxInfluences(const std::vector<Vertex>& vertices) {
+	int res = 1;
+	for (const Vertex& vertex : vertices) {
+		int count = 0;
+		for (int i = 0; i < 4; i++) {
+			if (vertex.boneWeights[i] > 0.0f)
+				count++;
+		}
+		res = std::max(res, count);
+	}
+	return res;
+}
+
+std::vector<AABB> computeBoneBounds(const std::vector<Vertex>& vertices, unsigned int boneCount) {
+	std::vector<AABB> res(boneCount);
+	for (const Vertex& vertex : vertices) {
+		for (int i = 0; i < 4; i++) {
+			if (vertex.boneWeights[i] > 0.0f)
+				res[vertex.boneIds[i]].extend(vertex.position);
+		}
+	}
+	return res;
+}
+
+bool readSkeleton(Bone& boneOutput, aiNode* node, std::unordered_map<std::string, std::pair<int, glm::mat4>>& boneInfoTable) {	
+	if (boneInfoTable.find(node->mName.C_Str()) != boneInfoTable.end()) {
+		boneOutput.setName(node->mName.C_Str());
+		boneOutput.setId(boneInfoTable[boneOutput.name()].first);
+		boneOutput.setOffset(boneInfoTable[boneOutput.name()].second);
+
+		for (int i = 0; i < node->mNumChildren; i++) {
+			Bone child;
+			readSkeleton(child, node->mChildren[i], boneInfoTable);
+			boneOutput.addChild(child);
+		}
+		return true;
+	}
+
+	for (int i = 0; i < node->mNumChildren; i++) {
+		if (readSkeleton(boneOutput, node->mChildren[i], boneInfoTable)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void loadAnimation(const aiScene* scene, Bone bone, Animation& animation, unsigned int index) {
+	aiAnimation* anim = scene->mAnimations[index];
+
+	animation.setName(anim->mName.C_Str());
+
+	if (anim->mTicksPerSecond != 0.0f)
+		animation.setTPS(anim->mTicksPerSecond);
+	else
+		animation.setTPS(1);
+
+	animation.setDuration(anim->mDuration * anim->mTicksPerSecond);
+
+	for (int i = 0; i < anim->mNumChannels; i++) {
+		std::vector<KeyFrame> keyFrames;
+		aiNodeAnim* channel = anim->mChannels[i];
+
+		unsigned int numPositions = channel->mNumPositionKeys;
+		unsigned int numRotations = channel->mNumRotationKeys;
+		unsigned int numScales = channel->mNumScalingKeys;
+
+		unsigned int nbKeyFrames = std::max(std::max(numPositions, numRotations), numScales);
+		for (unsigned int i = 0; i < nbKeyFrames; i++)
+		{
+			unsigned int idxPos = std::min(i, numPositions - 1);
+			unsigned int idxRot = std::min(i, numRotations - 1);
+			unsigned int idxScale = std::min(i, numScales - 1);
+
+			KeyFrame keyFrame;
+			keyFrame.transform = Transformation(
+				assimpToGlmVec3(channel->mPositionKeys[idxPos].mValue),
+				assimpToGlmQuat(channel->mRotationKeys[idxRot].mValue),
+				assimpToGlmVec3(channel->mScalingKeys[idxScale].mValue));
+
+			keyFrame.timeStamp = channel->mPositionKeys[i].mTime;
+			keyFrames.push_back(keyFrame);
+		}
+		for (const KeyFrame& k : keyFrames)
+			animation.addBoneKeyFrame(channel->mNodeName.C_Str(), k);
+	}
+}
+void loadBindPose(const aiNode* node, ReferencePose& output) {
+	aiVector3D scaling, position;
+	aiQuaternion rotation;
+	node->mTransformation.Decompose(scaling, rotation, position);
+	output[node->mName.C_Str()] = Transformation(assimpToGlmVec3(position), assimpToGlmQuat(rotation), assimpToGlmVec3(scaling));
+
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+		loadBindPose(node->mChildren[i], output);
+}
+
+void loadModel(const aiScene* scene, aiMesh* mesh, std::vector<Vertex>& verticesOutput, std::vector<unsigned int>& indicesOutput, Bone& skeletonOutput, unsigned int& nBoneCount) {
+	verticesOutput = {};
+	indicesOutput = {};
+
+	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+		//process position 
+		Vertex vertex;
+		glm::vec3 vector;
+		vector.x = mesh->mVertices[i].x;
+		vector.y = mesh->mVertices[i].y;
+		vector.z = mesh->mVertices[i].z;
+		vertex.position = vector;
+		//process normal
+		vector.x = mesh->mNormals[i].x;
+		vector.y = mesh->mNormals[i].y;
+		vector.z = mesh->mNormals[i].z;
+		vertex.normal = vector;
+		//process uv
+		glm::vec2 vec;
+		vec.x = mesh->mTextureCoords[0][i].x;
+		vec.y = mesh->mTextureCoords[0][i].y;
+		vertex.uv = vec;
+
+		vertex.boneIds = glm::ivec4(0);
+		vertex.boneWeights = glm::vec4(0.0f);
+
+		verticesOutput.push_back(vertex);
+	}
+
+	std::unordered_map<std::string, std::pair<int, glm::mat4>> boneInfo = {};
+	std::vector<unsigned int> boneCounts;
+	boneCounts.resize(verticesOutput.size(), 0);
+	nBoneCount = mesh->mNumBones;
+
+	for (int i = 0; i < nBoneCount; i++) {
+		aiBone* bone = mesh->mBones[i];
+		glm::mat4 m = assimpToGlmMatrix(bone->mOffsetMatrix);
+		boneInfo[bone->mName.C_Str()] = { i, m };
+
+		for (int j = 0; j < bone->mNumWeights; j++) {
+			unsigned int id = bone->mWeights[j].mVertexId;
+			float weight = bone->mWeights[j].mWeight;
+			boneCounts[id]++;
+			switch (boneCounts[id]) {
+			case 1:
+				verticesOutput[id].boneIds.x = i;
+				verticesOutput[id].boneWeights.x = weight;
+				break;
+			case 2:
+				verticesOutput[id].boneIds.y = i;
+				verticesOutput[id].boneWeights.y = weight;
+				break;
+			case 3:
+				verticesOutput[id].boneIds.z = i;
+				verticesOutput[id].boneWeights.z = weight;
+				break;
+			case 4:
+				verticesOutput[id].boneIds.w = i;
+				verticesOutput[id].boneWeights.w = weight;
+				break;
+			default:
+				//std::cout << "err: unable to allocate bone to vertex" << std::endl;
+				break;
+
+			}
+		}
+	}
+
+	for (int i = 0; i < verticesOutput.size(); i++) {
+		glm::vec4& boneWeights = verticesOutput[i].boneWeights;
+		float totalWeight = boneWeights.x + boneWeights.y + boneWeights.z + boneWeights.w;
+		if (totalWeight > 0.0f) {
+			verticesOutput[i].boneWeights = glm::vec4(
+				boneWeights.x / totalWeight,
+				boneWeights.y / totalWeight,
+				boneWeights.z / totalWeight,
+				boneWeights.w / totalWeight
+			);
+		}
+	}
+
+	for (int i = 0; i < mesh->mNumFaces; i++) {
+		aiFace& face = mesh->mFaces[i];
+		for (unsigned int j = 0; j < face.mNumIndices; j++)
+			indicesOutput.push_back(face.mIndices[j]);
+	}
+
+	readSkeleton(skeletonOutput, scene->mRootNode, boneInfo);
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef IMPORTER_H
+#define IMPORTER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <assimp/scene.h>
+
+#include "animation.h"
+#include "bone.h"
+#include "bounds.h"
+
+struct Vertex {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 uv;
+	glm::ivec4 boneIds = glm::ivec4(0);
+	glm::vec4 boneWeights = glm::vec4(0.0f);
+};
+
+glm::mat4 assimpToGlmMatrix(aiMatrix4x4 mat);
+
+glm::vec3 assimpToGlmVec3(aiVector3D vec);
+
+glm::quat assimpToGlmQuat(aiQuaternion quat);
+
+/*
+* Highest number of non-zero weights used by a vertex of the mesh, selects the cheapest skinning variant
+*/
+int maxInfluences(const std::vector<Vertex>& vertices);
+
+/*
+* Bind-space extents of the vertices influenced by each bone
+*/
+std::vector<AABB> computeBoneBounds(const std::vector<Vertex>& vertices, unsigned int boneCount);
+
+bool readSkeleton(Bone& boneOutput, aiNode* node, std::unordered_map<std::string, std::pair<int, glm::mat4>>& boneInfoTable);
+
+/*
+* Reads the clip scene->mAnimations[index]
+*/
+void loadAnimation(const aiScene* scene, Bone bone, Animation& animation, unsigned int index = 0);
+
+/*
+* Local transform of every node below the given one as the scene stores it, the bind pose
+* additive clips are usually made against
+*/
+void loadBindPose(const aiNode* node, ReferencePose& output);
+
+void loadModel(const aiScene* scene, aiMesh* mesh, std::vector<Vertex>& verticesOutput, std::vector<unsigned int>& indicesOutput, Bone& skeletonOutput, unsigned int& nBoneCount);
+
+#endif // IMPORTER_H
@@ -0,0 +1,166 @@
+#include "inertialization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <glm/gtc/quaternion.hpp>
+
+// Offsets below this are not worth a transition
+static const float MIN_OFFSET = 1e-5f;
+
+enum Channel { TRANSLATION = 0, ROTATION = 1, SCALE = 2 };
+
+void Inertializer::Decay::init(float offset, float velocity, float blendTime)
+{
+    x0 = offset;
+    // Motion away from the target would overshoot, the decay starts flat instead
+    v0 = std::min(velocity, 0.f);
+    duration = blendTime;
+    if (x0 <= 0.f || duration <= 0.f) {
+        x0 = v0 = a0 = a = b = c = 0.f;
+        duration = 0.f;
+        return;
+    }
+    // Shortened so that the curve does not go past the target
+    if (v0 < 0.f)
+        duration = std::min(duration, -5.f * x0 / v0);
+
+    const float t = duration;
+    const float t2 = t * t;
+    a0 = std::max(0.f, (-8.f * v0 * t - 20.f * x0) / t2);
+    a = -(a0 * t2 + 6.f * v0 * t + 12.f * x0) / (2.f * t2 * t2 * t);
+    b = (3.f * a0 * t2 + 16.f * v0 * t + 30.f * x0) / (2.f * t2 * t2);
+    c = -(3.f * a0 * t2 + 12.f * v0 * t + 20.f * x0) / (2.f * t2 * t);
+}
+
+float Inertializer::Decay::at(float t) const
+{
+    if (t >= duration)
+        return 0.f;
+    return (((((a * t + b) * t + c) * t + 0.5f * a0) * t + v0) * t) + x0;
+}
+
+Inertializer::Inertializer(float duration) :
+    _duration(duration), _elapsed(0), _sinceApply(0), _pending(false), _active(false),
+    _previousDt(0), _history(0)
+{
+
+}
+
+void Inertializer::start()
+{
+    this->_pending = this->_history > 0;
+}
+
+void Inertializer::advance(float dt)
+{
+    this->_elapsed += dt;
+    this->_sinceApply += dt;
+}
+
+void Inertializer::clear()
+{
+    this->_history = 0;
+    this->_pending = false;
+    this->_active = false;
+}
+
+void Inertializer::begin(const LocalPose& target)
+{
+    const unsigned int count = target.size();
+    this->_active = false;
+    if (this->_previous.size() != count)
+        return;
+
+    // Velocity of the outgoing motion, from the last two poses shown
+    const bool moving = this->_history > 1 && this->_previousDt > 0.f && this->_beforePrevious.size() == count;
+    const float invDt = moving ? 1.f / this->_previousDt : 0.f;
+
+    for (int channel = 0; channel < 3; channel++) {
+        this->_axes[channel].resize(count);
+        this->_decays[channel].resize(count);
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        glm::vec3 offsets[3];
+        glm::vec3 velocities[3];
+
+        for (int axis = 0; axis < 3; axis++) {
+            offsets[TRANSLATION][axis] = this->_previous.translation(axis)[i] - target.translation(axis)[i];
+            offsets[SCALE][axis] = this->_previous.scale(axis)[i] - target.scale(axis)[i];
+            velocities[TRANSLATION][axis] = moving ?
+                (this->_previous.translation(axis)[i] - this->_beforePrevious.translation(axis)[i]) * invDt : 0.f;
+            velocities[SCALE][axis] = moving ?
+                (this->_previous.scale(axis)[i] - this->_beforePrevious.scale(axis)[i]) * invDt : 0.f;
+        }
+
+        // Rotations as the shortest rotation on the parent side taking the target to the
+        // previous pose, and the angular velocity of the previous pose in the same space
+        glm::quat offset = this->_previous.rotations()[i] * glm::inverse(target.rotations()[i]);
+        if (offset.w < 0.f)
+            offset = -offset;
+        float sinHalf = glm::length(glm::vec3(offset.x, offset.y, offset.z));
+        offsets[ROTATION] = sinHalf > 0.f ?
+            glm::vec3(offset.x, offset.y, offset.z) * (2.f * std::atan2(sinHalf, offset.w) / sinHalf) : glm::vec3(0.f);
+
+        velocities[ROTATION] = glm::vec3(0.f);
+        if (moving) {
+            glm::quat delta = this->_previous.rotations()[i] * glm::inverse(this->_beforePrevious.rotations()[i]);
+            if (delta.w < 0.f)
+                delta = -delta;
+            sinHalf = glm::length(glm::vec3(delta.x, delta.y, delta.z));
+            if (sinHalf > 0.f)
+                velocities[ROTATION] = glm::vec3(delta.x, delta.y, delta.z) * (2.f * std::atan2(sinHalf, delta.w) / sinHalf * invDt);
+        }
+
+        for (int channel = 0; channel < 3; channel++) {
+            float length = glm::length(offsets[channel]);
+            Decay& decay = this->_decays[channel][i];
+            if (length < MIN_OFFSET) {
+                this->_axes[channel][i] = glm::vec3(0.f);
+                decay.init(0.f, 0.f, 0.f);
+                continue;
+            }
+            glm::vec3 axis = offsets[channel] / length;
+            this->_axes[channel][i] = axis;
+            decay.init(length, glm::dot(velocities[channel], axis), this->_duration);
+            this->_active = true;
+        }
+    }
+}
+
+void Inertializer::apply(LocalPose& pose)
+{
+    if (this->_pending) {
+        this->_pending = false;
+        this->_elapsed = 0.f;
+        begin(pose);
+    }
+
+    // Over, or another skeleton took over the history
+    if (this->_active && (this->_elapsed >= this->_duration || pose.size() != this->_axes[0].size()))
+        this->_active = false;
+
+    if (this->_active) {
+        const float t = this->_elapsed;
+        glm::quat* rotations = pose.rotations();
+        for (unsigned int i = 0; i < pose.size(); i++) {
+            float translation = this->_decays[TRANSLATION][i].at(t);
+            float rotation = this->_decays[ROTATION][i].at(t);
+            float scale = this->_decays[SCALE][i].at(t);
+            for (int axis = 0; axis < 3; axis++) {
+                pose.translation(axis)[i] += this->_axes[TRANSLATION][i][axis] * translation;
+                pose.scale(axis)[i] += this->_axes[SCALE][i][axis] * scale;
+            }
+            if (rotation != 0.f)
+                rotations[i] = glm::angleAxis(rotation, this->_axes[ROTATION][i]) * rotations[i];
+        }
+    }
+
+    // The pose shown becomes the history, storage is swapped then reused
+    std::swap(this->_previous, this->_beforePrevious);
+    this->_previous = pose;
+    this->_previousDt = this->_sinceApply;
+    this->_sinceApply = 0.f;
+    this->_history = std::min(this->_history + 1, 2u);
+}
@@ -0,0 +1,80 @@
+#ifndef INERTIALIZATION_H
+#define INERTIALIZATION_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "local_pose.h"
+
+/*
+* Transitions without crossfade (inertialization, Bollo, GDC 2018): when the animation
+* switches, the offset between the last pose shown and the new one is recorded per bone,
+* and decays to zero over the blend time along a quintic that starts with the velocity the
+* old motion had. Only the new clip is sampled during the transition.
+* The offsets are a translation and a scale vector and a rotation axis-angle per bone,
+* each decaying along its own direction
+*/
+class Inertializer
+{
+public:
+    Inertializer(float duration = 0.25f);
+
+    inline void setDuration(float duration) { this->_duration = duration; }
+    inline float duration() const { return this->_duration; }
+
+    /*
+    * Starts a transition from the last applied pose, the pose given to the next apply()
+    * being the start of the new motion
+    */
+    void start();
+
+    /*
+    * Moves the transition forward, once per frame
+    */
+    void advance(float dt);
+
+    /*
+    * Adds the remaining offset to the pose, and keeps the result as the last pose shown
+    */
+    void apply(LocalPose& pose);
+
+    inline bool active() const { return this->_active; }
+
+    /*
+    * Forgets the pose history, the next start() then has nothing to blend from
+    */
+    void clear();
+private:
+    /*
+    * Quintic from x0 with velocity v0 to 0 with zero velocity and acceleration at duration
+    */
+    struct Decay
+    {
+        float x0, v0, a0;
+        float a, b, c;
+        float duration;
+
+        void init(float offset, float velocity, float blendTime);
+        float at(float t) const;
+    };
+
+    void begin(const LocalPose& target);
+private:
+    float _duration;
+    float _elapsed;
+    float _sinceApply;
+    bool _pending;
+    bool _active;
+
+    // Last two poses shown and the time between them, for the offset and its velocity
+    LocalPose _previous;
+    LocalPose _beforePrevious;
+    float _previousDt;
+    unsigned int _history;
+
+    // Per bone: offset directions and their decays for translation, rotation and scale
+    std::vector<glm::vec3> _axes[3];
+    std::vector<Decay> _decays[3];
+};
+
+#endif // INERTIALIZATION_H
@@ -0,0 +1,265 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+
+static const unsigned int MAX_CONTINUATIONS = 4;
+// Attempts to find work before an idle worker goes to sleep
+static const unsigned int SPIN_COUNT = 64;
+
+struct JobSystem::Job
+{
+    Function function;
+    void* data;
+    unsigned int begin, end, grain;
+    Job* parent;
+    // The job itself and its children not completed yet
+    std::atomic<int> unfinished;
+    unsigned int continuationCount;
+    Job* continuations[MAX_CONTINUATIONS];
+};
+
+// Pool the current thread works for and its index there, the thread outside the pool has 0
+static thread_local const JobSystem* currentSystem = nullptr;
+static thread_local unsigned int currentIndex = 0;
+
+JobSystem::Deque::Deque() : _top(0), _bottom(0)
+{
+    for (std::atomic<Job*>& entry : this->_entries)
+        entry.store(nullptr, std::memory_order_relaxed);
+}
+
+bool JobSystem::Deque::push(Job* job)
+{
+    int64_t bottom = this->_bottom.load(std::memory_order_relaxed);
+    int64_t top = this->_top.load(std::memory_order_acquire);
+    if (bottom - top >= int64_t(JOB_CAPACITY))
+        return false;
+    this->_entries[bottom & (JOB_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+    // Publishes the entry and the job it points to, to the thieves loading bottom
+    this->_bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+}
+
+JobSystem::Job* JobSystem::Deque::pop()
+{
+    int64_t bottom = this->_bottom.load(std::memory_order_relaxed) - 1;
+    this->_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = this->_top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        this->_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Job* job = this->_entries[bottom & (JOB_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // Last entry, a thief may be taking it at the same time
+        if (!this->_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        this->_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+JobSystem::Job* JobSystem::Deque::steal()
+{
+    int64_t top = this->_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = this->_bottom.load(std::memory_order_acquire);
+    if (top >= bottom)
+        return nullptr;
+
+    Job* job = this->_entries[top & (JOB_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!this->_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr; // Lost to the owner or another thief
+    return job;
+}
+
+JobSystem::JobSystem(unsigned int threads) : _running(true), _queued(0), _sleeping(0)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    this->_workers.resize(threads);
+    for (unsigned int i = 0; i < threads; i++) {
+        this->_workers[i] = new Worker();
+        this->_workers[i]->jobs = new Job[JOB_CAPACITY];
+        for (unsigned int j = 0; j < JOB_CAPACITY; j++)
+            this->_workers[i]->jobs[j].unfinished.store(0, std::memory_order_relaxed);
+        this->_workers[i]->allocated = 0;
+    }
+    for (unsigned int i = 1; i < threads; i++)
+        this->_workers[i]->thread = std::thread(&JobSystem::loop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_running.store(false);
+    }
+    this->_wake.notify_all();
+    // All threads are stopped before any deque goes away, they steal from each other until then
+    for (Worker* worker : this->_workers) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+    for (Worker* worker : this->_workers) {
+        delete[] worker->jobs;
+        for (Job* job : worker->overflow)
+            delete job;
+        delete worker;
+    }
+}
+
+unsigned int JobSystem::workerIndex() const
+{
+    return currentSystem == this ? currentIndex : 0;
+}
+
+JobSystem::Job* JobSystem::allocate(Worker& worker)
+{
+    // A slot is free once its job completed, the acquire pairs with the count dropping in finish()
+    for (unsigned int i = 0; i < JOB_CAPACITY; i++) {
+        Job* job = &worker.jobs[worker.allocated++ & (JOB_CAPACITY - 1)];
+        if (job->unfinished.load(std::memory_order_acquire) == 0)
+            return job;
+    }
+    // Whole ring pending, as with deep graphs built before run()
+    for (Job* job : worker.overflow) {
+        if (job->unfinished.load(std::memory_order_acquire) == 0)
+            return job;
+    }
+    worker.overflow.push_back(new Job());
+    return worker.overflow.back();
+}
+
+JobSystem::Job* JobSystem::create(Function function, void* data, unsigned int begin, unsigned int end,
+    unsigned int grain, Job* parent)
+{
+    Worker& worker = *this->_workers[workerIndex()];
+    Job* job = allocate(worker);
+    job->function = function;
+    job->data = data;
+    job->begin = begin;
+    job->end = end;
+    job->grain = grain;
+    job->parent = parent;
+    job->unfinished.store(1, std::memory_order_relaxed);
+    job->continuationCount = 0;
+    if (parent)
+        parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::then(Job* job, Job* continuation)
+{
+    if (job->continuationCount < MAX_CONTINUATIONS) {
+        job->continuations[job->continuationCount++] = continuation;
+        return;
+    }
+    // Further continuations are chained to a job that does nothing
+    Job* relay = create(nullptr, nullptr);
+    relay->continuations[relay->continuationCount++] = job->continuations[MAX_CONTINUATIONS - 1];
+    relay->continuations[relay->continuationCount++] = continuation;
+    job->continuations[MAX_CONTINUATIONS - 1] = relay;
+}
+
+void JobSystem::run(Job* job)
+{
+    unsigned int index = workerIndex();
+    if (!this->_workers[index]->deque.push(job)) {
+        // Deque full, the job runs right away rather than waiting for room
+        execute(job);
+        return;
+    }
+    this->_queued.fetch_add(1, std::memory_order_release);
+    if (this->_sleeping.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_wake.notify_one();
+    }
+}
+
+void JobSystem::wait(const Job* job)
+{
+    unsigned int index = workerIndex();
+    while (job->unfinished.load(std::memory_order_acquire) > 0) {
+        Job* next = take(index);
+        if (next)
+            execute(next);
+        else
+            std::this_thread::yield();
+    }
+}
+
+JobSystem::Job* JobSystem::take(unsigned int index)
+{
+    Job* job = this->_workers[index]->deque.pop();
+    const unsigned int count = (unsigned int)this->_workers.size();
+    // Victims are visited from the next thread on, so that thieves spread over the pool
+    for (unsigned int i = 1; !job && i < count; i++)
+        job = this->_workers[(index + i) % count]->deque.steal();
+    if (job)
+        this->_queued.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::execute(Job* job)
+{
+    // Halves beyond the grain size become children, left to other threads to steal
+    while (job->grain > 0 && job->end - job->begin > job->grain) {
+        unsigned int middle = job->begin + (job->end - job->begin) / 2;
+        Job* half = create(job->function, job->data, middle, job->end, job->grain, job);
+        job->end = middle;
+        run(half);
+    }
+    if (job->function)
+        job->function(job->data, job->begin, job->end);
+    finish(job);
+}
+
+void JobSystem::finish(Job* job)
+{
+    // Read before the count drops: a completed job may be recycled at once
+    Job* parent = job->parent;
+    unsigned int continuationCount = job->continuationCount;
+    Job* continuations[MAX_CONTINUATIONS];
+    std::copy(job->continuations, job->continuations + continuationCount, continuations);
+
+    if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    for (unsigned int i = 0; i < continuationCount; i++)
+        run(continuations[i]);
+    if (parent)
+        finish(parent);
+}
+
+void JobSystem::loop(unsigned int index)
+{
+    currentSystem = this;
+    currentIndex = index;
+
+    unsigned int idle = 0;
+    while (this->_running.load(std::memory_order_acquire)) {
+        Job* job = take(index);
+        if (job) {
+            execute(job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < SPIN_COUNT) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // The timeout covers a job queued between the check and the sleep
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        this->_sleeping.fetch_add(1);
+        this->_wake.wait_for(lock, std::chrono::milliseconds(1), [this]() {
+            return this->_queued.load(std::memory_order_acquire) > 0 || !this->_running.load();
+        });
+        this->_sleeping.fetch_sub(1);
+        idle = 0;
+    }
+}
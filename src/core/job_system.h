@@ -0,0 +1,124 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+* Fixed pool of worker threads running small jobs. Every thread has its own deque: it pushes
+* and pops the jobs it creates at the bottom, idle threads steal from the top of the others
+* (Chase-Lev), so there is no shared queue to contend on.
+* A job runs a function over a range of items, and splits itself in halves down to its grain
+* size when it has one, the halves being stolen by idle threads. Jobs form graphs:
+* - a job created with a parent keeps the parent from completing until it has completed,
+* - continuations are run once the job they follow completed.
+* The thread calling wait() runs jobs meanwhile. Only one thread outside the pool may create,
+* run and wait for jobs at a time
+*/
+class JobSystem
+{
+public:
+    typedef void (*Function)(void* data, unsigned int begin, unsigned int end);
+
+    struct Job;
+
+    /*
+    * threads counts the calling thread, 0 for one per hardware thread
+    */
+    JobSystem(unsigned int threads = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    inline unsigned int threads() const { return (unsigned int)this->_workers.size(); }
+
+    /*
+    * Job calling function on [begin, end), in pieces of at most grain items when grain is not 0.
+    * A null function makes a job that only groups its children. Nothing runs before run().
+    * Storage is recycled once the job completed, so a job must not be used after its completion
+    * and JOB_CAPACITY further creations from the same thread. Jobs still pending keep their storage
+    */
+    Job* create(Function function, void* data, unsigned int begin = 0, unsigned int end = 1,
+        unsigned int grain = 0, Job* parent = nullptr);
+
+    /*
+    * Runs continuation once job completed. Both must not be running yet
+    */
+    void then(Job* job, Job* continuation);
+
+    void run(Job* job);
+
+    /*
+    * Returns once the job and its children completed, running other jobs meanwhile
+    */
+    void wait(const Job* job);
+
+    /*
+    * Calls body(begin, end) over [0, count) in pieces of at most grain items, and waits for all of them
+    */
+    template<typename Body>
+    void parallelFor(unsigned int count, unsigned int grain, const Body& body)
+    {
+        Job* job = create(&invokeBody<Body>, const_cast<Body*>(&body), 0, count, grain);
+        run(job);
+        wait(job);
+    }
+
+    static const unsigned int JOB_CAPACITY = 8192;
+private:
+    template<typename Body>
+    static void invokeBody(void* data, unsigned int begin, unsigned int end)
+    {
+        (*static_cast<const Body*>(data))(begin, end);
+    }
+
+    /*
+    * Chase-Lev deque: push and pop by the owner at the bottom, steal by any thread at the top
+    */
+    class Deque
+    {
+    public:
+        Deque();
+        bool push(Job* job);
+        Job* pop();
+        Job* steal();
+    private:
+        std::atomic<int64_t> _top;
+        std::atomic<int64_t> _bottom;
+        std::atomic<Job*> _entries[JOB_CAPACITY];
+    };
+
+    struct Worker
+    {
+        Deque deque;
+        Job* jobs;
+        unsigned int allocated;
+        // Jobs created while all of the ring was pending, recycled once completed
+        std::vector<Job*> overflow;
+        std::thread thread;
+    };
+
+    unsigned int workerIndex() const;
+    Job* allocate(Worker& worker);
+    Job* take(unsigned int index);
+    void execute(Job* job);
+    void finish(Job* job);
+    void loop(unsigned int index);
+private:
+    // Index 0 is the thread outside the pool, its deque is stolen from like the others
+    std::vector<Worker*> _workers;
+    std::atomic<bool> _running;
+
+    // Jobs waiting in the deques, and sleeping workers woken when it becomes positive
+    std::atomic<int> _queued;
+    std::atomic<int> _sleeping;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+};
+
+#endif // JOB_SYSTEM_H
@@ -0,0 +1,38 @@
+#include "local_pose.h"
+
+#include <algorithm>
+
+LocalPose::LocalPose() : _size(0), _padded(0), _channels({}), _rotations({})
+{
+
+}
+
+void LocalPose::resize(unsigned int count)
+{
+    this->_size = count;
+    this->_padded = (count + 3) & ~3u;
+    this->_channels.assign(CHANNELS * this->_padded, 0.f);
+    this->_rotations.assign(this->_padded, glm::quat(1.f, 0.f, 0.f, 0.f));
+    for (unsigned int axis = 0; axis < 3; axis++)
+        std::fill(scale(axis), scale(axis) + this->_padded, 1.f);
+}
+
+Transformation LocalPose::transform(unsigned int index) const
+{
+    return Transformation(glm::vec3(translation(0)[index], translation(1)[index], translation(2)[index]),
+        this->_rotations[index], glm::vec3(scale(0)[index], scale(1)[index], scale(2)[index]));
+}
+
+void LocalPose::setTransform(unsigned int index, const Transformation& transform)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        translation(axis)[index] = transform.position()[axis];
+        scale(axis)[index] = transform.scale()[axis];
+    }
+    this->_rotations[index] = transform.rotation();
+}
+
+void LocalPose::setIdentity(unsigned int index)
+{
+    setTransform(index, Transformation(glm::vec3(0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f)));
+}
@@ -0,0 +1,56 @@
+#ifndef LOCAL_POSE_H
+#define LOCAL_POSE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "transformation.h"
+
+/*
+* Local transforms of a skeleton in FlatSkeleton order, before the hierarchy is applied.
+* Translations and scales are stored one channel per axis, rotations as quaternions, all
+* padded with identity to a multiple of 4 bones so that blends run as batch kernels over
+* contiguous arrays
+*/
+class LocalPose
+{
+public:
+    LocalPose();
+
+    /*
+    * Sets the bone count, every bone is left as identity
+    */
+    void resize(unsigned int count);
+
+    inline unsigned int size() const { return this->_size; }
+    inline unsigned int padded() const { return this->_padded; }
+
+    inline float* translation(int axis) { return &this->_channels[axis * this->_padded]; }
+    inline const float* translation(int axis) const { return &this->_channels[axis * this->_padded]; }
+    inline float* scale(int axis) { return &this->_channels[(3 + axis) * this->_padded]; }
+    inline const float* scale(int axis) const { return &this->_channels[(3 + axis) * this->_padded]; }
+
+    /*
+    * Translation then scale channels back to back, CHANNELS * padded() floats
+    */
+    inline float* channels() { return &this->_channels[0]; }
+    inline const float* channels() const { return &this->_channels[0]; }
+
+    inline glm::quat* rotations() { return &this->_rotations[0]; }
+    inline const glm::quat* rotations() const { return &this->_rotations[0]; }
+
+    Transformation transform(unsigned int index) const;
+    void setTransform(unsigned int index, const Transformation& transform);
+    void setIdentity(unsigned int index);
+
+    static const unsigned int CHANNELS = 6;
+private:
+    unsigned int _size;
+    unsigned int _padded;
+
+    std::vector<float> _channels;
+    std::vector<glm::quat> _rotations;
+};
+
+#endif // LOCAL_POSE_H
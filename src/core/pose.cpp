@@ -0,0 +1,250 @@
+#include "pose.h"
+
+#include <cmath>
+
+#include "affine.h"
+#include "simd_math.h"
+
+bool findKeyFrames(const std::vector<KeyFrame>& keyFrames, float animationTime,
+    const KeyFrame*& current, const KeyFrame*& next, float& progression)
+{
+    if (keyFrames.empty())
+        return false;
+
+    unsigned int currentKeyFrameIdx = 0;
+    for (unsigned int index = 0; index < keyFrames.size() - 1; ++index)
+    {
+        if (animationTime < keyFrames[index + 1].timeStamp)
+        {
+            currentKeyFrameIdx = index;
+            break;
+        }
+    }
+    current = &keyFrames[currentKeyFrameIdx];
+    next = &keyFrames[(currentKeyFrameIdx + 1) % keyFrames.size()];
+    float timeStamp1 = current->timeStamp;
+    float timeStamp2 = next->timeStamp;
+    progression = (animationTime - timeStamp1) / (timeStamp2 - timeStamp1);
+    if (timeStamp1 > animationTime)
+    {
+        progression = 0; // Happens when first timeStamp > 0
+    }
+    return true;
+}
+
+/*
+* Interpolated key of the track at animationTime, false when the bone is not animated
+*/
+static bool sampleKeyFrames(const std::vector<KeyFrame>& keyFrames, float animationTime, RotationInterpolation mode,
+    Transformation& output)
+{
+    const KeyFrame* current;
+    const KeyFrame* next;
+    float progression;
+    if (!findKeyFrames(keyFrames, animationTime, current, next, progression))
+        return false;
+    output = Transformation::interpolate(current->transform, next->transform, progression, mode);
+    return true;
+}
+
+void getPose(Animation& animation, Bone& bone, float animationTime, std::vector<glm::mat4>& output, glm::mat4& parentTransform, glm::mat4& globalInverseTransform, const std::vector<bool>* kept) {
+    animationTime = fmod(animationTime, animation.duration());
+    glm::mat4 globalTransform = parentTransform;
+    Transformation newTransform;
+    if (sampleKeyFrames(animation.getBoneKeyFrames(bone.name()), animationTime, animation.interpolation(), newTransform))
+        globalTransform = parentTransform * newTransform.toTransformMatrix();
+    output[bone.id()] = globalInverseTransform * globalTransform * bone.offset();
+
+    for (Bone& child : bone.children()) {
+        // Bones dropped by the skeleton LOD take their ancestor's palette entry afterwards
+        if (kept && !(*kept)[child.id()])
+            continue;
+        getPose(animation, child, animationTime, output, globalTransform, globalInverseTransform, kept);
+    }
+}
+
+bool sampleBoneLocal(Animation& animation, const std::string& boneName, float animationTime, Transformation& output) {
+    animationTime = fmod(animationTime, animation.duration());
+    return sampleKeyFrames(animation.getBoneKeyFrames(boneName), animationTime, animation.interpolation(), output);
+}
+
+void sampleReferencePose(Animation& animation, float animationTime, ReferencePose& output) {
+    animationTime = fmod(animationTime, animation.duration());
+    output.clear();
+    for (const std::pair<const std::string, std::vector<KeyFrame>>& entry : animation.boneKeyFrames()) {
+        Transformation transform;
+        if (sampleKeyFrames(entry.second, animationTime, animation.interpolation(), transform))
+            output[entry.first] = transform;
+    }
+}
+
+void sampleLocalPose(Animation& animation, const FlatSkeleton& skeleton, float animationTime, LocalPose& output,
+    const std::vector<bool>* kept, const float* weights) {
+    animationTime = fmod(animationTime, animation.duration());
+    const unsigned int count = skeleton.size();
+    if (output.size() != count)
+        output.resize(count);
+
+    // Grown once per thread, steady-state evaluation does not allocate
+    static thread_local std::vector<float> progressions;
+    static thread_local std::vector<glm::quat> startRotations, endRotations;
+    if (progressions.size() < count) {
+        progressions.resize(count);
+        startRotations.resize(count);
+        endRotations.resize(count);
+    }
+
+    // Translations and scales go straight to their channels, identity for non animated bones.
+    // Key rotations are gathered and interpolated afterwards in one batch
+    const glm::quat identity(1.f, 0.f, 0.f, 0.f);
+    float* tx = output.translation(0);
+    float* ty = output.translation(1);
+    float* tz = output.translation(2);
+    float* sx = output.scale(0);
+    float* sy = output.scale(1);
+    float* sz = output.scale(2);
+    for (unsigned int i = 0; i < count; i++) {
+        const KeyFrame* current;
+        const KeyFrame* next;
+        float progression;
+        bool animated = (!kept || (*kept)[skeleton.id(i)]) && (!weights || weights[i] != 0.f)
+            && findKeyFrames(animation.getBoneKeyFrames(skeleton.name(i)), animationTime, current, next, progression);
+        if (!animated) {
+            tx[i] = ty[i] = tz[i] = 0.f;
+            sx[i] = sy[i] = sz[i] = 1.f;
+            startRotations[i] = endRotations[i] = identity;
+            progressions[i] = 0.f;
+            continue;
+        }
+
+        glm::vec3 position = glm::mix(current->transform.position(), next->transform.position(), progression);
+        glm::vec3 scale = glm::mix(current->transform.scale(), next->transform.scale(), progression);
+        tx[i] = position.x; ty[i] = position.y; tz[i] = position.z;
+        sx[i] = scale.x; sy[i] = scale.y; sz[i] = scale.z;
+        startRotations[i] = current->transform.rotation();
+        endRotations[i] = next->transform.rotation();
+        progressions[i] = progression;
+    }
+    Transformation::interpolateRotations(&startRotations[0], &endRotations[0], &progressions[0], output.rotations(), count,
+        animation.interpolation());
+}
+
+/*
+* Skinning matrices of a local pose in FlatSkeleton order, in storage reused by the next call.
+* Kept sets are closed under ancestors: a skipped bone has no evaluated descendant
+*/
+static const glm::mat4x3* resolvePalette(const LocalPose& pose, const FlatSkeleton& skeleton,
+    const glm::mat4x3& globalInverse, const std::vector<bool>* kept) {
+    const unsigned int count = skeleton.size();
+    const unsigned int padded = pose.padded();
+
+    static thread_local std::vector<float> rotationChannels;
+    static thread_local std::vector<glm::mat4x3> locals, globals;
+    if (rotationChannels.size() < 4 * padded) {
+        rotationChannels.resize(4 * padded);
+        locals.resize(padded);
+        globals.resize(padded);
+    }
+
+    // Rotations as structure of arrays for the compose kernel, padding included
+    float* qx = &rotationChannels[0];
+    float* qy = qx + padded;
+    float* qz = qy + padded;
+    float* qw = qz + padded;
+    const glm::quat* rotations = pose.rotations();
+    for (unsigned int i = 0; i < padded; i++) {
+        qx[i] = rotations[i].x; qy[i] = rotations[i].y; qz[i] = rotations[i].z; qw[i] = rotations[i].w;
+    }
+    composeTRSBatch(pose.translation(0), pose.translation(1), pose.translation(2), qx, qy, qz, qw,
+        pose.scale(0), pose.scale(1), pose.scale(2), &locals[0], padded);
+
+    // Parents come first, so every global is ready when its children need it. The global
+    // inverse is applied once at the root instead of once per bone
+    for (unsigned int i = 0; i < count; i++) {
+        int parent = skeleton.parent(i);
+        if (parent < 0)
+            concatAffineBatch(&globalInverse, &locals[i], &globals[i], 1);
+        else if (kept && !(*kept)[skeleton.id(i)])
+            globals[i] = globals[parent]; // Keeps the batch below on finite values
+        else
+            concatAffineBatch(&globals[parent], &locals[i], &globals[i], 1);
+    }
+
+    // The locals are no longer needed and receive the palette
+    concatAffineBatch(&globals[0], skeleton.offsets(), &locals[0], count);
+    return &locals[0];
+}
+
+void getPoseFromLocal(const LocalPose& pose, const FlatSkeleton& skeleton, std::vector<glm::mat4>& output,
+    const glm::mat4& globalInverseTransform, const std::vector<bool>* kept) {
+    const glm::mat4x3* palette = resolvePalette(pose, skeleton, glm::mat4x3(globalInverseTransform), kept);
+    for (unsigned int i = 0; i < skeleton.size(); i++) {
+        int id = skeleton.id(i);
+        if (!kept || (*kept)[id])
+            output[id] = affineToMat4(palette[i]);
+    }
+}
+
+void getPoseDualFromLocal(const LocalPose& pose, const FlatSkeleton& skeleton, std::vector<glm::fdualquat>& output,
+    const std::vector<bool>* kept) {
+    const glm::mat4x3* palette = resolvePalette(pose, skeleton, glm::mat4x3(1.f), kept);
+    for (unsigned int i = 0; i < skeleton.size(); i++) {
+        int id = skeleton.id(i);
+        if (kept && !(*kept)[id])
+            continue;
+        const glm::mat4x3& m = palette[i];
+        glm::fdualquat res = glm::normalize(glm::fdualquat(glm::normalize(glm::quat_cast(glm::mat3(m))), m[3]));
+        if (res.dual.w == -0)
+            res.dual.w = 0;
+        output[id] = res;
+    }
+}
+
+void getPoseFlat(Animation& animation, const FlatSkeleton& skeleton, float animationTime, std::vector<glm::mat4>& output,
+    const glm::mat4& globalInverseTransform, const std::vector<bool>* kept) {
+    static thread_local LocalPose local;
+    sampleLocalPose(animation, skeleton, animationTime, local, kept);
+    getPoseFromLocal(local, skeleton, output, globalInverseTransform, kept);
+}
+
+/*
+* p * o as dual quaternions, the three quaternion products in one batch
+*/
+static glm::fdualquat multiplyDualQuat(const glm::fdualquat& p, const glm::fdualquat& o)
+{
+    const glm::quat left[3] = { p.real, p.real, p.dual };
+    const glm::quat right[3] = { o.real, o.dual, o.real };
+    glm::quat products[3];
+    multiplyQuatBatch(left, right, products, 3);
+    return glm::fdualquat(products[0], products[1] + products[2]);
+}
+
+void getPoseDual(Animation& animation, Bone& bone, float animationTime, std::vector<glm::fdualquat>& output,
+    glm::fdualquat& parentTransform, const std::vector<bool>* kept) {
+    animationTime = fmod(animationTime, animation.duration());
+    glm::fdualquat globalTransformQuat = glm::fdualquat(glm::quat(1.f, 0.f, 0.f, 0.f), glm::quat(0.f, 0.f, 0.f, 0.f));
+    Transformation newTransform;
+    if (sampleKeyFrames(animation.getBoneKeyFrames(bone.name()), animationTime, animation.interpolation(), newTransform))
+    {
+        globalTransformQuat = glm::normalize(multiplyDualQuat(parentTransform, newTransform.toDualQuat()));
+        if (globalTransformQuat.dual.w == -0)
+            globalTransformQuat.dual.w = 0;
+    }
+    glm::mat4 offset = bone.offset();
+    glm::fdualquat offsetQuat = glm::normalize(glm::fdualquat(glm::normalize(glm::quat_cast(offset)), glm::vec3(offset[3][0], offset[3][1], offset[3][2])));
+    if (offsetQuat.dual.w == -0)
+        offsetQuat.dual.w = 0;
+
+    glm::fdualquat res = glm::normalize(multiplyDualQuat(globalTransformQuat, offsetQuat));
+    if (res.dual.w == -0)
+        res.dual.w = 0;
+
+    output[bone.id()] = res;
+
+    for (Bone& child : bone.children()) {
+        // Bones dropped by the skeleton LOD take their ancestor's palette entry afterwards
+        if (kept && !(*kept)[child.id()])
+            continue;
+        getPoseDual(animation, child, animationTime, output, globalTransformQuat, kept);
+    }
+}
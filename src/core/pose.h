@@ -0,0 +1,71 @@
+#ifndef POSE_H
+#define POSE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtx/dual_quaternion.hpp>
+
+#include "animation.h"
+#include "bone.h"
+#include "flat_skeleton.h"
+#include "local_pose.h"
+
+/*
+* Evaluates the palette of every bone below the given one at animationTime.
+* Subtrees of bones absent from kept (skeleton LOD) are skipped
+*/
+void getPose(Animation& animation, Bone& bone, float animationTime, std::vector<glm::mat4>& output, glm::mat4& parentTransform, glm::mat4& globalInverseTransform, const std::vector<bool>* kept = nullptr);
+
+/*
+* Keys surrounding animationTime in a track and the progression between them, false when the
+* track is empty (bone not animated)
+*/
+bool findKeyFrames(const std::vector<KeyFrame>& keyFrames, float animationTime,
+    const KeyFrame*& current, const KeyFrame*& next, float& progression);
+
+/*
+* Local transform of one bone at animationTime, false (output untouched) when the clip does not animate it
+*/
+bool sampleBoneLocal(Animation& animation, const std::string& boneName, float animationTime, Transformation& output);
+
+/*
+* Local transform of every bone the clip animates at animationTime, e.g. the frame an additive
+* clip is made against
+*/
+void sampleReferencePose(Animation& animation, float animationTime, ReferencePose& output);
+
+/*
+* Local transforms of every bone at animationTime, identity for the bones the clip does not
+* animate, for those absent from kept and for those with a zero entry in weights (blend masks)
+*/
+void sampleLocalPose(Animation& animation, const FlatSkeleton& skeleton, float animationTime, LocalPose& output,
+    const std::vector<bool>* kept = nullptr, const float* weights = nullptr);
+
+/*
+* Palette of a local pose: local transforms are composed 4 bones at a time straight from TRS
+* and concatenated as 3x4 affine, parents first. Bones absent from kept are skipped
+*/
+void getPoseFromLocal(const LocalPose& pose, const FlatSkeleton& skeleton, std::vector<glm::mat4>& output,
+    const glm::mat4& globalInverseTransform, const std::vector<bool>* kept = nullptr);
+
+/*
+* getPose over a flattened skeleton, sampleLocalPose then getPoseFromLocal.
+* Bones absent from kept are skipped
+*/
+void getPoseFlat(Animation& animation, const FlatSkeleton& skeleton, float animationTime, std::vector<glm::mat4>& output,
+    const glm::mat4& globalInverseTransform, const std::vector<bool>* kept = nullptr);
+
+/*
+* Same as getPose with the palette stored as dual quaternions
+*/
+void getPoseDual(Animation& animation, Bone& bone, float animationTime, std::vector<glm::fdualquat>& output,
+    glm::fdualquat& parentTransform, const std::vector<bool>* kept = nullptr);
+
+/*
+* Palette of a local pose as dual quaternions, no global inverse. Unlike getPoseDual, bones the
+* clip does not animate follow their parent, as in the matrix palette
+*/
+void getPoseDualFromLocal(const LocalPose& pose, const FlatSkeleton& skeleton, std::vector<glm::fdualquat>& output,
+    const std::vector<bool>* kept = nullptr);
+
+#endif // POSE_H
@@ -0,0 +1,122 @@
+#include "pose_blend.h"
+
+#include <algorithm>
+
+#include "pose.h"
+#include "simd_math.h"
+
+BoneMask::BoneMask() : _size(0), _weights({})
+{
+
+}
+
+void BoneMask::build(const FlatSkeleton& skeleton, float weight)
+{
+    this->_size = skeleton.size();
+    this->_weights.assign((this->_size + 3) & ~3u, 0.f);
+    std::fill(this->_weights.begin(), this->_weights.begin() + this->_size, weight);
+}
+
+bool BoneMask::setSubtree(const FlatSkeleton& skeleton, const std::string& root, float weight)
+{
+    int index = skeleton.find(root);
+    if (index < 0)
+        return false;
+    if (this->_size != skeleton.size())
+        build(skeleton);
+
+    // Depth-first, parents first: the subtree is the run of entries up to the first one
+    // whose parent comes before the root
+    this->_weights[index] = weight;
+    for (unsigned int i = index + 1; i < skeleton.size() && skeleton.parent(i) >= index; i++)
+        this->_weights[i] = weight;
+    return true;
+}
+
+void blendLocalPoses(const LocalPose& a, const LocalPose& b, const float* weights, LocalPose& output, RotationInterpolation mode)
+{
+    if (output.size() != a.size())
+        output.resize(a.size());
+
+    const unsigned int padded = a.padded();
+    for (unsigned int channel = 0; channel < LocalPose::CHANNELS; channel++) {
+        unsigned int offset = channel * padded;
+        lerpBatch(a.channels() + offset, b.channels() + offset, weights, output.channels() + offset, padded);
+    }
+    Transformation::interpolateRotations(a.rotations(), b.rotations(), weights, output.rotations(), padded, mode);
+}
+
+void addLocalPose(const LocalPose& base, const LocalPose& additive, const float* weights, LocalPose& output)
+{
+    if (output.size() != base.size())
+        output.resize(base.size());
+
+    const unsigned int padded = base.padded();
+    static thread_local std::vector<glm::quat> identities, deltas;
+    if (identities.size() < padded) {
+        identities.assign(padded, glm::quat(1.f, 0.f, 0.f, 0.f));
+        deltas.resize(padded);
+    }
+
+    for (int axis = 0; axis < 3; axis++) {
+        const float* translation = base.translation(axis);
+        const float* translationDelta = additive.translation(axis);
+        const float* scale = base.scale(axis);
+        const float* scaleRatio = additive.scale(axis);
+        float* outputTranslation = output.translation(axis);
+        float* outputScale = output.scale(axis);
+        for (unsigned int i = 0; i < padded; i++) {
+            outputTranslation[i] = translation[i] + translationDelta[i] * weights[i];
+            outputScale[i] = scale[i] * (1.f + (scaleRatio[i] - 1.f) * weights[i]);
+        }
+    }
+
+    // Partial deltas are taken from identity, then applied on the local side of the base
+    nlerpBatch(&identities[0], additive.rotations(), weights, &deltas[0], padded);
+    multiplyQuatBatch(base.rotations(), &deltas[0], output.rotations(), padded);
+}
+
+void getPoseBlended(const std::vector<BlendLayer>& layers, const FlatSkeleton& skeleton, std::vector<glm::mat4>& output,
+    const glm::mat4& globalInverseTransform, const std::vector<bool>* kept, RotationInterpolation mode)
+{
+    const unsigned int count = skeleton.size();
+
+    // Grown once per thread, steady-state evaluation does not allocate
+    static thread_local LocalPose pose, sample;
+    static thread_local std::vector<float> accumulated, weights;
+    pose.resize(count);
+    const unsigned int padded = pose.padded();
+    accumulated.assign(padded, 0.f);
+    weights.resize(padded);
+
+    for (const BlendLayer& layer : layers) {
+        if (!layer.clip || layer.weight <= 0.f)
+            continue;
+        for (unsigned int i = 0; i < padded; i++)
+            weights[i] = layer.mask ? layer.weight * layer.mask->weight(i) : layer.weight;
+
+        // Bones the mask leaves out are not sampled
+        sampleLocalPose(*layer.clip, skeleton, layer.time, sample, kept, layer.mask ? &weights[0] : nullptr);
+
+        switch (layer.mode) {
+        case BlendMode::Blend:
+            // Running weighted average: each layer takes its share of the weight seen so far
+            for (unsigned int i = 0; i < padded; i++) {
+                accumulated[i] += weights[i];
+                weights[i] = accumulated[i] > 0.f ? weights[i] / accumulated[i] : 0.f;
+            }
+            blendLocalPoses(pose, sample, &weights[0], pose, mode);
+            break;
+        case BlendMode::Override:
+            for (unsigned int i = 0; i < padded; i++)
+                weights[i] = std::min(weights[i], 1.f);
+            blendLocalPoses(pose, sample, &weights[0], pose, mode);
+            break;
+        case BlendMode::Additive:
+            addLocalPose(pose, sample, &weights[0], pose);
+            break;
+        }
+    }
+
+    getPoseFromLocal(pose, skeleton, output, globalInverseTransform, kept);
+}
@@ -0,0 +1,79 @@
+#ifndef POSE_BLEND_H
+#define POSE_BLEND_H
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "animation.h"
+#include "flat_skeleton.h"
+#include "local_pose.h"
+
+/*
+* Per-bone weights of a blend layer in FlatSkeleton order, e.g. 1 on the upper body and 0
+* on the legs. Padded like LocalPose so that it multiplies layer weights as a batch
+*/
+class BoneMask
+{
+public:
+    BoneMask();
+
+    /*
+    * Every bone of the skeleton at the given weight
+    */
+    void build(const FlatSkeleton& skeleton, float weight = 0.f);
+
+    /*
+    * Sets the weight of the named bone and all its descendants, false when there is no such bone.
+    * Builds the mask at 0 first when it does not match the skeleton
+    */
+    bool setSubtree(const FlatSkeleton& skeleton, const std::string& root, float weight);
+
+    inline void set(unsigned int index, float weight) { this->_weights[index] = weight; }
+    inline float weight(unsigned int index) const { return this->_weights[index]; }
+    inline const float* weights() const { return &this->_weights[0]; }
+    inline unsigned int size() const { return this->_size; }
+private:
+    unsigned int _size;
+    std::vector<float> _weights;
+};
+
+enum class BlendMode
+{
+    Blend,    // Weighted average with the other Blend layers, by their (masked) weights
+    Override, // Moves the pose so far toward the layer by its (masked) weight
+    Additive  // Applies the layer, an additive clip (Animation::makeAdditive), scaled by its (masked) weight
+};
+
+struct BlendLayer
+{
+    Animation* clip;
+    float time;
+    float weight;
+    const BoneMask* mask; // nullptr weighs every bone fully
+    BlendMode mode;
+};
+
+/*
+* output = Transformation::interpolate(a, b, weights[i]) on every bone, weights holding padded() values.
+* output may alias a or b
+*/
+void blendLocalPoses(const LocalPose& a, const LocalPose& b, const float* weights, LocalPose& output,
+    RotationInterpolation mode = RotationInterpolation::Nlerp);
+
+/*
+* Applies an additive pose (deltas: translation offset, rotation on the right, scale ratio) on
+* every bone by weights[i]. output may alias base
+*/
+void addLocalPose(const LocalPose& base, const LocalPose& additive, const float* weights, LocalPose& output);
+
+/*
+* Samples the layers in order and blends them in local space, then resolves the hierarchy once.
+* Bones no Blend or Override layer reaches stay at identity, so the first layer usually
+* covers the whole skeleton. Layers without weight are not sampled
+*/
+void getPoseBlended(const std::vector<BlendLayer>& layers, const FlatSkeleton& skeleton, std::vector<glm::mat4>& output,
+    const glm::mat4& globalInverseTransform, const std::vector<bool>* kept = nullptr,
+    RotationInterpolation mode = RotationInterpolation::Nlerp);
+
+#endif // POSE_BLEND_H
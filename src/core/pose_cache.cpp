@@ -0,0 +1,106 @@
+#include "pose_cache.h"
+
+#include <cmath>
+
+PoseCache::PoseCache(float step, unsigned int capacity) : _step(step), _capacity(capacity), _frame(0),
+    _entries(), _free({}), _ids({}), _overflow(), _overflowUsed(0), _hits(0), _misses(0), _evictions(0)
+{
+
+}
+
+float PoseCache::snap(float time) const
+{
+    return this->_step > 0.f ? std::floor(time / this->_step + 0.5f) * this->_step : time;
+}
+
+const std::vector<glm::mat4>& PoseCache::get(unsigned int clip, float time, unsigned int lod, unsigned int boneCount,
+    const PoseSampler& samplePose)
+{
+    const float snapped = snap(time);
+    if (this->_step <= 0.f) {
+        this->_misses++;
+        return evaluateOverflow(snapped, boneCount, samplePose);
+    }
+
+    // Clip in the high bits, then the LOD, then the grid index of the time
+    const uint32_t tick = uint32_t(int32_t(std::floor(time / this->_step + 0.5f)));
+    const uint64_t key = (uint64_t(clip) << 40) | (uint64_t(lod & 0xff) << 32) | tick;
+
+    std::unordered_map<uint64_t, unsigned int>::iterator it = this->_ids.find(key);
+    if (it != this->_ids.end()) {
+        Entry& entry = this->_entries[it->second];
+        entry.lastUsed = this->_frame;
+        this->_hits++;
+        return entry.palette;
+    }
+
+    this->_misses++;
+    if (this->_ids.size() >= this->_capacity)
+        sweep();
+    if (this->_ids.size() >= this->_capacity)
+        return evaluateOverflow(snapped, boneCount, samplePose);
+
+    // Slots of dropped entries are reused along with their palette storage
+    unsigned int index;
+    if (!this->_free.empty()) {
+        index = this->_free.back();
+        this->_free.pop_back();
+    }
+    else {
+        index = (unsigned int)this->_entries.size();
+        this->_entries.push_back(Entry());
+    }
+    Entry& entry = this->_entries[index];
+    entry.key = key;
+    entry.lastUsed = this->_frame;
+    entry.palette.assign(boneCount, glm::mat4(1.f));
+    samplePose(snapped, entry.palette);
+    this->_ids[key] = index;
+    return entry.palette;
+}
+
+const std::vector<glm::mat4>& PoseCache::evaluateOverflow(float snapped, unsigned int boneCount, const PoseSampler& samplePose)
+{
+    if (this->_overflowUsed == this->_overflow.size())
+        this->_overflow.push_back(std::vector<glm::mat4>());
+    std::vector<glm::mat4>& palette = this->_overflow[this->_overflowUsed++];
+    palette.assign(boneCount, glm::mat4(1.f));
+    samplePose(snapped, palette);
+    return palette;
+}
+
+void PoseCache::sweep()
+{
+    // Only entries of earlier frames give their slot back, the palettes of this frame stay in place
+    for (std::unordered_map<uint64_t, unsigned int>::iterator it = this->_ids.begin(); it != this->_ids.end();) {
+        if (this->_entries[it->second].lastUsed != this->_frame) {
+            this->_free.push_back(it->second);
+            it = this->_ids.erase(it);
+            this->_evictions++;
+        }
+        else
+            ++it;
+    }
+}
+
+void PoseCache::beginFrame()
+{
+    this->_frame++;
+    this->_overflowUsed = 0;
+}
+
+void PoseCache::clear()
+{
+    this->_ids.clear();
+    this->_free.clear();
+    for (unsigned int i = 0; i < this->_entries.size(); i++)
+        this->_free.push_back(i);
+    this->_overflowUsed = 0;
+}
+
+void PoseCache::resetStats()
+{
+    this->_hits = 0;
+    this->_misses = 0;
+    this->_evictions = 0;
+}
@@ -0,0 +1,91 @@
+#ifndef POSE_CACHE_H
+#define POSE_CACHE_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*
+* Palettes shared by instances that play the same clip at nearly the same phase (marching
+* bands, idle crowds). Sample times are snapped to a grid of step seconds and the palette of
+* each (clip, snapped time, LOD) is evaluated once, then handed to every instance asking for it.
+* Snapping trades up to step / 2 of timing for the sharing, a step of 0 disables it.
+* Entries live across frames; when the cache is full, those not used during the current frame go.
+* Entries never move, so a palette handed out stays in place until the end of its frame and
+* every instance of the frame can keep a reference to it instead of a copy
+*/
+class PoseCache
+{
+public:
+    typedef std::function<void(float, std::vector<glm::mat4>&)> PoseSampler;
+
+    PoseCache(float step = 1.f / 120.f, unsigned int capacity = 1024);
+
+    inline void setStep(float step) { this->_step = step; clear(); }
+    inline float step() const { return this->_step; }
+    inline void setCapacity(unsigned int capacity) { this->_capacity = capacity; }
+    inline unsigned int capacity() const { return this->_capacity; }
+
+    /*
+    * Time the palette of an instance at time is actually evaluated at
+    */
+    float snap(float time) const;
+
+    /*
+    * Palette of the clip at the snapped time, time being within the clip. On a miss,
+    * samplePose(snapped time, palette) fills a palette of boneCount identity matrices.
+    * The palette stays valid and unchanged until the next beginFrame(), clear() or setStep()
+    */
+    const std::vector<glm::mat4>& get(unsigned int clip, float time, unsigned int lod, unsigned int boneCount,
+        const PoseSampler& samplePose);
+
+    /*
+    * Starts a new frame, entries used before it become the first to be dropped and the
+    * palettes handed out so far may be reused
+    */
+    void beginFrame();
+
+    /*
+    * Drops every entry, for instance when clips are reloaded
+    */
+    void clear();
+
+    inline unsigned int size() const { return (unsigned int)this->_ids.size(); }
+    inline uint64_t hits() const { return this->_hits; }
+    inline uint64_t misses() const { return this->_misses; }
+    inline uint64_t evictions() const { return this->_evictions; }
+    inline float hitRate() const { return this->_hits + this->_misses ? float(this->_hits) / float(this->_hits + this->_misses) : 0.f; }
+    void resetStats();
+private:
+    struct Entry
+    {
+        uint64_t key;
+        unsigned int lastUsed;
+        std::vector<glm::mat4> palette;
+    };
+
+    const std::vector<glm::mat4>& evaluateOverflow(float snapped, unsigned int boneCount, const PoseSampler& samplePose);
+    void sweep();
+private:
+    float _step;
+    unsigned int _capacity;
+    unsigned int _frame;
+
+    // A deque so that adding slots leaves the others in place, free slots keep their palette storage
+    std::deque<Entry> _entries;
+    std::vector<unsigned int> _free;
+    std::unordered_map<uint64_t, unsigned int> _ids;
+    // Palettes evaluated without being kept (cache full of palettes of this frame, or no step),
+    // one per such get() of the frame, reused from frame to frame
+    std::deque<std::vector<glm::mat4>> _overflow;
+    unsigned int _overflowUsed;
+
+    uint64_t _hits;
+    uint64_t _misses;
+    uint64_t _evictions;
+};
+
+#endif // POSE_CACHE_H
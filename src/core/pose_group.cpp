@@ -0,0 +1,206 @@
+#include "pose_group.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "affine.h"
+#include "pose.h"
+#include "simd_math.h"
+
+// Channels of _channels: 6 start channels, 6 end channels, the progressions
+static const unsigned int SAMPLE_CHANNELS = 2 * 6 + 1;
+
+/*
+* The same transform in every lane of one bone of the lanes layout
+*/
+static void broadcastLanes(const glm::mat4x3& m, float* output, unsigned int width)
+{
+    for (unsigned int e = 0; e < 12; e++)
+        std::fill(output + e * width, output + (e + 1) * width, (&m[0][0])[e]);
+}
+
+PoseGroup::PoseGroup() : _skeleton(nullptr), _width(0), _entries(0)
+{
+
+}
+
+unsigned int PoseGroup::preferredWidth()
+{
+    return simdLevel() == SimdLevel::AVX2 ? 8 : 4;
+}
+
+void PoseGroup::build(const FlatSkeleton& skeleton, const glm::mat4& globalInverseTransform, unsigned int width)
+{
+    if (width == 0)
+        width = preferredWidth();
+    if (width % 4 != 0) {
+        std::cout << "WARNING::POSE_GROUP::WIDTH " << width << " is not a multiple of 4, using " << ((width + 3) & ~3u) << std::endl;
+        width = (width + 3) & ~3u;
+    }
+
+    const unsigned int bones = skeleton.size();
+    this->_skeleton = &skeleton;
+    this->_width = width;
+    this->_entries = bones * width;
+
+    this->_revisions.assign(width, 0);
+    this->_tracks.assign(width * bones, nullptr);
+
+    this->_channels.assign(SAMPLE_CHANNELS * this->_entries, 0.f);
+    this->_startRotations.resize(this->_entries);
+    this->_endRotations.resize(this->_entries);
+    this->_rotations.resize(this->_entries);
+    this->_rotationChannels.resize(4 * this->_entries);
+
+    this->_locals.resize(12 * this->_entries);
+    this->_globals.resize(12 * this->_entries);
+    this->_palette.resize(12 * this->_entries);
+    this->_offsets.resize(12 * this->_entries);
+    for (unsigned int i = 0; i < bones; i++)
+        broadcastLanes(skeleton.offset(i), &this->_offsets[12 * width * i], width);
+    this->_globalInverse.resize(12 * width);
+    broadcastLanes(glm::mat4x3(globalInverseTransform), &this->_globalInverse[0], width);
+
+    this->_laneStart.resize(bones);
+    this->_laneEnd.resize(bones);
+    this->_laneRotations.resize(bones);
+    this->_laneProgressions.resize(bones);
+}
+
+void PoseGroup::evaluate(Animation* const* animations, const float* times, unsigned int count,
+    std::vector<glm::mat4>* const* outputs)
+{
+    if (!this->_skeleton) {
+        std::cout << "ERROR::POSE_GROUP::NOT_BUILT" << std::endl;
+        return;
+    }
+    for (unsigned int first = 0; first < count; first += this->_width)
+        evaluateGroup(animations + first, times + first, std::min(this->_width, count - first), outputs + first);
+}
+
+void PoseGroup::invalidate()
+{
+    std::fill(this->_revisions.begin(), this->_revisions.end(), 0u);
+    std::fill(this->_tracks.begin(), this->_tracks.end(), nullptr);
+}
+
+void PoseGroup::sampleLane(unsigned int lane, Animation& animation, float animationTime)
+{
+    animationTime = fmod(animationTime, animation.duration());
+    const FlatSkeleton& skeleton = *this->_skeleton;
+    const unsigned int bones = skeleton.size();
+    const unsigned int entries = this->_entries;
+
+    const std::vector<KeyFrame>** tracks = &this->_tracks[lane * bones];
+    // The address alone would not do: an evicted clip decoded again may land where another one was
+    if (this->_revisions[lane] != animation.revision()) {
+        for (unsigned int i = 0; i < bones; i++)
+            tracks[i] = &animation.getBoneKeyFrames(skeleton.name(i));
+        this->_revisions[lane] = animation.revision();
+    }
+
+    // Keys are gathered in their lanes, the interpolation itself runs over all lanes at once
+    const glm::quat identity(1.f, 0.f, 0.f, 0.f);
+    float* start = &this->_channels[0];
+    float* end = start + 6 * entries;
+    float* progressions = end + 6 * entries;
+    for (unsigned int i = 0, index = lane; i < bones; i++, index += this->_width) {
+        const KeyFrame* current;
+        const KeyFrame* next;
+        float progression;
+        if (!findKeyFrames(*tracks[i], animationTime, current, next, progression)) {
+            for (unsigned int axis = 0; axis < 3; axis++) {
+                start[axis * entries + index] = end[axis * entries + index] = 0.f;
+                start[(3 + axis) * entries + index] = end[(3 + axis) * entries + index] = 1.f;
+            }
+            this->_startRotations[index] = this->_endRotations[index] = identity;
+            progressions[index] = 0.f;
+            continue;
+        }
+
+        for (unsigned int axis = 0; axis < 3; axis++) {
+            start[axis * entries + index] = current->transform.position()[axis];
+            end[axis * entries + index] = next->transform.position()[axis];
+            start[(3 + axis) * entries + index] = current->transform.scale()[axis];
+            end[(3 + axis) * entries + index] = next->transform.scale()[axis];
+        }
+        this->_startRotations[index] = current->transform.rotation();
+        this->_endRotations[index] = next->transform.rotation();
+        progressions[index] = progression;
+    }
+}
+
+void PoseGroup::interpolateLane(unsigned int lane, RotationInterpolation mode)
+{
+    const unsigned int bones = this->_skeleton->size();
+    const float* progressions = &this->_channels[12 * this->_entries];
+    for (unsigned int i = 0, index = lane; i < bones; i++, index += this->_width) {
+        this->_laneStart[i] = this->_startRotations[index];
+        this->_laneEnd[i] = this->_endRotations[index];
+        this->_laneProgressions[i] = progressions[index];
+    }
+    Transformation::interpolateRotations(&this->_laneStart[0], &this->_laneEnd[0], &this->_laneProgressions[0],
+        &this->_laneRotations[0], bones, mode);
+    for (unsigned int i = 0, index = lane; i < bones; i++, index += this->_width)
+        this->_rotations[index] = this->_laneRotations[i];
+}
+
+void PoseGroup::evaluateGroup(Animation* const* animations, const float* times, unsigned int count,
+    std::vector<glm::mat4>* const* outputs)
+{
+    const FlatSkeleton& skeleton = *this->_skeleton;
+    const unsigned int bones = skeleton.size();
+    const unsigned int width = this->_width;
+    const unsigned int entries = this->_entries;
+    const unsigned int stride = 12 * width;
+
+    for (unsigned int lane = 0; lane < width; lane++) {
+        unsigned int source = lane < count ? lane : 0;
+        sampleLane(lane, *animations[source], times[source]);
+    }
+
+    // Translations and scales are interpolated in place of their start channels
+    float* channels = &this->_channels[0];
+    const float* progressions = channels + 12 * entries;
+    for (unsigned int channel = 0; channel < 6; channel++)
+        lerpBatch(channels + channel * entries, channels + (6 + channel) * entries, progressions, channels + channel * entries, entries);
+
+    RotationInterpolation mode = animations[0]->interpolation();
+    Transformation::interpolateRotations(&this->_startRotations[0], &this->_endRotations[0], progressions,
+        &this->_rotations[0], entries, mode);
+    for (unsigned int lane = 1; lane < count; lane++) {
+        if (animations[lane]->interpolation() != mode)
+            interpolateLane(lane, animations[lane]->interpolation());
+    }
+
+    float* qx = &this->_rotationChannels[0];
+    float* qy = qx + entries;
+    float* qz = qy + entries;
+    float* qw = qz + entries;
+    for (unsigned int i = 0; i < entries; i++) {
+        const glm::quat& rotation = this->_rotations[i];
+        qx[i] = rotation.x; qy[i] = rotation.y; qz[i] = rotation.z; qw[i] = rotation.w;
+    }
+    composeTRSLanes(channels, channels + entries, channels + 2 * entries, qx, qy, qz, qw,
+        channels + 3 * entries, channels + 4 * entries, channels + 5 * entries, &this->_locals[0], entries, width);
+
+    // One parent multiply per bone for every lane, parents first as in getPoseFromLocal
+    for (unsigned int i = 0; i < bones; i++) {
+        int parent = skeleton.parent(i);
+        const float* parentGlobal = parent < 0 ? &this->_globalInverse[0] : &this->_globals[parent * stride];
+        concatAffineLanes(parentGlobal, &this->_locals[i * stride], &this->_globals[i * stride], width, 1);
+    }
+    concatAffineLanes(&this->_globals[0], &this->_offsets[0], &this->_palette[0], width, bones);
+
+    for (unsigned int lane = 0; lane < count; lane++) {
+        std::vector<glm::mat4>& output = *outputs[lane];
+        for (unsigned int i = 0; i < bones; i++) {
+            const float* elements = &this->_palette[i * stride + lane];
+            glm::mat4x3 affine;
+            for (unsigned int e = 0; e < 12; e++)
+                (&affine[0][0])[e] = elements[e * width];
+            output[skeleton.id(i)] = affineToMat4(affine);
+        }
+    }
+}
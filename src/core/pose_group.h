@@ -0,0 +1,80 @@
+#ifndef POSE_GROUP_H
+#define POSE_GROUP_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "animation.h"
+#include "flat_skeleton.h"
+
+/*
+* Palettes of several characters sharing a skeleton, evaluated side by side: every bone stores
+* its values for all the characters of a group (lanes) next to each other (AoSoA), so that the
+* interpolation, the compose and the parent multiply of a bone run for all lanes in the same
+* SIMD instructions. Suits crowds of one archetype, where characters only differ by clip and
+* time. Key searches stay per lane since those diverge; each lane remembers the tracks of its
+* clip by Animation::revision(), so that switching clips is the only time bone names are looked
+* up, and a clip evicted from an AnimationLibrary then decoded again is looked up anew
+*/
+class PoseGroup
+{
+public:
+    PoseGroup();
+
+    /*
+    * Lanes per group for the running kernels: 8 with AVX2, 4 otherwise
+    */
+    static unsigned int preferredWidth();
+
+    /*
+    * Sets the skeleton and the lanes per group (a multiple of 4, 0 for preferredWidth())
+    */
+    void build(const FlatSkeleton& skeleton, const glm::mat4& globalInverseTransform, unsigned int width = 0);
+
+    inline unsigned int width() const { return this->_width; }
+
+    /*
+    * Palettes of count characters, character k playing animations[k] at times[k], written to
+    * *outputs[k] by bone ID like getPoseFlat. Characters go width() at a time, the lanes left
+    * over in the last group repeat its first character and are dropped. The animations must
+    * stay alive for the call; between calls they may be freed, the cached tracks of a lane are
+    * only used while its clip keeps the same revision
+    */
+    void evaluate(Animation* const* animations, const float* times, unsigned int count,
+        std::vector<glm::mat4>* const* outputs);
+
+    /*
+    * Forgets the tracks cached by every lane, e.g. to release them with their clips
+    */
+    void invalidate();
+private:
+    void evaluateGroup(Animation* const* animations, const float* times, unsigned int count,
+        std::vector<glm::mat4>* const* outputs);
+    void sampleLane(unsigned int lane, Animation& animation, float animationTime);
+    void interpolateLane(unsigned int lane, RotationInterpolation mode);
+private:
+    const FlatSkeleton* _skeleton;
+    unsigned int _width;
+    // Entries per channel: bones * width, lane l of bone i at i * width + l
+    unsigned int _entries;
+
+    // Per lane: the revision of the clip its tracks were looked up for (0 for none), then one track per bone
+    std::vector<unsigned int> _revisions;
+    std::vector<const std::vector<KeyFrame>*> _tracks;
+
+    // Start then end translation and scale channels, then the progressions
+    std::vector<float> _channels;
+    std::vector<glm::quat> _startRotations, _endRotations, _rotations;
+    std::vector<float> _rotationChannels;
+
+    // Lanes layout, 12 * width floats per bone
+    std::vector<float> _locals, _globals, _palette, _offsets;
+    std::vector<float> _globalInverse;
+
+    // One lane's rotations, for lanes whose clip interpolates differently from the first
+    std::vector<glm::quat> _laneStart, _laneEnd, _laneRotations;
+    std::vector<float> _laneProgressions;
+};
+
+#endif // POSE_GROUP_H
@@ -0,0 +1,1020 @@
+#include "simd_math.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "affine.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define SIMD_AVX2_TARGET
+#else
+// Compiled for AVX2 whatever the build flags, only ever called after the CPU check
+#define SIMD_AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+static_assert(sizeof(glm::mat4x3) == 12 * sizeof(float), "kernels read mat4x3 as 12 packed floats");
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "kernels read mat4 as 16 packed floats");
+static_assert(sizeof(glm::quat) == 4 * sizeof(float), "kernels read quat as x, y, z, w");
+
+template<typename T>
+static inline const T* advance(const T* pointer, size_t bytes)
+{
+    return reinterpret_cast<const T*>(reinterpret_cast<const char*>(pointer) + bytes);
+}
+
+template<typename T>
+static inline T* advance(T* pointer, size_t bytes)
+{
+    return reinterpret_cast<T*>(reinterpret_cast<char*>(pointer) + bytes);
+}
+
+/*
+* Scalar kernels, also the reference of the others
+*/
+
+static void composeTRSScalar(const float* tx, const float* ty, const float* tz,
+    const float* qx, const float* qy, const float* qz, const float* qw,
+    const float* sx, const float* sy, const float* sz, glm::mat4x3* output, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++)
+        output[i] = composeTRS(glm::vec3(tx[i], ty[i], tz[i]), glm::quat(qw[i], qx[i], qy[i], qz[i]), glm::vec3(sx[i], sy[i], sz[i]));
+}
+
+static void concatAffineScalar(const glm::mat4x3* a, const glm::mat4x3* b, glm::mat4x3* output, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++)
+        output[i] = concatAffine(a[i], b[i]);
+}
+
+static void composeTRSLanesScalar(const float* tx, const float* ty, const float* tz,
+    const float* qx, const float* qy, const float* qz, const float* qw,
+    const float* sx, const float* sy, const float* sz, float* output, unsigned int count, unsigned int width)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        glm::mat4x3 m = composeTRS(glm::vec3(tx[i], ty[i], tz[i]), glm::quat(qw[i], qx[i], qy[i], qz[i]), glm::vec3(sx[i], sy[i], sz[i]));
+        float* out = output + (i / width) * 12 * width + i % width;
+        for (int e = 0; e < 12; e++)
+            out[e * width] = (&m[0][0])[e];
+    }
+}
+
+static void concatAffineLanesScalar(const float* a, const float* b, float* output, unsigned int width, unsigned int count)
+{
+    for (unsigned int i = 0; i < count * width; i++) {
+        unsigned int first = (i / width) * 12 * width + i % width;
+        glm::mat4x3 ma, mb;
+        for (int e = 0; e < 12; e++) {
+            (&ma[0][0])[e] = a[first + e * width];
+            (&mb[0][0])[e] = b[first + e * width];
+        }
+        glm::mat4x3 res = concatAffine(ma, mb);
+        for (int e = 0; e < 12; e++)
+            output[first + e * width] = (&res[0][0])[e];
+    }
+}
+
+static void multiplyQuatScalar(const glm::quat* a, const glm::quat* b, glm::quat* output, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++)
+        output[i] = a[i] * b[i];
+}
+
+/*
+* Corrected selects onlerp: the progression is adjusted before the normalized lerp
+*/
+template<bool Corrected>
+static void nlerpScalar(const glm::quat* a, const glm::quat* b, const float* t, glm::quat* output, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        float cosAngle = glm::dot(a[i], b[i]);
+        glm::quat end = cosAngle < 0.f ? -b[i] : b[i];
+        float progression = Corrected ? onlerpProgression(std::abs(cosAngle), t[i]) : t[i];
+        output[i] = glm::normalize(a[i] * (1.f - progression) + end * progression);
+    }
+}
+
+static void lerpScalar(const float* a, const float* b, const float* t, float* output, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++)
+        output[i] = a[i] + (b[i] - a[i]) * t[i];
+}
+
+static void blendMatrices4Scalar(const glm::mat4* palette, const glm::ivec4* ids, const glm::vec4* weights, size_t inputStride,
+    glm::mat4* output, size_t outputStride, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        const glm::ivec4& id = *ids;
+        const glm::vec4& weight = *weights;
+        *output = palette[id.x] * weight.x + palette[id.y] * weight.y + palette[id.z] * weight.z + palette[id.w] * weight.w;
+
+        ids = advance(ids, inputStride);
+        weights = advance(weights, inputStride);
+        output = advance(output, outputStride);
+    }
+}
+
+#ifdef SIMD_X86
+
+/*
+* SSE2 kernels. A mat4x3 column is 3 floats: columns 0 to 2 are read 4 floats at a time
+* (the extra lane is ignored) and column 3 from the last 4 floats, to stay in bounds
+*/
+
+static inline __m128 loadLastColumn(const float* m)
+{
+    __m128 tail = _mm_loadu_ps(m + 8);
+    return _mm_shuffle_ps(tail, tail, _MM_SHUFFLE(3, 3, 2, 1));
+}
+
+static inline void storeAffine(float* m, __m128 c0, __m128 c1, __m128 c2, __m128 c3)
+{
+    // Overlapping stores, each one overwrites the ignored lane of the previous
+    __m128 tail = _mm_shuffle_ps(c3, c3, _MM_SHUFFLE(2, 1, 0, 0));
+    tail = _mm_move_ss(tail, _mm_shuffle_ps(c2, c2, _MM_SHUFFLE(2, 2, 2, 2)));
+    _mm_storeu_ps(m, c0);
+    _mm_storeu_ps(m + 3, c1);
+    _mm_storeu_ps(m + 6, c2);
+    _mm_storeu_ps(m + 8, tail);
+}
+
+/*
+* Writes 4 mat4x3 from one register per matrix element, one lane per bone
+*/
+static inline void storeAffine4(float* out, __m128 c0x, __m128 c0y, __m128 c0z, __m128 c1x, __m128 c1y, __m128 c1z,
+    __m128 c2x, __m128 c2y, __m128 c2z, __m128 c3x, __m128 c3y, __m128 c3z)
+{
+    // Transposing groups of 4 elements gives each bone's floats 0-3, 4-7 and 8-11
+    _MM_TRANSPOSE4_PS(c0x, c0y, c0z, c1x);
+    _MM_TRANSPOSE4_PS(c1y, c1z, c2x, c2y);
+    _MM_TRANSPOSE4_PS(c2z, c3x, c3y, c3z);
+
+    _mm_storeu_ps(out + 0, c0x);  _mm_storeu_ps(out + 4, c1y);  _mm_storeu_ps(out + 8, c2z);
+    _mm_storeu_ps(out + 12, c0y); _mm_storeu_ps(out + 16, c1z); _mm_storeu_ps(out + 20, c3x);
+    _mm_storeu_ps(out + 24, c0z); _mm_storeu_ps(out + 28, c2x); _mm_storeu_ps(out + 32, c3y);
+    _mm_storeu_ps(out + 36, c1x); _mm_storeu_ps(out + 40, c2y); _mm_storeu_ps(out + 44, c3z);
+}
+
+static void composeTRSSSE2(const float* tx, const float* ty, const float* tz,
+    const float* qx, const float* qy, const float* qz, const float* qw,
+    const float* sx, const float* sy, const float* sz, glm::mat4x3* output, unsigned int count)
+{
+    const __m128 one = _mm_set1_ps(1.f), two = _mm_set1_ps(2.f);
+    for (unsigned int i = 0; i < count; i += 4) {
+        __m128 x = _mm_loadu_ps(qx + i), y = _mm_loadu_ps(qy + i), z = _mm_loadu_ps(qz + i), w = _mm_loadu_ps(qw + i);
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+        __m128 scaleX = _mm_loadu_ps(sx + i), scaleY = _mm_loadu_ps(sy + i), scaleZ = _mm_loadu_ps(sz + i);
+
+        storeAffine4(&output[i][0][0],
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ),
+            _mm_loadu_ps(tx + i), _mm_loadu_ps(ty + i), _mm_loadu_ps(tz + i));
+    }
+}
+
+static void concatAffineSSE2(const glm::mat4x3* a, const glm::mat4x3* b, glm::mat4x3* output, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        const float* pa = &a[i][0][0];
+        const float* pb = &b[i][0][0];
+        __m128 a0 = _mm_loadu_ps(pa), a1 = _mm_loadu_ps(pa + 3), a2 = _mm_loadu_ps(pa + 6), a3 = loadLastColumn(pa);
+
+        __m128 res[4];
+        for (int column = 0; column < 4; column++) {
+            const float* bc = pb + 3 * column;
+            res[column] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(bc[0])), _mm_mul_ps(a1, _mm_set1_ps(bc[1]))),
+                _mm_mul_ps(a2, _mm_set1_ps(bc[2])));
+        }
+        storeAffine(&output[i][0][0], res[0], res[1], res[2], _mm_add_ps(res[3], a3));
+    }
+}
+
+/*
+* Lanes kernels: every register holds one matrix element of 4 characters, so no transpose is
+* needed and the parent multiply is 36 multiply-adds for 4 characters
+*/
+
+static void composeTRSLanesSSE2(const float* tx, const float* ty, const float* tz,
+    const float* qx, const float* qy, const float* qz, const float* qw,
+    const float* sx, const float* sy, const float* sz, float* output, unsigned int count, unsigned int width)
+{
+    const __m128 one = _mm_set1_ps(1.f), two = _mm_set1_ps(2.f);
+    for (unsigned int i = 0; i < count; i += 4) {
+        __m128 x = _mm_loadu_ps(qx + i), y = _mm_loadu_ps(qy + i), z = _mm_loadu_ps(qz + i), w = _mm_loadu_ps(qw + i);
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+        __m128 scaleX = _mm_loadu_ps(sx + i), scaleY = _mm_loadu_ps(sy + i), scaleZ = _mm_loadu_ps(sz + i);
+
+        float* out = output + (i / width) * 12 * width + i % width;
+        _mm_storeu_ps(out + 0 * width, _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX));
+        _mm_storeu_ps(out + 1 * width, _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX));
+        _mm_storeu_ps(out + 2 * width, _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX));
+        _mm_storeu_ps(out + 3 * width, _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY));
+        _mm_storeu_ps(out + 4 * width, _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY));
+        _mm_storeu_ps(out + 5 * width, _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY));
+        _mm_storeu_ps(out + 6 * width, _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ));
+        _mm_storeu_ps(out + 7 * width, _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ));
+        _mm_storeu_ps(out + 8 * width, _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ));
+        _mm_storeu_ps(out + 9 * width, _mm_loadu_ps(tx + i));
+        _mm_storeu_ps(out + 10 * width, _mm_loadu_ps(ty + i));
+        _mm_storeu_ps(out + 11 * width, _mm_loadu_ps(tz + i));
+    }
+}
+
+static void concatAffineLanesSSE2(const float* a, const float* b, float* output, unsigned int width, unsigned int count)
+{
+    for (unsigned int i = 0; i < count * width; i += 4) {
+        unsigned int first = (i / width) * 12 * width + i % width;
+        __m128 ma[12];
+        for (int e = 0; e < 12; e++)
+            ma[e] = _mm_loadu_ps(a + first + e * width);
+
+        for (int column = 0; column < 4; column++) {
+            const float* bc = b + first + 3 * column * width;
+            __m128 b0 = _mm_loadu_ps(bc), b1 = _mm_loadu_ps(bc + width), b2 = _mm_loadu_ps(bc + 2 * width);
+            for (int row = 0; row < 3; row++) {
+                __m128 res = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ma[row], b0), _mm_mul_ps(ma[3 + row], b1)), _mm_mul_ps(ma[6 + row], b2));
+                if (column == 3)
+                    res = _mm_add_ps(res, ma[9 + row]);
+                _mm_storeu_ps(output + first + (3 * column + row) * width, res);
+            }
+        }
+    }
+}
+
+/*
+* Hamilton product of quaternions stored as x, y, z, w
+*/
+static inline __m128 multiplyQuat(__m128 a, __m128 b)
+{
+    const __m128 signW = _mm_setr_ps(0.f, 0.f, 0.f, -0.f);
+    __m128 res = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b);
+    res = _mm_add_ps(res, _mm_mul_ps(_mm_xor_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 2, 1, 0)), signW),
+        _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 3, 3))));
+    res = _mm_add_ps(res, _mm_mul_ps(_mm_xor_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 2, 1)), signW),
+        _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 1, 0, 2))));
+    return _mm_sub_ps(res, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 1, 0, 2)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 0, 2, 1))));
+}
+
+static void multiplyQuatSSE2(const glm::quat* a, const glm::quat* b, glm::quat* output, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++)
+        _mm_storeu_ps(&output[i].x, multiplyQuat(_mm_loadu_ps(&a[i].x), _mm_loadu_ps(&b[i].x)));
+}
+
+/*
+* Sum of the 4 lanes of a * b, in every lane
+*/
+static inline __m128 dot4(__m128 a, __m128 b)
+{
+    __m128 product = _mm_mul_ps(a, b);
+    __m128 sum = _mm_add_ps(product, _mm_shuffle_ps(product, product, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+/*
+* onlerpProgression in every lane, the threshold applied as a mask
+*/
+static inline __m128 onlerpProgression(__m128 cosAngle, __m128 t)
+{
+    __m128 a = _mm_sub_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(cosAngle, _mm_set1_ps(1.43519f)));
+    a = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(cosAngle, _mm_add_ps(_mm_set1_ps(-3.2452f), _mm_mul_ps(cosAngle, a))));
+    __m128 b = _mm_add_ps(_mm_set1_ps(-1.06021f), _mm_mul_ps(cosAngle, _mm_set1_ps(0.215638f)));
+    b = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(cosAngle, b));
+
+    __m128 centered = _mm_sub_ps(t, _mm_set1_ps(0.5f));
+    __m128 k = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(a, centered), centered), b);
+    __m128 correction = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, centered), _mm_sub_ps(t, _mm_set1_ps(1.f))), k);
+    correction = _mm_and_ps(correction, _mm_cmple_ps(cosAngle, _mm_set1_ps(ONLERP_MAX_COS_ANGLE)));
+    return _mm_add_ps(t, correction);
+}
+
+template<bool Corrected>
+static void nlerpSSE2(const glm::quat* a, const glm::quat* b, const float* t, glm::quat* output, unsigned int count)
+{
+    const __m128 sign = _mm_set1_ps(-0.f), one = _mm_set1_ps(1.f);
+    for (unsigned int i = 0; i < count; i++) {
+        __m128 start = _mm_loadu_ps(&a[i].x), end = _mm_loadu_ps(&b[i].x);
+        __m128 cosAngle = dot4(start, end);
+        __m128 flip = _mm_and_ps(_mm_cmplt_ps(cosAngle, _mm_setzero_ps()), sign);
+        end = _mm_xor_ps(end, flip);
+
+        __m128 progression = _mm_set1_ps(t[i]);
+        if (Corrected)
+            progression = onlerpProgression(_mm_xor_ps(cosAngle, flip), progression);
+        __m128 res = _mm_add_ps(_mm_mul_ps(start, _mm_sub_ps(one, progression)), _mm_mul_ps(end, progression));
+        res = _mm_mul_ps(res, _mm_div_ps(one, _mm_sqrt_ps(dot4(res, res))));
+        _mm_storeu_ps(&output[i].x, res);
+    }
+}
+
+static void lerpSSE2(const float* a, const float* b, const float* t, float* output, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 start = _mm_loadu_ps(a + i);
+        _mm_storeu_ps(output + i, _mm_add_ps(start, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b + i), start), _mm_loadu_ps(t + i))));
+    }
+    lerpScalar(a + i, b + i, t + i, output + i, count - i);
+}
+
+static void blendMatrices4SSE2(const glm::mat4* palette, const glm::ivec4* ids, const glm::vec4* weights, size_t inputStride,
+    glm::mat4* output, size_t outputStride, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        const float* m0 = &palette[ids->x][0][0];
+        const float* m1 = &palette[ids->y][0][0];
+        const float* m2 = &palette[ids->z][0][0];
+        const float* m3 = &palette[ids->w][0][0];
+        __m128 w0 = _mm_set1_ps(weights->x), w1 = _mm_set1_ps(weights->y), w2 = _mm_set1_ps(weights->z), w3 = _mm_set1_ps(weights->w);
+
+        float* out = &(*output)[0][0];
+        for (int column = 0; column < 16; column += 4) {
+            __m128 res = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m0 + column), w0),
+                _mm_mul_ps(_mm_loadu_ps(m1 + column), w1)), _mm_mul_ps(_mm_loadu_ps(m2 + column), w2)),
+                _mm_mul_ps(_mm_loadu_ps(m3 + column), w3));
+            _mm_storeu_ps(out + column, res);
+        }
+
+        ids = advance(ids, inputStride);
+        weights = advance(weights, inputStride);
+        output = advance(output, outputStride);
+    }
+}
+
+/*
+* AVX2 kernels: 8 bones per instruction for composeTRS, otherwise 2 columns or 2 quaternions
+* per register with fused multiply-adds
+*/
+
+/*
+* _MM_TRANSPOSE4_PS applied to both 128-bit halves
+*/
+SIMD_AVX2_TARGET static inline void transpose4x2(__m256& r0, __m256& r1, __m256& r2, __m256& r3)
+{
+    __m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpacklo_ps(r2, r3);
+    __m256 t2 = _mm256_unpackhi_ps(r0, r1), t3 = _mm256_unpackhi_ps(r2, r3);
+    r0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+    r1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+    r2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    r3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+/*
+* First halves of a and b at out, second halves 4 bones (48 floats) further
+*/
+SIMD_AVX2_TARGET static inline void storeHalves(float* out, __m256 a, __m256 b)
+{
+    _mm256_storeu_ps(out, _mm256_permute2f128_ps(a, b, 0x20));
+    _mm256_storeu_ps(out + 48, _mm256_permute2f128_ps(a, b, 0x31));
+}
+
+SIMD_AVX2_TARGET static void composeTRSAVX2(const float* tx, const float* ty, const float* tz,
+    const float* qx, const float* qy, const float* qz, const float* qw,
+    const float* sx, const float* sy, const float* sz, glm::mat4x3* output, unsigned int count)
+{
+    const __m256 one = _mm256_set1_ps(1.f), two = _mm256_set1_ps(2.f);
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(qx + i), y = _mm256_loadu_ps(qy + i), z = _mm256_loadu_ps(qz + i), w = _mm256_loadu_ps(qw + i);
+        __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+        __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+        __m256 scaleX = _mm256_loadu_ps(sx + i), scaleY = _mm256_loadu_ps(sy + i), scaleZ = _mm256_loadu_ps(sz + i);
+
+        __m256 c0x = _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one), scaleX);
+        __m256 c0y = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), scaleX);
+        __m256 c0z = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), scaleX);
+        __m256 c1x = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), scaleY);
+        __m256 c1y = _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one), scaleY);
+        __m256 c1z = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), scaleY);
+        __m256 c2x = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), scaleZ);
+        __m256 c2y = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), scaleZ);
+        __m256 c2z = _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one), scaleZ);
+        __m256 c3x = _mm256_loadu_ps(tx + i), c3y = _mm256_loadu_ps(ty + i), c3z = _mm256_loadu_ps(tz + i);
+
+        // Same transposes as the SSE2 kernel, within each half: the first half holds bones 0-3, the second 4-7
+        transpose4x2(c0x, c0y, c0z, c1x);
+        transpose4x2(c1y, c1z, c2x, c2y);
+        transpose4x2(c2z, c3x, c3y, c3z);
+
+        float* out = &output[i][0][0];
+        storeHalves(out + 0, c0x, c1y);  storeHalves(out + 8, c2z, c0y);  storeHalves(out + 16, c1z, c3x);
+        storeHalves(out + 24, c0z, c2x); storeHalves(out + 32, c3y, c1x); storeHalves(out + 40, c2y, c3z);
+    }
+    if (i < count)
+        composeTRSSSE2(tx + i, ty + i, tz + i, qx + i, qy + i, qz + i, qw + i, sx + i, sy + i, sz + i, output + i, count - i);
+}
+
+SIMD_AVX2_TARGET static inline __m256 duplicate(__m128 v)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(v), v, 1);
+}
+
+/*
+* *low in the first 4 lanes, *high in the last 4. Broadcast loads, a setr of scalars would go
+* through the stack and stall on store forwarding
+*/
+SIMD_AVX2_TARGET static inline __m256 broadcastPair(const float* low, const float* high)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_broadcast_ss(low)), _mm_broadcast_ss(high), 1);
+}
+
+SIMD_AVX2_TARGET static void concatAffineAVX2(const glm::mat4x3* a, const glm::mat4x3* b, glm::mat4x3* output, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        const float* pa = &a[i][0][0];
+        const float* pb = &b[i][0][0];
+        __m256 a0 = duplicate(_mm_loadu_ps(pa)), a1 = duplicate(_mm_loadu_ps(pa + 3)), a2 = duplicate(_mm_loadu_ps(pa + 6));
+        __m128 a3 = loadLastColumn(pa);
+
+        // Columns 0 and 1 in the first register, 2 and 3 in the second
+        __m256 res01 = _mm256_mul_ps(a0, broadcastPair(pb + 0, pb + 3));
+        res01 = _mm256_fmadd_ps(a1, broadcastPair(pb + 1, pb + 4), res01);
+        res01 = _mm256_fmadd_ps(a2, broadcastPair(pb + 2, pb + 5), res01);
+        __m256 res23 = _mm256_mul_ps(a0, broadcastPair(pb + 6, pb + 9));
+        res23 = _mm256_fmadd_ps(a1, broadcastPair(pb + 7, pb + 10), res23);
+        res23 = _mm256_fmadd_ps(a2, broadcastPair(pb + 8, pb + 11), res23);
+
+        storeAffine(&output[i][0][0], _mm256_castps256_ps128(res01), _mm256_extractf128_ps(res01, 1),
+            _mm256_castps256_ps128(res23), _mm_add_ps(_mm256_extractf128_ps(res23, 1), a3));
+    }
+}
+
+/*
+* 8 characters per register, widths that are not a multiple of 8 go to the SSE2 kernels
+*/
+SIMD_AVX2_TARGET static void composeTRSLanesAVX2(const float* tx, const float* ty, const float* tz,
+    const float* qx, const float* qy, const float* qz, const float* qw,
+    const float* sx, const float* sy, const float* sz, float* output, unsigned int count, unsigned int width)
+{
+    if (width % 8 != 0) {
+        composeTRSLanesSSE2(tx, ty, tz, qx, qy, qz, qw, sx, sy, sz, output, count, width);
+        return;
+    }
+    const __m256 one = _mm256_set1_ps(1.f), two = _mm256_set1_ps(2.f);
+    for (unsigned int i = 0; i < count; i += 8) {
+        __m256 x = _mm256_loadu_ps(qx + i), y = _mm256_loadu_ps(qy + i), z = _mm256_loadu_ps(qz + i), w = _mm256_loadu_ps(qw + i);
+        __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+        __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+        __m256 scaleX = _mm256_loadu_ps(sx + i), scaleY = _mm256_loadu_ps(sy + i), scaleZ = _mm256_loadu_ps(sz + i);
+
+        float* out = output + (i / width) * 12 * width + i % width;
+        _mm256_storeu_ps(out + 0 * width, _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one), scaleX));
+        _mm256_storeu_ps(out + 1 * width, _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), scaleX));
+        _mm256_storeu_ps(out + 2 * width, _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), scaleX));
+        _mm256_storeu_ps(out + 3 * width, _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), scaleY));
+        _mm256_storeu_ps(out + 4 * width, _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one), scaleY));
+        _mm256_storeu_ps(out + 5 * width, _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), scaleY));
+        _mm256_storeu_ps(out + 6 * width, _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), scaleZ));
+        _mm256_storeu_ps(out + 7 * width, _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), scaleZ));
+        _mm256_storeu_ps(out + 8 * width, _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one), scaleZ));
+        _mm256_storeu_ps(out + 9 * width, _mm256_loadu_ps(tx + i));
+        _mm256_storeu_ps(out + 10 * width, _mm256_loadu_ps(ty + i));
+        _mm256_storeu_ps(out + 11 * width, _mm256_loadu_ps(tz + i));
+    }
+}
+
+SIMD_AVX2_TARGET static void concatAffineLanesAVX2(const float* a, const float* b, float* output, unsigned int width, unsigned int count)
+{
+    if (width % 8 != 0) {
+        concatAffineLanesSSE2(a, b, output, width, count);
+        return;
+    }
+    for (unsigned int i = 0; i < count * width; i += 8) {
+        unsigned int first = (i / width) * 12 * width + i % width;
+        __m256 ma[12];
+        for (int e = 0; e < 12; e++)
+            ma[e] = _mm256_loadu_ps(a + first + e * width);
+
+        for (int column = 0; column < 4; column++) {
+            const float* bc = b + first + 3 * column * width;
+            __m256 b0 = _mm256_loadu_ps(bc), b1 = _mm256_loadu_ps(bc + width), b2 = _mm256_loadu_ps(bc + 2 * width);
+            for (int row = 0; row < 3; row++) {
+                __m256 res = column == 3 ? _mm256_fmadd_ps(ma[row], b0, ma[9 + row]) : _mm256_mul_ps(ma[row], b0);
+                res = _mm256_fmadd_ps(ma[3 + row], b1, res);
+                res = _mm256_fmadd_ps(ma[6 + row], b2, res);
+                _mm256_storeu_ps(output + first + (3 * column + row) * width, res);
+            }
+        }
+    }
+}
+
+SIMD_AVX2_TARGET static void multiplyQuatAVX2(const glm::quat* a, const glm::quat* b, glm::quat* output, unsigned int count)
+{
+    const __m256 signW = _mm256_setr_ps(0.f, 0.f, 0.f, -0.f, 0.f, 0.f, 0.f, -0.f);
+    unsigned int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m256 qa = _mm256_loadu_ps(&a[i].x), qb = _mm256_loadu_ps(&b[i].x);
+
+        // Same terms as the SSE2 kernel, the permutations apply to each quaternion
+        __m256 res = _mm256_mul_ps(_mm256_permute_ps(qa, _MM_SHUFFLE(3, 3, 3, 3)), qb);
+        res = _mm256_fmadd_ps(_mm256_xor_ps(_mm256_permute_ps(qa, _MM_SHUFFLE(0, 2, 1, 0)), signW),
+            _mm256_permute_ps(qb, _MM_SHUFFLE(0, 3, 3, 3)), res);
+        res = _mm256_fmadd_ps(_mm256_xor_ps(_mm256_permute_ps(qa, _MM_SHUFFLE(1, 0, 2, 1)), signW),
+            _mm256_permute_ps(qb, _MM_SHUFFLE(1, 1, 0, 2)), res);
+        res = _mm256_fnmadd_ps(_mm256_permute_ps(qa, _MM_SHUFFLE(2, 1, 0, 2)), _mm256_permute_ps(qb, _MM_SHUFFLE(2, 0, 2, 1)), res);
+        _mm256_storeu_ps(&output[i].x, res);
+    }
+    if (i < count)
+        multiplyQuatSSE2(a + i, b + i, output + i, count - i);
+}
+
+SIMD_AVX2_TARGET static inline __m256 dot4x2(__m256 a, __m256 b)
+{
+    __m256 product = _mm256_mul_ps(a, b);
+    __m256 sum = _mm256_add_ps(product, _mm256_permute_ps(product, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm256_add_ps(sum, _mm256_permute_ps(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+SIMD_AVX2_TARGET static inline __m256 onlerpProgression(__m256 cosAngle, __m256 t)
+{
+    __m256 a = _mm256_fnmadd_ps(cosAngle, _mm256_set1_ps(1.43519f), _mm256_set1_ps(3.55645f));
+    a = _mm256_fmadd_ps(cosAngle, _mm256_fmadd_ps(cosAngle, a, _mm256_set1_ps(-3.2452f)), _mm256_set1_ps(1.0904f));
+    __m256 b = _mm256_fmadd_ps(cosAngle, _mm256_set1_ps(0.215638f), _mm256_set1_ps(-1.06021f));
+    b = _mm256_fmadd_ps(cosAngle, b, _mm256_set1_ps(0.848013f));
+
+    __m256 centered = _mm256_sub_ps(t, _mm256_set1_ps(0.5f));
+    __m256 k = _mm256_fmadd_ps(_mm256_mul_ps(a, centered), centered, b);
+    k = _mm256_and_ps(k, _mm256_cmp_ps(cosAngle, _mm256_set1_ps(ONLERP_MAX_COS_ANGLE), _CMP_LE_OQ));
+    return _mm256_fmadd_ps(_mm256_mul_ps(_mm256_mul_ps(t, centered), _mm256_sub_ps(t, _mm256_set1_ps(1.f))), k, t);
+}
+
+template<bool Corrected>
+SIMD_AVX2_TARGET static void nlerpAVX2(const glm::quat* a, const glm::quat* b, const float* t, glm::quat* output, unsigned int count)
+{
+    const __m256 sign = _mm256_set1_ps(-0.f), one = _mm256_set1_ps(1.f);
+    unsigned int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m256 start = _mm256_loadu_ps(&a[i].x), end = _mm256_loadu_ps(&b[i].x);
+        __m256 cosAngle = dot4x2(start, end);
+        __m256 flip = _mm256_and_ps(_mm256_cmp_ps(cosAngle, _mm256_setzero_ps(), _CMP_LT_OQ), sign);
+        end = _mm256_xor_ps(end, flip);
+
+        __m256 progression = broadcastPair(t + i, t + i + 1);
+        if (Corrected)
+            progression = onlerpProgression(_mm256_xor_ps(cosAngle, flip), progression);
+        __m256 res = _mm256_fmadd_ps(end, progression, _mm256_mul_ps(start, _mm256_sub_ps(one, progression)));
+        res = _mm256_mul_ps(res, _mm256_div_ps(one, _mm256_sqrt_ps(dot4x2(res, res))));
+        _mm256_storeu_ps(&output[i].x, res);
+    }
+    if (i < count)
+        nlerpSSE2<Corrected>(a + i, b + i, t + i, output + i, count - i);
+}
+
+SIMD_AVX2_TARGET static void lerpAVX2(const float* a, const float* b, const float* t, float* output, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 start = _mm256_loadu_ps(a + i);
+        _mm256_storeu_ps(output + i, _mm256_fmadd_ps(_mm256_sub_ps(_mm256_loadu_ps(b + i), start), _mm256_loadu_ps(t + i), start));
+    }
+    lerpSSE2(a + i, b + i, t + i, output + i, count - i);
+}
+
+SIMD_AVX2_TARGET static void blendMatrices4AVX2(const glm::mat4* palette, const glm::ivec4* ids, const glm::vec4* weights, size_t inputStride,
+    glm::mat4* output, size_t outputStride, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        const float* m0 = &palette[ids->x][0][0];
+        const float* m1 = &palette[ids->y][0][0];
+        const float* m2 = &palette[ids->z][0][0];
+        const float* m3 = &palette[ids->w][0][0];
+        __m256 w0 = _mm256_set1_ps(weights->x), w1 = _mm256_set1_ps(weights->y), w2 = _mm256_set1_ps(weights->z), w3 = _mm256_set1_ps(weights->w);
+
+        float* out = &(*output)[0][0];
+        for (int half = 0; half < 16; half += 8) {
+            __m256 res = _mm256_mul_ps(_mm256_loadu_ps(m0 + half), w0);
+            res = _mm256_fmadd_ps(_mm256_loadu_ps(m1 + half), w1, res);
+            res = _mm256_fmadd_ps(_mm256_loadu_ps(m2 + half), w2, res);
+            res = _mm256_fmadd_ps(_mm256_loadu_ps(m3 + half), w3, res);
+            _mm256_storeu_ps(out + half, res);
+        }
+
+        ids = advance(ids, inputStride);
+        weights = advance(weights, inputStride);
+        output = advance(output, outputStride);
+    }
+}
+
+static bool cpuHasAVX2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return fma && osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+#endif // SIMD_X86
+
+#ifdef SIMD_NEON
+
+/*
+* NEON kernels, 4 lanes like SSE2
+*/
+
+static inline void transpose4(float32x4_t& a, float32x4_t& b, float32x4_t& c, float32x4_t& d)
+{
+    float32x4x2_t ab = vtrnq_f32(a, b);
+    float32x4x2_t cd = vtrnq_f32(c, d);
+    a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+    b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+    c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+    d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+static inline float sum4(float32x4_t v)
+{
+#if defined(__aarch64__)
+    return vaddvq_f32(v);
+#else
+    float32x2_t sum = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpadd_f32(sum, sum), 0);
+#endif
+}
+
+static void composeTRSNEON(const float* tx, const float* ty, const float* tz,
+    const float* qx, const float* qy, const float* qz, const float* qw,
+    const float* sx, const float* sy, const float* sz, glm::mat4x3* output, unsigned int count)
+{
+    const float32x4_t one = vdupq_n_f32(1.f), two = vdupq_n_f32(2.f);
+    for (unsigned int i = 0; i < count; i += 4) {
+        float32x4_t x = vld1q_f32(qx + i), y = vld1q_f32(qy + i), z = vld1q_f32(qz + i), w = vld1q_f32(qw + i);
+        float32x4_t xx = vmulq_f32(x, x), yy = vmulq_f32(y, y), zz = vmulq_f32(z, z);
+        float32x4_t xy = vmulq_f32(x, y), xz = vmulq_f32(x, z), yz = vmulq_f32(y, z);
+        float32x4_t wx = vmulq_f32(w, x), wy = vmulq_f32(w, y), wz = vmulq_f32(w, z);
+        float32x4_t scaleX = vld1q_f32(sx + i), scaleY = vld1q_f32(sy + i), scaleZ = vld1q_f32(sz + i);
+
+        float32x4_t c0x = vmulq_f32(vsubq_f32(one, vmulq_f32(two, vaddq_f32(yy, zz))), scaleX);
+        float32x4_t c0y = vmulq_f32(vmulq_f32(two, vaddq_f32(xy, wz)), scaleX);
+        float32x4_t c0z = vmulq_f32(vmulq_f32(two, vsubq_f32(xz, wy)), scaleX);
+        float32x4_t c1x = vmulq_f32(vmulq_f32(two, vsubq_f32(xy, wz)), scaleY);
+        float32x4_t c1y = vmulq_f32(vsubq_f32(one, vmulq_f32(two, vaddq_f32(xx, zz))), scaleY);
+        float32x4_t c1z = vmulq_f32(vmulq_f32(two, vaddq_f32(yz, wx)), scaleY);
+        float32x4_t c2x = vmulq_f32(vmulq_f32(two, vaddq_f32(xz, wy)), scaleZ);
+        float32x4_t c2y = vmulq_f32(vmulq_f32(two, vsubq_f32(yz, wx)), scaleZ);
+        float32x4_t c2z = vmulq_f32(vsubq_f32(one, vmulq_f32(two, vaddq_f32(xx, yy))), scaleZ);
+        float32x4_t c3x = vld1q_f32(tx + i), c3y = vld1q_f32(ty + i), c3z = vld1q_f32(tz + i);
+
+        transpose4(c0x, c0y, c0z, c1x);
+        transpose4(c1y, c1z, c2x, c2y);
+        transpose4(c2z, c3x, c3y, c3z);
+
+        float* out = &output[i][0][0];
+        vst1q_f32(out + 0, c0x);  vst1q_f32(out + 4, c1y);  vst1q_f32(out + 8, c2z);
+        vst1q_f32(out + 12, c0y); vst1q_f32(out + 16, c1z); vst1q_f32(out + 20, c3x);
+        vst1q_f32(out + 24, c0z); vst1q_f32(out + 28, c2x); vst1q_f32(out + 32, c3y);
+        vst1q_f32(out + 36, c1x); vst1q_f32(out + 40, c2y); vst1q_f32(out + 44, c3z);
+    }
+}
+
+static void concatAffineNEON(const glm::mat4x3* a, const glm::mat4x3* b, glm::mat4x3* output, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        const float* pa = &a[i][0][0];
+        const float* pb = &b[i][0][0];
+        float32x4_t tail = vld1q_f32(pa + 8);
+        float32x4_t a0 = vld1q_f32(pa), a1 = vld1q_f32(pa + 3), a2 = vld1q_f32(pa + 6), a3 = vextq_f32(tail, tail, 1);
+
+        float32x4_t res[4];
+        for (int column = 0; column < 4; column++) {
+            const float* bc = pb + 3 * column;
+            res[column] = vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(a0, bc[0]), a1, bc[1]), a2, bc[2]);
+        }
+        res[3] = vaddq_f32(res[3], a3);
+
+        // Same overlapping stores as the SSE2 kernel
+        float32x4_t last = vsetq_lane_f32(vgetq_lane_f32(res[2], 2), vextq_f32(res[3], res[3], 3), 0);
+        float* out = &output[i][0][0];
+        vst1q_f32(out, res[0]);
+        vst1q_f32(out + 3, res[1]);
+        vst1q_f32(out + 6, res[2]);
+        vst1q_f32(out + 8, last);
+    }
+}
+
+static void composeTRSLanesNEON(const float* tx, const float* ty, const float* tz,
+    const float* qx, const float* qy, const float* qz, const float* qw,
+    const float* sx, const float* sy, const float* sz, float* output, unsigned int count, unsigned int width)
+{
+    const float32x4_t one = vdupq_n_f32(1.f), two = vdupq_n_f32(2.f);
+    for (unsigned int i = 0; i < count; i += 4) {
+        float32x4_t x = vld1q_f32(qx + i), y = vld1q_f32(qy + i), z = vld1q_f32(qz + i), w = vld1q_f32(qw + i);
+        float32x4_t xx = vmulq_f32(x, x), yy = vmulq_f32(y, y), zz = vmulq_f32(z, z);
+        float32x4_t xy = vmulq_f32(x, y), xz = vmulq_f32(x, z), yz = vmulq_f32(y, z);
+        float32x4_t wx = vmulq_f32(w, x), wy = vmulq_f32(w, y), wz = vmulq_f32(w, z);
+        float32x4_t scaleX = vld1q_f32(sx + i), scaleY = vld1q_f32(sy + i), scaleZ = vld1q_f32(sz + i);
+
+        float* out = output + (i / width) * 12 * width + i % width;
+        vst1q_f32(out + 0 * width, vmulq_f32(vsubq_f32(one, vmulq_f32(two, vaddq_f32(yy, zz))), scaleX));
+        vst1q_f32(out + 1 * width, vmulq_f32(vmulq_f32(two, vaddq_f32(xy, wz)), scaleX));
+        vst1q_f32(out + 2 * width, vmulq_f32(vmulq_f32(two, vsubq_f32(xz, wy)), scaleX));
+        vst1q_f32(out + 3 * width, vmulq_f32(vmulq_f32(two, vsubq_f32(xy, wz)), scaleY));
+        vst1q_f32(out + 4 * width, vmulq_f32(vsubq_f32(one, vmulq_f32(two, vaddq_f32(xx, zz))), scaleY));
+        vst1q_f32(out + 5 * width, vmulq_f32(vmulq_f32(two, vaddq_f32(yz, wx)), scaleY));
+        vst1q_f32(out + 6 * width, vmulq_f32(vmulq_f32(two, vaddq_f32(xz, wy)), scaleZ));
+        vst1q_f32(out + 7 * width, vmulq_f32(vmulq_f32(two, vsubq_f32(yz, wx)), scaleZ));
+        vst1q_f32(out + 8 * width, vmulq_f32(vsubq_f32(one, vmulq_f32(two, vaddq_f32(xx, yy))), scaleZ));
+        vst1q_f32(out + 9 * width, vld1q_f32(tx + i));
+        vst1q_f32(out + 10 * width, vld1q_f32(ty + i));
+        vst1q_f32(out + 11 * width, vld1q_f32(tz + i));
+    }
+}
+
+static void concatAffineLanesNEON(const float* a, const float* b, float* output, unsigned int width, unsigned int count)
+{
+    for (unsigned int i = 0; i < count * width; i += 4) {
+        unsigned int first = (i / width) * 12 * width + i % width;
+        float32x4_t ma[12];
+        for (int e = 0; e < 12; e++)
+            ma[e] = vld1q_f32(a + first + e * width);
+
+        for (int column = 0; column < 4; column++) {
+            const float* bc = b + first + 3 * column * width;
+            float32x4_t b0 = vld1q_f32(bc), b1 = vld1q_f32(bc + width), b2 = vld1q_f32(bc + 2 * width);
+            for (int row = 0; row < 3; row++) {
+                float32x4_t res = column == 3 ? vmlaq_f32(ma[9 + row], ma[row], b0) : vmulq_f32(ma[row], b0);
+                res = vmlaq_f32(res, ma[3 + row], b1);
+                res = vmlaq_f32(res, ma[6 + row], b2);
+                vst1q_f32(output + first + (3 * column + row) * width, res);
+            }
+        }
+    }
+}
+
+static void multiplyQuatNEON(const glm::quat* a, const glm::quat* b, glm::quat* output, unsigned int count)
+{
+    static const float signs[12] = { 1.f, -1.f, 1.f, -1.f, 1.f, 1.f, -1.f, -1.f, -1.f, 1.f, 1.f, -1.f };
+    const float32x4_t signX = vld1q_f32(signs), signY = vld1q_f32(signs + 4), signZ = vld1q_f32(signs + 8);
+    for (unsigned int i = 0; i < count; i++) {
+        float32x4_t qa = vld1q_f32(&a[i].x), qb = vld1q_f32(&b[i].x);
+
+        // Each component of a scales a signed permutation of b: (w, z, y, x), (z, w, x, y), (y, x, w, z)
+        float32x4_t swapped = vrev64q_f32(qb);
+        float32x4_t res = vmulq_n_f32(qb, vgetq_lane_f32(qa, 3));
+        res = vmlaq_n_f32(res, vmulq_f32(vextq_f32(swapped, swapped, 2), signX), vgetq_lane_f32(qa, 0));
+        res = vmlaq_n_f32(res, vmulq_f32(vextq_f32(qb, qb, 2), signY), vgetq_lane_f32(qa, 1));
+        res = vmlaq_n_f32(res, vmulq_f32(swapped, signZ), vgetq_lane_f32(qa, 2));
+        vst1q_f32(&output[i].x, res);
+    }
+}
+
+template<bool Corrected>
+static void nlerpNEON(const glm::quat* a, const glm::quat* b, const float* t, glm::quat* output, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        float32x4_t start = vld1q_f32(&a[i].x), end = vld1q_f32(&b[i].x);
+        float cosAngle = sum4(vmulq_f32(start, end));
+        if (cosAngle < 0.f)
+            end = vnegq_f32(end);
+
+        float progression = Corrected ? onlerpProgression(std::abs(cosAngle), t[i]) : t[i];
+        float32x4_t res = vmlaq_n_f32(vmulq_n_f32(start, 1.f - progression), end, progression);
+        res = vmulq_n_f32(res, 1.f / std::sqrt(sum4(vmulq_f32(res, res))));
+        vst1q_f32(&output[i].x, res);
+    }
+}
+
+static void lerpNEON(const float* a, const float* b, const float* t, float* output, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t start = vld1q_f32(a + i);
+        vst1q_f32(output + i, vmlaq_f32(start, vsubq_f32(vld1q_f32(b + i), start), vld1q_f32(t + i)));
+    }
+    lerpScalar(a + i, b + i, t + i, output + i, count - i);
+}
+
+static void blendMatrices4NEON(const glm::mat4* palette, const glm::ivec4* ids, const glm::vec4* weights, size_t inputStride,
+    glm::mat4* output, size_t outputStride, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        const float* m0 = &palette[ids->x][0][0];
+        const float* m1 = &palette[ids->y][0][0];
+        const float* m2 = &palette[ids->z][0][0];
+        const float* m3 = &palette[ids->w][0][0];
+
+        float* out = &(*output)[0][0];
+        for (int column = 0; column < 16; column += 4) {
+            float32x4_t res = vmulq_n_f32(vld1q_f32(m0 + column), weights->x);
+            res = vmlaq_n_f32(res, vld1q_f32(m1 + column), weights->y);
+            res = vmlaq_n_f32(res, vld1q_f32(m2 + column), weights->z);
+            res = vmlaq_n_f32(res, vld1q_f32(m3 + column), weights->w);
+            vst1q_f32(out + column, res);
+        }
+
+        ids = advance(ids, inputStride);
+        weights = advance(weights, inputStride);
+        output = advance(output, outputStride);
+    }
+}
+
+#endif // SIMD_NEON
+
+/*
+* Dispatch
+*/
+
+struct SimdKernels
+{
+    SimdLevel level;
+    void (*composeTRS)(const float*, const float*, const float*, const float*, const float*, const float*, const float*,
+        const float*, const float*, const float*, glm::mat4x3*, unsigned int);
+    void (*concatAffine)(const glm::mat4x3*, const glm::mat4x3*, glm::mat4x3*, unsigned int);
+    void (*composeTRSLanes)(const float*, const float*, const float*, const float*, const float*, const float*, const float*,
+        const float*, const float*, const float*, float*, unsigned int, unsigned int);
+    void (*concatAffineLanes)(const float*, const float*, float*, unsigned int, unsigned int);
+    void (*multiplyQuat)(const glm::quat*, const glm::quat*, glm::quat*, unsigned int);
+    void (*nlerp)(const glm::quat*, const glm::quat*, const float*, glm::quat*, unsigned int);
+    void (*onlerp)(const glm::quat*, const glm::quat*, const float*, glm::quat*, unsigned int);
+    void (*lerp)(const float*, const float*, const float*, float*, unsigned int);
+    void (*blendMatrices4)(const glm::mat4*, const glm::ivec4*, const glm::vec4*, size_t, glm::mat4*, size_t, unsigned int);
+};
+
+static SimdKernels kernelsOf(SimdLevel level)
+{
+    switch (level)
+    {
+#ifdef SIMD_X86
+    case SimdLevel::SSE2:
+        return { level, composeTRSSSE2, concatAffineSSE2, composeTRSLanesSSE2, concatAffineLanesSSE2,
+            multiplyQuatSSE2, nlerpSSE2<false>, nlerpSSE2<true>, lerpSSE2, blendMatrices4SSE2 };
+    case SimdLevel::AVX2:
+        return { level, composeTRSAVX2, concatAffineAVX2, composeTRSLanesAVX2, concatAffineLanesAVX2,
+            multiplyQuatAVX2, nlerpAVX2<false>, nlerpAVX2<true>, lerpAVX2, blendMatrices4AVX2 };
+#endif
+#ifdef SIMD_NEON
+    case SimdLevel::NEON:
+        return { level, composeTRSNEON, concatAffineNEON, composeTRSLanesNEON, concatAffineLanesNEON,
+            multiplyQuatNEON, nlerpNEON<false>, nlerpNEON<true>, lerpNEON, blendMatrices4NEON };
+#endif
+    default:
+        return { SimdLevel::Scalar, composeTRSScalar, concatAffineScalar, composeTRSLanesScalar, concatAffineLanesScalar,
+            multiplyQuatScalar, nlerpScalar<false>, nlerpScalar<true>, lerpScalar, blendMatrices4Scalar };
+    }
+}
+
+bool simdSupported(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::Scalar:
+        return true;
+#ifdef SIMD_X86
+    case SimdLevel::SSE2:
+        return true;
+    case SimdLevel::AVX2:
+    {
+        static const bool avx2 = cpuHasAVX2();
+        return avx2;
+    }
+#endif
+#ifdef SIMD_NEON
+    case SimdLevel::NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+static SimdKernels& kernels()
+{
+    static SimdKernels current = []() {
+        SimdLevel level = simdSupported(SimdLevel::AVX2) ? SimdLevel::AVX2
+            : simdSupported(SimdLevel::SSE2) ? SimdLevel::SSE2
+            : simdSupported(SimdLevel::NEON) ? SimdLevel::NEON : SimdLevel::Scalar;
+
+        const char* forced = std::getenv("ANIMATION_SIMD");
+        SimdLevel requested;
+        if (forced && *forced) {
+            if (parseSimdLevel(forced, requested) && simdSupported(requested))
+                level = requested;
+            else
+                std::cout << "WARNING::SIMD::UNSUPPORTED_LEVEL " << forced << ", using " << simdLevelName(level) << std::endl;
+        }
+        return kernelsOf(level);
+    }();
+    return current;
+}
+
+SimdLevel simdLevel()
+{
+    return kernels().level;
+}
+
+bool setSimdLevel(SimdLevel level)
+{
+    if (!simdSupported(level))
+        return false;
+    kernels() = kernelsOf(level);
+    return true;
+}
+
+const char* simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::SSE2:
+        return "sse2";
+    case SimdLevel::AVX2:
+        return "avx2";
+    case SimdLevel::NEON:
+        return "neon";
+    default:
+        return "scalar";
+    }
+}
+
+bool parseSimdLevel(const std::string& name, SimdLevel& level)
+{
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::NEON };
+    for (SimdLevel candidate : levels) {
+        if (name == simdLevelName(candidate)) {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void composeTRSBatch(const float* tx, const float* ty, const float* tz,
+    const float* qx, const float* qy, const float* qz, const float* qw,
+    const float* sx, const float* sy, const float* sz, glm::mat4x3* output, unsigned int count)
+{
+    kernels().composeTRS(tx, ty, tz, qx, qy, qz, qw, sx, sy, sz, output, count);
+}
+
+void concatAffineBatch(const glm::mat4x3* a, const glm::mat4x3* b, glm::mat4x3* output, unsigned int count)
+{
+    kernels().concatAffine(a, b, output, count);
+}
+
+void composeTRSLanes(const float* tx, const float* ty, const float* tz,
+    const float* qx, const float* qy, const float* qz, const float* qw,
+    const float* sx, const float* sy, const float* sz, float* output, unsigned int count, unsigned int width)
+{
+    kernels().composeTRSLanes(tx, ty, tz, qx, qy, qz, qw, sx, sy, sz, output, count, width);
+}
+
+void concatAffineLanes(const float* a, const float* b, float* output, unsigned int width, unsigned int count)
+{
+    kernels().concatAffineLanes(a, b, output, width, count);
+}
+
+void multiplyQuatBatch(const glm::quat* a, const glm::quat* b, glm::quat* output, unsigned int count)
+{
+    kernels().multiplyQuat(a, b, output, count);
+}
+
+void nlerpBatch(const glm::quat* a, const glm::quat* b, const float* t, glm::quat* output, unsigned int count)
+{
+    kernels().nlerp(a, b, t, output, count);
+}
+
+void onlerpBatch(const glm::quat* a, const glm::quat* b, const float* t, glm::quat* output, unsigned int count)
+{
+    kernels().onlerp(a, b, t, output, count);
+}
+
+void lerpBatch(const float* a, const float* b, const float* t, float* output, unsigned int count)
+{
+    kernels().lerp(a, b, t, output, count);
+}
+
+void blendMatrices4(const glm::mat4* palette, const glm::ivec4* ids, const glm::vec4* weights, size_t inputStride,
+    glm::mat4* output, size_t outputStride, unsigned int count)
+{
+    kernels().blendMatrices4(palette, ids, weights, inputStride, output, outputStride, count);
+}
@@ -0,0 +1,121 @@
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include <cstddef>
+#include <string>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/*
+* Batched kernels of the pose and palette math. Each one exists as scalar code and as SSE2,
+* AVX2 (with FMA) and NEON versions, the widest that the running CPU supports is picked on
+* first use. The ANIMATION_SIMD environment variable (scalar, sse2, avx2, neon) can lower it.
+* Results match the glm operations they replace up to float rounding
+*/
+enum class SimdLevel
+{
+    Scalar,
+    SSE2,
+    AVX2,
+    NEON
+};
+
+SimdLevel simdLevel();
+
+/*
+* Whether this build and the running CPU can execute the kernels of a level
+*/
+bool simdSupported(SimdLevel level);
+
+/*
+* Switches every kernel to the given level, false when it is not supported.
+* Must not be called while other threads use the kernels
+*/
+bool setSimdLevel(SimdLevel level);
+
+const char* simdLevelName(SimdLevel level);
+
+bool parseSimdLevel(const std::string& name, SimdLevel& level);
+
+/*
+* composeTRS over count bones from structure-of-arrays inputs, count being a multiple of 4
+*/
+void composeTRSBatch(const float* tx, const float* ty, const float* tz,
+    const float* qx, const float* qy, const float* qz, const float* qw,
+    const float* sx, const float* sy, const float* sz, glm::mat4x3* output, unsigned int count);
+
+/*
+* output[i] = a[i] * b[i] as affine transforms, output may alias a or b
+*/
+void concatAffineBatch(const glm::mat4x3* a, const glm::mat4x3* b, glm::mat4x3* output, unsigned int count);
+
+/*
+* Lanes layout (AoSoA): one affine transform per lane for width lanes, stored as the 12 floats of
+* a mat4x3 in column order with each float repeated for every lane, element e of lane l at
+* e * width + l. width is a multiple of 4
+*/
+
+/*
+* composeTRS of count entries from structure-of-arrays inputs holding width lanes per bone,
+* written bone after bone as 12 * width floats in the lanes layout. count is a multiple of width
+*/
+void composeTRSLanes(const float* tx, const float* ty, const float* tz,
+    const float* qx, const float* qy, const float* qz, const float* qw,
+    const float* sx, const float* sy, const float* sz, float* output, unsigned int count, unsigned int width);
+
+/*
+* a * b lane by lane over count transforms in the lanes layout, output must not alias a or b
+*/
+void concatAffineLanes(const float* a, const float* b, float* output, unsigned int width, unsigned int count);
+
+/*
+* output[i] = a[i] * b[i], output may alias a or b
+*/
+void multiplyQuatBatch(const glm::quat* a, const glm::quat* b, glm::quat* output, unsigned int count);
+
+/*
+* Normalized lerp from a[i] to b[i] by t[i] along the shortest path
+*/
+void nlerpBatch(const glm::quat* a, const glm::quat* b, const float* t, glm::quat* output, unsigned int count);
+
+/*
+* nlerpBatch following slerp closely, see onlerpProgression
+*/
+void onlerpBatch(const glm::quat* a, const glm::quat* b, const float* t, glm::quat* output, unsigned int count);
+
+/*
+* Below this cosine (keys over 9 degrees apart) the onlerp correction beats plain nlerp, closer
+* keys keep the progression as is since the fit does not vanish as the angle goes to 0
+*/
+const float ONLERP_MAX_COS_ANGLE = 0.9969f;
+
+/*
+* Progression at which nlerp lands where slerp would at t (onlerp), from a polynomial fit over
+* the absolute cosine of the angle between the quaternions ("Approximating slerp", zeux.io).
+* The rotation error is under 0.045 degrees for keys up to 180 degrees apart, against 8.1 for
+* plain nlerp, and under 0.005 degrees for keys up to 90 degrees apart, against 0.92
+*/
+inline float onlerpProgression(float cosAngle, float t)
+{
+    if (cosAngle > ONLERP_MAX_COS_ANGLE)
+        return t;
+    float a = 1.0904f + cosAngle * (-3.2452f + cosAngle * (3.55645f - cosAngle * 1.43519f));
+    float b = 0.848013f + cosAngle * (-1.06021f + cosAngle * 0.215638f);
+    float k = a * (t - 0.5f) * (t - 0.5f) + b;
+    return t + t * (t - 0.5f) * (t - 1.f) * k;
+}
+
+/*
+* output[i] = a[i] + (b[i] - a[i]) * t[i], output may alias a or b
+*/
+void lerpBatch(const float* a, const float* b, const float* t, float* output, unsigned int count);
+
+/*
+* Linear blend skinning matrices, output[i] = sum over k of palette[ids[i][k]] * weights[i][k].
+* ids and weights advance by inputStride bytes and output by outputStride bytes, so that they
+* can point into vertex structures
+*/
+void blendMatrices4(const glm::mat4* palette, const glm::ivec4* ids, const glm::vec4* weights, size_t inputStride,
+    glm::mat4* output, size_t outputStride, unsigned int count);
+
+#endif // SIMD_MATH_H
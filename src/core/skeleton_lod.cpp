@@ -0,0 +1,64 @@
+#include "skeleton_lod.h"
+
+SkeletonLOD::SkeletonLOD() : _kept({}), _remaps({}), _keptCounts({})
+{
+
+}
+
+void SkeletonLOD::readParents(Bone& bone, int parent, std::vector<int>& parents, std::vector<int>& order)
+{
+    if (bone.id() < 0 || bone.id() >= (int)parents.size())
+        return;
+
+    parents[bone.id()] = parent;
+    order.push_back(bone.id());
+    for (Bone& child : bone.children())
+        readParents(child, bone.id(), parents, order);
+}
+
+void SkeletonLOD::build(Bone& skeleton, unsigned int boneCount, unsigned int levels)
+{
+    this->_kept.clear();
+    this->_remaps.clear();
+    this->_keptCounts.clear();
+
+    // Bones outside of the hierarchy keep a parent of -1 and are never dropped
+    std::vector<int> parents(boneCount, -1);
+    std::vector<int> order; // Parents before children
+    readParents(skeleton, -1, parents, order);
+
+    std::vector<bool> kept(boneCount, true);
+    for (unsigned int level = 0; level < levels; level++) {
+        if (level > 0) {
+            std::vector<bool> hasKeptChild(boneCount, false);
+            for (int id : order) {
+                if (kept[id] && parents[id] >= 0)
+                    hasKeptChild[parents[id]] = true;
+            }
+
+            std::vector<bool> next = kept;
+            for (int id : order) {
+                if (kept[id] && !hasKeptChild[id] && parents[id] >= 0)
+                    next[id] = false;
+            }
+            if (next == kept)
+                break; // Only the root is left
+            kept = next;
+        }
+
+        std::vector<unsigned int> remap(boneCount);
+        unsigned int keptCount = 0;
+        for (unsigned int id = 0; id < boneCount; id++) {
+            int ancestor = id;
+            while (!kept[ancestor])
+                ancestor = parents[ancestor];
+            remap[id] = ancestor;
+            if (kept[id])
+                keptCount++;
+        }
+
+        this->_kept.push_back(kept);
+        this->_remaps.push_back(remap);
+        this->_keptCounts.push_back(keptCount);
+    }
+}
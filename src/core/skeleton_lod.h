@@ -0,0 +1,58 @@
+#ifndef SKELETON_LOD_H
+#define SKELETON_LOD_H
+
+#include <vector>
+
+#include "bone.h"
+
+/*
+* Chain of reduced skeletons for distant characters. Each level drops the current
+* leaf bones of the previous one (fingers, face, twist joints first), and vertices
+* influenced by a dropped bone follow its nearest kept ancestor through a palette
+* remap table, so the vertex buffers never change.
+*/
+class SkeletonLOD
+{
+public:
+    SkeletonLOD();
+
+    /*
+    * Level 0 is the full skeleton, every other level prunes one more layer of leaves
+    */
+    void build(Bone& skeleton, unsigned int boneCount, unsigned int levels);
+
+    inline unsigned int levels() const { return (unsigned int)this->_remaps.size(); }
+
+    /*
+    * Bones evaluated at the given level, indexed by bone id
+    */
+    inline const std::vector<bool>& kept(unsigned int level) const { return this->_kept[level]; }
+
+    /*
+    * Kept bone whose palette entry each bone uses at the given level, indexed by bone id
+    */
+    inline const std::vector<unsigned int>& remap(unsigned int level) const { return this->_remaps[level]; }
+
+    inline unsigned int keptCount(unsigned int level) const { return this->_keptCounts[level]; }
+
+    /*
+    * Fills the palette entries of the bones dropped at the given level from their kept ancestor
+    */
+    template<typename T>
+    void applyRemap(unsigned int level, std::vector<T>& palette) const
+    {
+        const std::vector<unsigned int>& remap = this->_remaps[level];
+        for (unsigned int i = 0; i < remap.size(); i++) {
+            if (remap[i] != i)
+                palette[i] = palette[remap[i]];
+        }
+    }
+private:
+    void readParents(Bone& bone, int parent, std::vector<int>& parents, std::vector<int>& order);
+private:
+    std::vector<std::vector<bool>> _kept;
+    std::vector<std::vector<unsigned int>> _remaps;
+    std::vector<unsigned int> _keptCounts;
+};
+
+#endif // SKELETON_LOD_H
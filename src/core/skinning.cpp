@@ -0,0 +1,60 @@
+#include "skinning.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "simd_math.h"
+
+static_assert(offsetof(VertexCPU, boneTr3) == offsetof(VertexCPU, boneTr0) + 3 * sizeof(glm::vec4),
+    "the blended matrix is written over the 4 boneTr columns");
+
+void getBoneTransform(const std::vector<glm::mat4>& currentPose, const std::vector<Vertex>& vertices, std::vector<VertexCPU>& verticesCPU)
+{
+    getBoneTransform(currentPose, vertices, verticesCPU, 0, (unsigned int)vertices.size());
+}
+
+void getBoneTransform(const std::vector<glm::mat4>& currentPose, const std::vector<Vertex>& vertices, std::vector<VertexCPU>& verticesCPU,
+    unsigned int begin, unsigned int end)
+{
+    if (begin >= end)
+        return;
+    blendMatrices4(currentPose.data(), &vertices[begin].boneIds, &vertices[begin].boneWeights, sizeof(Vertex),
+        reinterpret_cast<glm::mat4*>(&verticesCPU[begin].boneTr0), sizeof(VertexCPU), end - begin);
+}
+
+bool quantizeVertices(const std::vector<Vertex>& vertices, std::vector<VertexCompact>& output, glm::vec3& scale, glm::vec3& bias)
+{
+    AABB bounds;
+    for (const Vertex& vertex : vertices)
+        bounds.extend(vertex.position);
+    bias = vertices.empty() ? glm::vec3(0.f) : (bounds.min + bounds.max) * 0.5f;
+    scale = vertices.empty() ? glm::vec3(1.f) : glm::max((bounds.max - bounds.min) * 0.5f, glm::vec3(1e-6f));
+
+    output.resize(vertices.size());
+    for (unsigned int i = 0; i < vertices.size(); i++) {
+        const Vertex& vertex = vertices[i];
+        VertexCompact& compact = output[i];
+
+        glm::vec3 position = glm::clamp((vertex.position - bias) / scale, -1.f, 1.f);
+        glm::vec3 normal = glm::clamp(vertex.normal, -1.f, 1.f);
+        compact.position = glm::i16vec4(glm::i16vec3(glm::round(position * 32767.f)), 0);
+        compact.normal = glm::i8vec4(glm::i8vec3(glm::round(normal * 127.f)), 0);
+        compact.uv = vertex.uv;
+
+        // The rounding error goes to the largest weight, so that the blend keeps its scale
+        int total = 0, largest = 0;
+        for (int k = 0; k < 4; k++) {
+            if (vertex.boneIds[k] < 0 || vertex.boneIds[k] > 255)
+                return false;
+            compact.boneIds[k] = uint8_t(vertex.boneIds[k]);
+            compact.boneWeights[k] = uint8_t(std::lround(glm::clamp(vertex.boneWeights[k], 0.f, 1.f) * 255.f));
+            total += compact.boneWeights[k];
+            if (compact.boneWeights[k] > compact.boneWeights[largest])
+                largest = k;
+        }
+        if (total > 0)
+            compact.boneWeights[largest] = uint8_t(glm::clamp(int(compact.boneWeights[largest]) + 255 - total, 0, 255));
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef SKINNING_H
+#define SKINNING_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include "importer.h"
+
+/*
+* Vertex layout of the CPU path, the blended bone transformation is computed per vertex on the CPU
+*/
+struct VertexCPU {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 uv;
+    glm::vec4 boneTr0 = glm::vec4(1, 0, 0, 0);
+    glm::vec4 boneTr1 = glm::vec4(0, 1, 0, 0);
+    glm::vec4 boneTr2 = glm::vec4(0, 0, 1, 0);
+    glm::vec4 boneTr3 = glm::vec4(0, 0, 0, 1);
+};
+
+void getBoneTransform(const std::vector<glm::mat4>& currentPose, const std::vector<Vertex>& vertices, std::vector<VertexCPU>& verticesCPU);
+
+/*
+* Quantized vertex layout of the GPU paths, 28 bytes instead of the 64 of Vertex: positions as
+* snorm16 over the mesh bounds (position = stored * scale + bias), normals as snorm8, bone IDs
+* and weights as 8 bit integers and unorm8. The 4th position and normal components are padding
+*/
+struct VertexCompact {
+    glm::i16vec4 position;
+    glm::i8vec4 normal;
+    glm::vec2 uv;
+    glm::u8vec4 boneIds;
+    glm::u8vec4 boneWeights;
+};
+
+/*
+* Quantizes the vertices into output, scale and bias receive the dequantization of the positions.
+* Weights are rounded so that they still sum to one, false when a bone ID does not fit 8 bits
+*/
+bool quantizeVertices(const std::vector<Vertex>& vertices, std::vector<VertexCompact>& output, glm::vec3& scale, glm::vec3& bias);
+
+/*
+* Same for the vertices in [begin, end) only, so that large meshes can be skinned in pieces
+*/
+void getBoneTransform(const std::vector<glm::mat4>& currentPose, const std::vector<Vertex>& vertices, std::vector<VertexCPU>& verticesCPU,
+    unsigned int begin, unsigned int end);
+
+#endif // SKINNING_H
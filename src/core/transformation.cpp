@@ -0,0 +1,78 @@
+#include "transformation.h"
+
+#include <cmath>
+
+#include "affine.h"
+#include "simd_math.h"
+
+const char* rotationInterpolationName(RotationInterpolation mode)
+{
+    switch (mode) {
+    case RotationInterpolation::Nlerp: return "nlerp";
+    case RotationInterpolation::ONlerp: return "onlerp";
+    default: return "slerp";
+    }
+}
+
+bool parseRotationInterpolation(const std::string& name, RotationInterpolation& mode)
+{
+    if (name == "slerp")
+        mode = RotationInterpolation::Slerp;
+    else if (name == "nlerp")
+        mode = RotationInterpolation::Nlerp;
+    else if (name == "onlerp")
+        mode = RotationInterpolation::ONlerp;
+    else
+        return false;
+    return true;
+}
+
+Transformation::Transformation(glm::vec3 position, glm::quat rotation, glm::vec3 scale):
+    _position(position), _rotation(rotation), _scale(scale)
+{}
+
+glm::mat4 Transformation::toTransformMatrix()
+{
+    return affineToMat4(toAffine());
+}
+
+glm::mat4x3 Transformation::toAffine() const
+{
+    return composeTRS(_position, _rotation, _scale);
+}
+
+glm::fdualquat Transformation::toDualQuat()
+{
+    glm::fdualquat res = glm::normalize(glm::fdualquat(_rotation, glm::vec3(_position)));
+    if (res.dual.w == -0)
+        res.dual.w = 0;
+    return res;
+}
+
+glm::quat Transformation::interpolateRotation(const glm::quat& a, const glm::quat& b, float progression, RotationInterpolation mode)
+{
+    if (mode == RotationInterpolation::Slerp)
+        return glm::slerp(a, b, progression);
+
+    float cosAngle = glm::dot(a, b);
+    glm::quat end = cosAngle < 0.f ? -b : b;
+    if (mode == RotationInterpolation::ONlerp)
+        progression = onlerpProgression(std::abs(cosAngle), progression);
+    return glm::normalize(a * (1.f - progression) + end * progression);
+}
+
+void Transformation::interpolateRotations(const glm::quat* a, const glm::quat* b, const float* progression, glm::quat* output,
+    unsigned int count, RotationInterpolation mode)
+{
+    switch (mode) {
+    case RotationInterpolation::Nlerp:
+        nlerpBatch(a, b, progression, output, count);
+        break;
+    case RotationInterpolation::ONlerp:
+        onlerpBatch(a, b, progression, output, count);
+        break;
+    default:
+        for (unsigned int i = 0; i < count; i++)
+            output[i] = glm::slerp(a[i], b[i], progression[i]);
+    }
+}
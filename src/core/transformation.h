@@ -1,12 +1,30 @@
 #ifndef TRANSFORMATION_H
 #define TRANSFORMATION_H
 
+#include <cassert>
+#include <string>
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/dual_quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+/*
+* How key rotations are blended. Nlerp skips the trigonometry of slerp and drifts from it by up
+* to 8 degrees on keys 180 degrees apart (under 1 degree up to 90), ONlerp corrects the
+* progression of nlerp to stay within 0.05 degrees of slerp at nearly the cost of nlerp
+*/
+enum class RotationInterpolation
+{
+    Slerp,
+    Nlerp,
+    ONlerp
+};
+
+const char* rotationInterpolationName(RotationInterpolation mode);
+
+bool parseRotationInterpolation(const std::string& name, RotationInterpolation& mode);
+
 class Transformation
 {
 public:
@@ -23,21 +41,35 @@ public:
 
     glm::mat4 toTransformMatrix();
 
+    /*
+    * Same transform as 3x4 affine, composed without intermediate matrices
+    */
+    glm::mat4x3 toAffine() const;
+
     glm::fdualquat toDualQuat();
 
     /*
     * Interpolate 2 transformations based on the progression value (between 0 and 1)
     */
-    static Transformation interpolate(Transformation transformA, Transformation transformB, float progression)
+    static Transformation interpolate(Transformation transformA, Transformation transformB, float progression,
+        RotationInterpolation mode = RotationInterpolation::Slerp)
     {
         assert(progression >= 0 && progression <= 1);
 
         glm::vec3 newPosition = glm::mix(transformA.position(), transformB.position(), progression);
-        glm::quat newRotation = glm::slerp(transformA.rotation(), transformB.rotation(), progression);
+        glm::quat newRotation = interpolateRotation(transformA.rotation(), transformB.rotation(), progression, mode);
         glm::vec3 newScale = glm::mix(transformA.scale(), transformB.scale(), progression);
 
         return Transformation(newPosition, newRotation, newScale);
     }
+
+    static glm::quat interpolateRotation(const glm::quat& a, const glm::quat& b, float progression, RotationInterpolation mode);
+
+    /*
+    * output[i] = interpolateRotation(a[i], b[i], progression[i], mode), vectorized for nlerp and onlerp
+    */
+    static void interpolateRotations(const glm::quat* a, const glm::quat* b, const float* progression, glm::quat* output,
+        unsigned int count, RotationInterpolation mode);
 private:
     glm::vec3 _position;
 
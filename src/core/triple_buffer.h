@@ -0,0 +1,75 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+/*
+* Lock-free handoff of the newest value from one producer thread to one consumer thread.
+* The producer fills back() then publish()es it, the consumer update()s to the newest
+* published value and reads front(). Neither side ever waits for the other: the third
+* slot always leaves the producer somewhere to write, and values the consumer was too
+* slow to pick up are overwritten. Slots are reused, so T keeps its storage from one
+* use to the next
+*/
+template<typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : _back(0), _middle(1), _front(2)
+    {
+
+    }
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /*
+    * Producer side: slot to fill, owned by the producer until publish()
+    */
+    inline T& back() { return this->_slots[this->_back]; }
+
+    /*
+    * Producer side: makes back() the newest value and takes over the oldest slot.
+    * The slot handed back may be the one of any earlier value, not the last published
+    */
+    void publish()
+    {
+        unsigned int previous = this->_middle.exchange(this->_back | FRESH, std::memory_order_acq_rel);
+        this->_back = previous & INDEX;
+    }
+
+    /*
+    * Consumer side: moves front() to the newest published value, false when nothing was
+    * published since the last update
+    */
+    bool update()
+    {
+        if (!(this->_middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        unsigned int previous = this->_middle.exchange(this->_front, std::memory_order_acq_rel);
+        this->_front = previous & INDEX;
+        return true;
+    }
+
+    /*
+    * Consumer side: true when update() would move to a new value
+    */
+    inline bool pending() const { return (this->_middle.load(std::memory_order_relaxed) & FRESH) != 0; }
+
+    /*
+    * Consumer side: value picked by the last update(), owned by the consumer until the next one
+    */
+    inline const T& front() const { return this->_slots[this->_front]; }
+    inline T& front() { return this->_slots[this->_front]; }
+private:
+    // The middle index carries a flag telling whether its slot was published and not consumed yet
+    static const unsigned int INDEX = 3;
+    static const unsigned int FRESH = 4;
+
+    T _slots[3];
+    unsigned int _back;
+    std::atomic<unsigned int> _middle;
+    unsigned int _front;
+};
+
+#endif // TRIPLE_BUFFER_H
@@ -0,0 +1,176 @@
+#include "vertex_animation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "job_system.h"
+#include "pose.h"
+#include "skinning.h"
+
+static const char VAT_MAGIC[4] = { 'V', 'A', 'T', '1' };
+
+static uint16_t quantizeUnit(float value)
+{
+    return uint16_t(std::min(std::max(value, 0.f), 1.f) * 65535.f + 0.5f);
+}
+
+/*
+* Octahedral encoding, 8 bits per coordinate
+*/
+static uint16_t encodeNormal(glm::vec3 n)
+{
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.f)
+        e = glm::vec2((1.f - std::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f));
+    unsigned int x = unsigned(std::min(std::max(e.x * 0.5f + 0.5f, 0.f), 1.f) * 255.f + 0.5f);
+    unsigned int y = unsigned(std::min(std::max(e.y * 0.5f + 0.5f, 0.f), 1.f) * 255.f + 0.5f);
+    return uint16_t((x << 8) | y);
+}
+
+static glm::vec3 decodeNormal(uint16_t packed)
+{
+    glm::vec2 e(float(packed >> 8) / 255.f * 2.f - 1.f, float(packed & 0xff) / 255.f * 2.f - 1.f);
+    glm::vec3 n(e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y));
+    if (n.z < 0.f) {
+        n.x = (1.f - std::abs(e.y)) * (e.x >= 0.f ? 1.f : -1.f);
+        n.y = (1.f - std::abs(e.x)) * (e.y >= 0.f ? 1.f : -1.f);
+    }
+    return glm::normalize(n);
+}
+
+VertexAnimation::VertexAnimation() : _vertexCount(0), _frameCount(0), _frameRate(0), _duration(0), _bounds(), _texels({})
+{
+
+}
+
+void VertexAnimation::bake(Animation& animation, const FlatSkeleton& skeleton, const std::vector<Vertex>& vertices,
+    unsigned int boneCount, const glm::mat4& globalInverseTransform, float frameRate, JobSystem* jobs)
+{
+    this->_vertexCount = (unsigned int)vertices.size();
+    this->_frameRate = frameRate;
+    this->_duration = animation.duration();
+    // One frame every 1 / frameRate, plus the end of the clip which does not have to match its start
+    this->_frameCount = unsigned(std::ceil(this->_duration * frameRate - 1e-3f)) + 1;
+
+    // Skinned first in full precision, the bounds of the whole clip are needed to quantize.
+    // Frames are independent, each keeps its own bounds until they are merged
+    std::vector<glm::vec3> positions(size_t(this->_frameCount) * this->_vertexCount);
+    std::vector<glm::vec3> normals(positions.size());
+    std::vector<AABB> frameBounds(this->_frameCount);
+    auto bakeFrames = [&](unsigned int begin, unsigned int end) {
+        std::vector<glm::mat4> pose(boneCount, glm::mat4(1.f));
+        std::vector<VertexCPU> skinned(vertices.size());
+        for (unsigned int frame = begin; frame < end; frame++) {
+            getPoseFlat(animation, skeleton, frameTime(frame), pose, globalInverseTransform);
+            getBoneTransform(pose, vertices, skinned);
+            for (unsigned int i = 0; i < this->_vertexCount; i++) {
+                const VertexCPU& v = skinned[i];
+                glm::mat4 skinning(v.boneTr0, v.boneTr1, v.boneTr2, v.boneTr3);
+                size_t texel = size_t(frame) * this->_vertexCount + i;
+                positions[texel] = glm::vec3(skinning * glm::vec4(vertices[i].position, 1.f));
+                normals[texel] = glm::normalize(glm::transpose(glm::inverse(glm::mat3(skinning))) * vertices[i].normal);
+                frameBounds[frame].extend(positions[texel]);
+            }
+        }
+    };
+    if (jobs)
+        jobs->parallelFor(this->_frameCount, 1, bakeFrames);
+    else
+        bakeFrames(0, this->_frameCount);
+
+    this->_bounds = AABB();
+    for (const AABB& bounds : frameBounds)
+        this->_bounds.extend(bounds);
+
+    const glm::vec3 extent = glm::max(this->_bounds.max - this->_bounds.min, glm::vec3(1e-6f));
+    this->_texels.resize(4 * positions.size());
+    for (size_t texel = 0; texel < positions.size(); texel++) {
+        glm::vec3 unit = (positions[texel] - this->_bounds.min) / extent;
+        for (int axis = 0; axis < 3; axis++)
+            this->_texels[4 * texel + axis] = quantizeUnit(unit[axis]);
+        this->_texels[4 * texel + 3] = encodeNormal(normals[texel]);
+    }
+}
+
+bool VertexAnimation::save(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "ERROR::VERTEX_ANIMATION::FILE_NOT_SUCCESFULLY_WRITTEN " << path << std::endl;
+        return false;
+    }
+    file.write(VAT_MAGIC, sizeof(VAT_MAGIC));
+    file.write(reinterpret_cast<const char*>(&this->_vertexCount), sizeof(this->_vertexCount));
+    file.write(reinterpret_cast<const char*>(&this->_frameCount), sizeof(this->_frameCount));
+    file.write(reinterpret_cast<const char*>(&this->_frameRate), sizeof(this->_frameRate));
+    file.write(reinterpret_cast<const char*>(&this->_duration), sizeof(this->_duration));
+    file.write(reinterpret_cast<const char*>(&this->_bounds.min), sizeof(glm::vec3));
+    file.write(reinterpret_cast<const char*>(&this->_bounds.max), sizeof(glm::vec3));
+    file.write(reinterpret_cast<const char*>(this->_texels.data()), std::streamsize(bytes()));
+    return bool(file);
+}
+
+bool VertexAnimation::load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[4] = {};
+    if (!file || !file.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, VAT_MAGIC)) {
+        std::cout << "ERROR::VERTEX_ANIMATION::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+        return false;
+    }
+    file.read(reinterpret_cast<char*>(&this->_vertexCount), sizeof(this->_vertexCount));
+    file.read(reinterpret_cast<char*>(&this->_frameCount), sizeof(this->_frameCount));
+    file.read(reinterpret_cast<char*>(&this->_frameRate), sizeof(this->_frameRate));
+    file.read(reinterpret_cast<char*>(&this->_duration), sizeof(this->_duration));
+    file.read(reinterpret_cast<char*>(&this->_bounds.min), sizeof(glm::vec3));
+    file.read(reinterpret_cast<char*>(&this->_bounds.max), sizeof(glm::vec3));
+    this->_texels.resize(size_t(4) * this->_frameCount * this->_vertexCount);
+    file.read(reinterpret_cast<char*>(this->_texels.data()), std::streamsize(bytes()));
+    if (!file || this->_frameCount == 0) {
+        std::cout << "ERROR::VERTEX_ANIMATION::TRUNCATED_FILE " << path << std::endl;
+        *this = VertexAnimation();
+        return false;
+    }
+    return true;
+}
+
+float VertexAnimation::frameTime(unsigned int frame) const
+{
+    // The last frame is the clip just before it loops, sampling at duration would give its start
+    if (frame + 1 >= this->_frameCount)
+        return std::nextafter(this->_duration, 0.f);
+    return std::min(frame / this->_frameRate, std::nextafter(this->_duration, 0.f));
+}
+
+void VertexAnimation::frames(float time, unsigned int& first, unsigned int& second, float& blend) const
+{
+    time = std::fmod(time, this->_duration);
+    if (time < 0.f)
+        time += this->_duration;
+    if (this->_frameCount < 2) {
+        first = second = 0;
+        blend = 0.f;
+        return;
+    }
+    first = std::min(unsigned(time * this->_frameRate), this->_frameCount - 2);
+    second = first + 1;
+    // The last interval is shorter when the duration is not a whole number of frames
+    float start = frameTime(first);
+    float length = frameTime(second) - start;
+    blend = length > 0.f ? std::min(std::max((time - start) / length, 0.f), 1.f) : 0.f;
+}
+
+glm::vec3 VertexAnimation::position(unsigned int frame, unsigned int vertex) const
+{
+    const uint16_t* texel = &this->_texels[4 * (size_t(frame) * this->_vertexCount + vertex)];
+    glm::vec3 unit(texel[0] / 65535.f, texel[1] / 65535.f, texel[2] / 65535.f);
+    return this->_bounds.min + unit * glm::max(this->_bounds.max - this->_bounds.min, glm::vec3(1e-6f));
+}
+
+glm::vec3 VertexAnimation::normal(unsigned int frame, unsigned int vertex) const
+{
+    return decodeNormal(this->_texels[4 * (size_t(frame) * this->_vertexCount + vertex) + 3]);
+}
@@ -0,0 +1,73 @@
+#ifndef VERTEX_ANIMATION_H
+#define VERTEX_ANIMATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "animation.h"
+#include "bounds.h"
+#include "flat_skeleton.h"
+#include "importer.h"
+
+class JobSystem;
+
+/*
+* Vertex animation texture: skinned positions and normals of every vertex, baked over a clip
+* at a fixed rate for the farthest crowd LOD. Playback fetches two frames per vertex and
+* blends them, with no bone or skinning math.
+* One texel of 4 unsigned 16 bit values per vertex and frame, frames back to back: the
+* position quantized in the bounds of the whole clip, then the octahedral normal as 2 x 8 bits
+*/
+class VertexAnimation
+{
+public:
+    VertexAnimation();
+
+    /*
+    * Samples the clip every 1 / frameRate with getPoseFlat and the CPU skinning matrices,
+    * frames spread over the jobs when given
+    */
+    void bake(Animation& animation, const FlatSkeleton& skeleton, const std::vector<Vertex>& vertices, unsigned int boneCount,
+        const glm::mat4& globalInverseTransform, float frameRate, JobSystem* jobs = nullptr);
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+    inline unsigned int vertexCount() const { return this->_vertexCount; }
+    inline unsigned int frameCount() const { return this->_frameCount; }
+    inline float frameRate() const { return this->_frameRate; }
+    inline float duration() const { return this->_duration; }
+    inline const AABB& bounds() const { return this->_bounds; }
+
+    inline const uint16_t* texels() const { return this->_texels.data(); }
+    inline size_t bytes() const { return this->_texels.size() * sizeof(uint16_t); }
+
+    /*
+    * Animation time the frame was baked at
+    */
+    float frameTime(unsigned int frame) const;
+
+    /*
+    * Frames surrounding the time and the blend between them, looping over the clip
+    */
+    void frames(float time, unsigned int& first, unsigned int& second, float& blend) const;
+
+    /*
+    * Decoded values as the playback shader reads them
+    */
+    glm::vec3 position(unsigned int frame, unsigned int vertex) const;
+    glm::vec3 normal(unsigned int frame, unsigned int vertex) const;
+private:
+    unsigned int _vertexCount;
+    unsigned int _frameCount;
+    float _frameRate;
+    float _duration;
+    AABB _bounds;
+
+    std::vector<uint16_t> _texels;
+};
+
+#endif // VERTEX_ANIMATION_H
@@ -20,16 +20,9 @@
 #include "vao.h"
 #include "keyframe.h"
 #include "shader.h"
-
-struct VertexCPU {
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 uv;
-    glm::vec4 boneTr0 = glm::vec4(1, 0, 0, 0);
-    glm::vec4 boneTr1 = glm::vec4(0, 1, 0, 0);
-    glm::vec4 boneTr2 = glm::vec4(0, 0, 1, 0);
-    glm::vec4 boneTr3 = glm::vec4(0, 0, 0, 1);
-};
+#include "shader_variants.h"
+#include "pose.h"
+#include "skinning.h"
 
 static Vao createVertexArrayCPU(std::vector<VertexCPU>& vertices, std::vector<GLuint> indices) {
     Vao vao(true);
@@ -65,108 +58,95 @@ static Vao createVertexArrayCPU(std::vector<VertexCPU>& vertices, std::vector<GL
     return vao;
 }
 
-static void getPoseCPU(Animation& animation, Bone& bone, float animationTime, std::vector<glm::mat4>& output, glm::mat4& parentTransform, glm::mat4& globalInverseTransform) {
-    animationTime = fmod(animationTime, animation.duration());
-    std::vector<KeyFrame> keyFrames = animation.getBoneKeyFrames(bone.name());
-    glm::mat4 globalTransform = parentTransform;
-    if (!keyFrames.empty())
-    {
-        unsigned int currentKeyFrameIdx;
-        for (unsigned int index = 0; index < keyFrames.size() - 1; ++index)
-        {
-            if (animationTime < keyFrames[index + 1].timeStamp)
-            {
-                currentKeyFrameIdx = index;
-                break;
-            }
-        }
-        KeyFrame currentKeyFrame = keyFrames[currentKeyFrameIdx];
-        KeyFrame nextKeyFrame = keyFrames[(currentKeyFrameIdx + 1) % keyFrames.size()];
-        float timeStamp1 = currentKeyFrame.timeStamp;
-        float timeStamp2 = nextKeyFrame.timeStamp;
-        float progression = (animationTime - timeStamp1) / (timeStamp2 - timeStamp1);
-        if (timeStamp1 > animationTime)
-        {
-            progression = 0; // Happens when first timeStamp > 0
-        }
-        Transformation newTransform = Transformation::interpolate(currentKeyFrame.transform, nextKeyFrame.transform, progression);
-
-        globalTransform = parentTransform * newTransform.toTransformMatrix();
-    }
-    output[bone.id()] = globalInverseTransform * globalTransform * bone.offset();
+static std::vector<Vertex> vertices;
+static std::vector<VertexCPU> verticesCPU;
 
-    for (Bone& child : bone.children()) {
-        getPoseCPU(animation, child, animationTime, output, globalTransform, globalInverseTransform);
-    }
+static glm::mat4 modelMatrixCPU()
+{
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
+    modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 1.0f, 0.0f));
+    //modelMatrix = glm::scale(modelMatrix, glm::vec3(.2f, .2f, .2f));
+    return modelMatrix;
 }
 
-static void getBoneTransform(const std::vector<glm::mat4>& currentPose, const std::vector<Vertex>& vertices, std::vector<VertexCPU>& verticesCPU)
+/*
+* Culling, pose evaluation and skinning, no GL call: may run on the simulation thread
+*/
+static void CPUUpdate(const FrameInput& input, AnimPackage& anim, FrameContext& frame, PoseFrame& out)
 {
-    for (unsigned int idx = 0; idx < vertices.size(); idx++)
+    glm::mat4 modelMatrix = modelMatrixCPU();
+    glm::mat4 projectionMatrix = glm::perspective(glm::radians(input.camera._zoom), input.aspect, 0.01f, 100.0f);
+    glm::mat4 viewMatrix = input.camera.view_matrix();
+    out.viewProjection = projectionMatrix * viewMatrix;
+
+    // Off-screen characters skip both the pose evaluation and the draw
+    out.visible = Frustum(out.viewProjection * modelMatrix).intersects(anim.bounds.at(input.time));
+    float distance = glm::distance(input.camera._position, glm::vec3(modelMatrix[3]));
+    bool update = frame.budget.shouldUpdate(anim.budgetHandle, distance, out.visible);
+    if (!out.visible)
+        return;
+
+    if (update)
     {
-        Vertex vertex = vertices[idx];
-        VertexCPU vertexCPU = verticesCPU[idx];
-        glm::mat4 boneTransform(0.0f);
-        boneTransform += currentPose[vertex.boneIds.x] * vertex.boneWeights.x;
-        boneTransform += currentPose[vertex.boneIds.y] * vertex.boneWeights.y;
-        boneTransform += currentPose[vertex.boneIds.z] * vertex.boneWeights.z;
-        boneTransform += currentPose[vertex.boneIds.w] * vertex.boneWeights.w;
-        vertexCPU.boneTr0 = boneTransform[0];
-        vertexCPU.boneTr1 = boneTransform[1];
-        vertexCPU.boneTr2 = boneTransform[2];
-        vertexCPU.boneTr3 = boneTransform[3];
-
-        verticesCPU[idx] = vertexCPU;
+        ProfileScope scope(frame.profiler, ProfileStage::Pose);
+        unsigned int lodLevel = std::min(frame.budget.tier(anim.budgetHandle), anim.skeletonLOD.levels() - 1);
+        const std::vector<bool>& kept = anim.skeletonLOD.kept(lodLevel);
+        anim.sampleLocal(input.time, &kept, frame.transition);
+        getPoseFromLocal(anim.localPose, anim.flatSkeleton, anim.pose, anim.globalInvTr, &kept);
+        anim.skeletonLOD.applyRemap(lodLevel, anim.pose);
+        anim.poseVersion++;
     }
-}
 
-static std::vector<Vertex> vertices;
-static std::vector<VertexCPU> verticesCPU;
+    // Skipped frames keep the skinned vertices, unless they belong to an older pose
+    bool fresh = out.skinned.size() != verticesCPU.size();
+    if (fresh)
+        out.skinned = verticesCPU;
+    if (fresh || out.skinnedVersion != anim.poseVersion)
+    {
+        ProfileScope scope(frame.profiler, ProfileStage::Skinning);
+        getBoneTransform(anim.pose, vertices, out.skinned);
+        out.skinnedVersion = anim.poseVersion;
+    }
+}
 
-static void CPULoop(float time, FreeCamera camera, AnimPackage& anim)
+static void CPUDraw(AnimPackage& anim, const PoseFrame& in, FrameContext& frame)
 {
-    glm::mat4 identity(1.0);
-
-    std::vector<glm::mat4> currentPose;
-    currentPose.resize(anim.boneCount, identity);
-
-    getPoseCPU(anim.animation, anim.skeleton, time, currentPose, identity, anim.globalInvTr);
-
-    getBoneTransform(currentPose, vertices, verticesCPU);
-
-    glm::mat4 modelMatrix = glm::mat4(1.0f);
-    modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 1.0f, 0.0f));
-    //modelMatrix = glm::scale(modelMatrix, glm::vec3(.2f, .2f, .2f));
-    glm::mat4 projectionMatrix = glm::perspective(glm::radians(camera._zoom), ((float) WIDTH / HEIGHT), 0.01f, 100.0f);
-    glm::mat4 viewMatrix = camera.view_matrix();
-    glm::mat4 viewProjectionMatrix = projectionMatrix * viewMatrix;
-
     glClearColor(0.f, 0.f, 0.f, 1.f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (!in.visible)
+        return;
+
+    glm::mat4 modelMatrix = modelMatrixCPU();
+
     anim.shader.start();
 
-    anim.shader.loadMatrix4("view_projection_matrix", glm::value_ptr(viewProjectionMatrix));
+    anim.shader.loadMatrix4("view_projection_matrix", glm::value_ptr(in.viewProjection));
     anim.shader.loadMatrix4("model_matrix", glm::value_ptr(modelMatrix));
 
     anim.vao.bind();
 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(VertexCPU) * verticesCPU.size(), &verticesCPU[0], GL_STATIC_DRAW);
+    {
+        ProfileScope scope(frame.profiler, ProfileStage::Upload, true);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(VertexCPU) * in.skinned.size(), &in.skinned[0], GL_STATIC_DRAW);
+    }
 
     glActiveTexture(GL_TEXTURE0);
     anim.texture.load();
 
-    glDrawElements(GL_TRIANGLES, anim.vao.getVertexCount(), GL_UNSIGNED_INT, 0);
+    {
+        ProfileScope scope(frame.profiler, ProfileStage::Draw, true);
+        glDrawElements(GL_TRIANGLES, anim.vao.getVertexCount(), GL_UNSIGNED_INT, 0);
+    }
     anim.vao.unbind();
     anim.shader.stop();
 }
 
-static AnimPackage initCPU(const aiScene* scene, aiMesh* mesh)
+static AnimPackage initCPU(const aiScene* scene, aiMesh* mesh, AnimationLibrary& library, unsigned int clip, ShaderVariants& shaders)
 {
     std::cout << "Init anim on CPU" << std::endl;
 
     std::vector<GLuint> indices = {};
     GLuint boneCount = 0;
-    Animation animation;
     Bone skeleton;
 
     glm::mat4 globalInverseTransform = assimpToGlmMatrix(scene->mRootNode->mTransformation);
@@ -188,15 +168,18 @@ static AnimPackage initCPU(const aiScene* scene, aiMesh* mesh)
 
         verticesCPU[idx] = vCPU;
     }
-    loadAnimation(scene, skeleton, animation);
 
     Vao vao = createVertexArrayCPU(verticesCPU, indices);
 
-    Shader shader("V_cpu_shader.glsl", "F_shader.glsl");
-    
-    shader.start();
-    shader.loadInt("diff_texture", 0);
-    shader.stop();
+    SkinningVariant variant;
+    variant.method = SkinningMethod::CPU;
+    Shader shader = shaders.get(variant);
+
+    AnimPackage package(shader, vao, library, clip, skeleton, boneCount, globalInverseTransform);
+    package.skeletonLOD.build(package.skeleton, boneCount, SKELETON_LOD_LEVELS);
+    package.boneBounds = computeBoneBounds(vertices, boneCount);
+    package.paletteFromLocal = matrixPaletteFromLocal;
+    package.buildBounds();
 
-    return AnimPackage(shader, vao, animation, skeleton, boneCount, globalInverseTransform);
+    return package;
 }
\ No newline at end of file
@@ -20,6 +20,8 @@
 #include "vao.h"
 #include "keyframe.h"
 #include "shader.h"
+#include "shader_variants.h"
+#include "pose.h"
 
 static Vao createVertexArrayDual(std::vector<Vertex>& vertices, std::vector<GLuint> indices) {
     Vao vao(true);
@@ -51,116 +53,117 @@ static Vao createVertexArrayDual(std::vector<Vertex>& vertices, std::vector<GLui
     return vao;
 }
 
-static void getPoseDual(Animation& animation, Bone& bone, float animationTime, std::vector<glm::fdualquat>& output,
-    glm::fdualquat& parentTransform) {
-    animationTime = fmod(animationTime, animation.duration());
-    glm::fdualquat identityQuat = glm::fdualquat(glm::quat(1.f, 0.f, 0.f, 0.f), glm::quat(0.f, 0.f, 0.f, 0.f));
-    std::vector<KeyFrame> keyFrames = animation.getBoneKeyFrames(bone.name());
-    glm::mat4 globalTransform;
-    glm::fdualquat globalTransformQuat = identityQuat;
-    if (!keyFrames.empty())
-    {
-        unsigned int currentKeyFrameIdx;
-        for (unsigned int index = 0; index < keyFrames.size() - 1; ++index)
-        {
-            if (animationTime < keyFrames[index + 1].timeStamp)
-            {
-                currentKeyFrameIdx = index;
-                break;
-            }
-        }
-        KeyFrame currentKeyFrame = keyFrames[currentKeyFrameIdx];
-        KeyFrame nextKeyFrame = keyFrames[(currentKeyFrameIdx + 1) % keyFrames.size()];
-        float timeStamp1 = currentKeyFrame.timeStamp;
-        float timeStamp2 = nextKeyFrame.timeStamp;
-        float progression = (animationTime - timeStamp1) / (timeStamp2 - timeStamp1);
-        if (timeStamp1 > animationTime)
-        {
-            progression = 0; // Happens when first timeStamp > 0
-        }
-        Transformation newTransform = Transformation::interpolate(currentKeyFrame.transform, nextKeyFrame.transform, progression);
-
-        globalTransformQuat = glm::normalize(parentTransform * newTransform.toDualQuat());
-        if (globalTransformQuat.dual.w == -0)
-            globalTransformQuat.dual.w = 0;
-    }
-    glm::mat4 offset = bone.offset();
-    glm::fdualquat offsetQuat = glm::normalize(glm::fdualquat(glm::normalize(glm::quat_cast(offset)), glm::vec3(offset[3][0], offset[3][1], offset[3][2])));
-    if (offsetQuat.dual.w == -0)
-        offsetQuat.dual.w = 0;
-
-    glm::fdualquat res = glm::normalize(identityQuat * globalTransformQuat * offsetQuat);
-    if (res.dual.w == -0)
-        res.dual.w = 0;
-
-    output[bone.id()] = res;
+static glm::mat4 modelMatrixDual()
+{
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
+    glm::vec3 rotation = { 90, 0, 0 };
+    modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 1.0f, 0.0f));
+    modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.x), glm::vec3(1, 0, 0));
+    modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.y), glm::vec3(0, 1, 0));
+    modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.z), glm::vec3(0, 0, 1));
+    //modelMatrix = glm::scale(modelMatrix, glm::vec3(.2f, .2f, .2f));
+    return modelMatrix;
+}
 
-    for (Bone& child : bone.children()) {
-        getPoseDual(animation, child, animationTime, output, globalTransformQuat);
-    }
+/*
+* Palette of the package's local pose evaluated as DualGPUUpdate does, so that the bounds
+* follow the pose that is drawn
+*/
+static void dualPaletteFromLocal(AnimPackage& package, std::vector<glm::mat4>& palette)
+{
+    getPoseDualFromLocal(package.localPose, package.flatSkeleton, package.dualPose);
+    // mat3x4_cast stores the rows of the affine transformation
+    for (unsigned int i = 0; i < package.dualPose.size(); i++)
+        palette[i] = glm::transpose(glm::mat4(glm::mat3x4_cast(package.dualPose[i])));
 }
 
-static void DualGPULoop(float time, FreeCamera camera, AnimPackage& anim)
+/*
+* Culling and pose evaluation, no GL call: may run on the simulation thread
+*/
+static void DualGPUUpdate(const FrameInput& input, AnimPackage& anim, FrameContext& frame, PoseFrame& out)
 {
-    glm::fdualquat identityQuat = glm::fdualquat(glm::quat(1.f, 0.f, 0.f, 0.f), glm::quat(0.f, 0.f, 0.f, 0.f));
+    glm::mat4 projectionMatrix = glm::perspective(glm::radians(input.camera._zoom), input.aspect, 0.01f, 100.0f);
+    glm::mat4 viewMatrix = input.camera.view_matrix();
+    out.viewProjection = projectionMatrix * viewMatrix;
 
-    std::vector<glm::fdualquat> currentPose;
+    glm::mat4 modelMatrix = modelMatrixDual();
 
-    currentPose.resize(anim.boneCount, identityQuat);
-    getPoseDual(anim.animation, anim.skeleton, time, currentPose, identityQuat);
+    // Off-screen characters skip both the pose evaluation and the draw
+    out.visible = Frustum(out.viewProjection * modelMatrix).intersects(anim.bounds.at(input.time));
+    float distance = glm::distance(input.camera._position, glm::vec3(modelMatrix[3]));
+    bool update = frame.budget.shouldUpdate(anim.budgetHandle, distance, out.visible);
+    if (!out.visible)
+        return;
 
-    glm::mat4 projectionMatrix = glm::perspective(glm::radians(camera._zoom), ((float) WIDTH / HEIGHT), 0.01f, 100.0f);
-    glm::mat4 viewMatrix = camera.view_matrix();
-    glm::mat4 viewProjectionMatrix = projectionMatrix * viewMatrix;
+    if (update)
+    {
+        ProfileScope scope(frame.profiler, ProfileStage::Pose);
+        unsigned int lodLevel = std::min(frame.budget.tier(anim.budgetHandle), anim.skeletonLOD.levels() - 1);
+        const std::vector<bool>& kept = anim.skeletonLOD.kept(lodLevel);
+        anim.sampleLocal(input.time, &kept, frame.transition);
+        getPoseDualFromLocal(anim.localPose, anim.flatSkeleton, anim.dualPose, &kept);
+        anim.skeletonLOD.applyRemap(lodLevel, anim.dualPose);
+        anim.poseVersion++;
+    }
+    out.dualPose = anim.dualPose;
+}
 
+static void DualGPUDraw(AnimPackage& anim, const PoseFrame& in, FrameContext& frame)
+{
     glClearColor(0.f, 0.f, 0.f, 1.f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    anim.shader.start();
-    glm::mat4 modelMatrix = glm::mat4(1.0f);
-    glm::vec3 rotation = { 90, 0, 0 };
-    modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 1.0f, 0.0f));
-    modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.x), glm::vec3(1, 0, 0));
-    modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.y), glm::vec3(0, 1, 0));
-    modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.z), glm::vec3(0, 0, 1));
-    //modelMatrix = glm::scale(modelMatrix, glm::vec3(.2f, .2f, .2f));
+    if (!in.visible)
+        return;
+
+    glm::mat4 modelMatrix = modelMatrixDual();
 
-    anim.shader.loadMatrix4("view_projection_matrix", glm::value_ptr(viewProjectionMatrix));
+    anim.shader.start();
+    anim.shader.loadMatrix4("view_projection_matrix", glm::value_ptr(in.viewProjection));
     anim.shader.loadMatrix4("model_matrix", glm::value_ptr(modelMatrix));
 
-    for (unsigned int i = 0; i < currentPose.size(); i++) {
-        glm::mat2x4 boneTr = glm::mat2x4_cast(currentPose[i]);
-        anim.shader.loadMatrix2x4("bone_transforms[" + std::to_string(i) + "]", boneTr);
+    {
+        ProfileScope scope(frame.profiler, ProfileStage::Upload, true);
+        glm::mat2x4* palette = frame.arena.allocate<glm::mat2x4>(in.dualPose.size());
+        for (unsigned int i = 0; i < in.dualPose.size(); i++)
+            palette[i] = glm::mat2x4_cast(in.dualPose[i]);
+        anim.shader.loadMatrix2x4("bone_transforms", glm::value_ptr(palette[0]), GLsizei(in.dualPose.size()));
     }
 
     glActiveTexture(GL_TEXTURE0);
     anim.texture.load();
 
     anim.vao.bind();
-    glDrawElements(GL_TRIANGLES, anim.vao.getVertexCount(), GL_UNSIGNED_INT, 0);
+    {
+        ProfileScope scope(frame.profiler, ProfileStage::Draw, true);
+        glDrawElements(GL_TRIANGLES, anim.vao.getVertexCount(), GL_UNSIGNED_INT, 0);
+    }
     anim.vao.unbind();
     anim.shader.stop();
 }
 
-static AnimPackage initDualGPU(const aiScene* scene, aiMesh* mesh)
+static AnimPackage initDualGPU(const aiScene* scene, aiMesh* mesh, AnimationLibrary& library, unsigned int clip, ShaderVariants& shaders)
 {
     std::cout << "Init dual anim on GPU" << std::endl;
 
     std::vector<Vertex> vertices = {};
     std::vector<GLuint> indices = {};
     GLuint boneCount = 0;
-    Animation animation;
     Bone skeleton;
 
     loadModel(scene, mesh, vertices, indices, skeleton, boneCount);
-    loadAnimation(scene, skeleton, animation);
 
     Vao vao = createVertexArrayDual(vertices, indices);
     
-    Shader shader("V_dual_shader.glsl", "F_shader.glsl");
-
-    shader.start();
-    shader.loadInt("diff_texture", 0);
-    shader.stop();
-
-    return AnimPackage(shader, vao, animation, skeleton, boneCount);
+    SkinningVariant variant;
+    variant.method = SkinningMethod::DQ;
+    variant.influences = maxInfluences(vertices);
+    Shader shader = shaders.get(variant);
+
+    AnimPackage package(shader, vao, library, clip, skeleton, boneCount);
+    package.skeletonLOD.build(package.skeleton, boneCount, SKELETON_LOD_LEVELS);
+    package.boneBounds = computeBoneBounds(vertices, boneCount);
+    package.paletteFromLocal = dualPaletteFromLocal;
+    package.buildBounds();
+
+    return package;
 }
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "framebuffer.h"
+
+#include <iostream>
+
+Framebuffer::Framebuffer(int width, int height) : _complete(false)
+{
+    glGenFramebuffers(1, &this->_id);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->_id);
+
+    glGenRenderbuffers(1, &this->_colorId);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->_colorId);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->_colorId);
+
+    glGenRenderbuffers(1, &this->_depthId);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->_depthId);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->_depthId);
+
+    this->_complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (!this->_complete)
+        std::cout << "ERROR::FRAMEBUFFER::INCOMPLETE" << std::endl;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Framebuffer::bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, this->_id);
+}
+
+void Framebuffer::unbind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Framebuffer::cleanUp()
+{
+    glDeleteRenderbuffers(1, &this->_colorId);
+    glDeleteRenderbuffers(1, &this->_depthId);
+    glDeleteFramebuffers(1, &this->_id);
+}
@@ -0,0 +1,29 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <glad/glad.h>
+
+/*
+* Offscreen color + depth target, used when rendering without a visible window
+*/
+class Framebuffer
+{
+public:
+    Framebuffer(int width, int height);
+
+    void bind();
+
+    void unbind();
+
+    void cleanUp();
+
+    inline bool complete() const { return this->_complete; }
+private:
+    GLuint _id;
+    GLuint _colorId;
+    GLuint _depthId;
+
+    bool _complete;
+};
+
+#endif // FRAMEBUFFER_H
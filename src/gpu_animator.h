@@ -20,8 +20,31 @@
 #include "vao.h"
 #include "keyframe.h"
 #include "shader.h"
+#include "shader_variants.h"
+#include "pose.h"
+#include "skinning.h"
 
-static Vao createVertexArrayGPU(std::vector<Vertex>& vertices, std::vector<GLuint> indices) {
+// Crowd bucket: storage buffer of the palettes and vertex buffer of the model matrices of its instances
+static GLuint crowdPaletteBufferId = 0;
+static GLuint crowdInstanceBufferId = 0;
+
+/*
+* Per-instance model matrix of the INSTANCED variant, one column per location from 8 to 11
+*/
+static void setupInstanceAttributes()
+{
+    if (crowdInstanceBufferId == 0)
+        glGenBuffers(1, &crowdInstanceBufferId);
+    glBindBuffer(GL_ARRAY_BUFFER, crowdInstanceBufferId);
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(8 + column);
+        glVertexAttribPointer(8 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (GLvoid*)(sizeof(glm::vec4) * column));
+        glVertexAttribDivisor(8 + column, 1);
+    }
+}
+
+static Vao createVertexArrayGPU(std::vector<Vertex>& vertices, std::vector<GLuint> indices, bool instanced = false) {
     Vao vao(true);
 
     GLuint& vboId = vao.vboId();
@@ -41,6 +64,8 @@ static Vao createVertexArrayGPU(std::vector<Vertex>& vertices, std::vector<GLuin
     glVertexAttribIPointer(3, 4, GL_INT, sizeof(Vertex), (GLvoid*)offsetof(Vertex, boneIds));
     glEnableVertexAttribArray(4);
     glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, boneWeights));
+    if (instanced)
+        setupInstanceAttributes();
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboId);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
@@ -51,99 +76,272 @@ static Vao createVertexArrayGPU(std::vector<Vertex>& vertices, std::vector<GLuin
     return vao;
 }
 
-static void getPoseGPU(Animation& animation, Bone& bone, float animationTime, std::vector<glm::mat4>& output, glm::mat4& parentTransform, glm::mat4& globalInverseTransform) {
-    animationTime = fmod(animationTime, animation.duration());
-    std::vector<KeyFrame> keyFrames = animation.getBoneKeyFrames(bone.name());
-    glm::mat4 globalTransform = parentTransform;
-    if (!keyFrames.empty())
+/*
+* Vertex array of the COMPACT_VERTEX variant, also loads the dequantization of the positions
+* into its shader
+*/
+static Vao createVertexArrayCompact(std::vector<VertexCompact>& vertices, std::vector<GLuint> indices, glm::vec3 positionScale,
+    glm::vec3 positionBias, Shader& shader, bool instanced = false) {
+    Vao vao(true);
+
+    GLuint& vboId = vao.vboId();
+    GLuint& eboId = vao.eboId();
+    glGenBuffers(1, &vboId);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+
+    glBufferData(GL_ARRAY_BUFFER, sizeof(VertexCompact) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(VertexCompact), (GLvoid*)offsetof(VertexCompact, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_BYTE, GL_TRUE, sizeof(VertexCompact), (GLvoid*)offsetof(VertexCompact, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexCompact), (GLvoid*)offsetof(VertexCompact, uv));
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 4, GL_UNSIGNED_BYTE, sizeof(VertexCompact), (GLvoid*)offsetof(VertexCompact, boneIds));
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexCompact), (GLvoid*)offsetof(VertexCompact, boneWeights));
+    if (instanced)
+        setupInstanceAttributes();
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboId);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+
+    vao.setVertexCount(indices.size());
+    vao.unbind();
+
+    shader.start();
+    shader.loadVec3("position_scale", positionScale);
+    shader.loadVec3("position_bias", positionBias);
+    shader.stop();
+
+    return vao;
+}
+
+static glm::mat4 modelMatrixGPU()
+{
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
+    modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 1.0f, 0.0f));
+    //modelMatrix = glm::scale(modelMatrix, glm::vec3(.2f, .2f, .2f));
+    return modelMatrix;
+}
+
+/*
+* GPUUpdate of a crowd: each instance is culled, budgeted and evaluated on its own, then the
+* visible ones are gathered for a single instanced draw. The instances play at their own times
+* while the transition eases one pose, so they switch clips without it
+*/
+static void GPUCrowdUpdate(const FrameInput& input, AnimPackage& anim, FrameContext& frame, PoseFrame& out)
+{
+    out.pose.clear();
+    out.instanceModels.clear();
+    for (CrowdInstance& instance : anim.crowd)
     {
-        unsigned int currentKeyFrameIdx = 0;
-        for (unsigned int index = 0; index < keyFrames.size() - 1; ++index)
-        {
-            if (animationTime < keyFrames[index + 1].timeStamp)
-            {
-                currentKeyFrameIdx = index;
-                break;
-            }
-        }
-        KeyFrame currentKeyFrame = keyFrames[currentKeyFrameIdx];
-        KeyFrame nextKeyFrame = keyFrames[(currentKeyFrameIdx + 1) % keyFrames.size()];
-        float timeStamp1 = currentKeyFrame.timeStamp;
-        float timeStamp2 = nextKeyFrame.timeStamp;
-        float progression = (animationTime - timeStamp1) / (timeStamp2 - timeStamp1);
-        if (timeStamp1 > animationTime)
+        float time = input.time + instance.timeOffset;
+        bool visible = Frustum(out.viewProjection * instance.model).intersects(anim.bounds.at(time));
+        float distance = glm::distance(input.camera._position, glm::vec3(instance.model[3]));
+        bool update = frame.budget.shouldUpdate(instance.budgetHandle, distance, visible);
+        if (!visible)
+            continue;
+
+        if (update)
         {
-            progression = 0; // Happens when first timeStamp > 0
+            ProfileScope scope(frame.profiler, ProfileStage::Pose);
+            unsigned int lodLevel = std::min(frame.budget.tier(instance.budgetHandle), anim.skeletonLOD.levels() - 1);
+            const std::vector<bool>& kept = anim.skeletonLOD.kept(lodLevel);
+            anim.sampleLocal(time, &kept);
+            getPoseFromLocal(anim.localPose, anim.flatSkeleton, instance.pose, anim.globalInvTr, &kept);
+            anim.skeletonLOD.applyRemap(lodLevel, instance.pose);
+            anim.poseVersion++;
         }
-        Transformation newTransform = Transformation::interpolate(currentKeyFrame.transform, nextKeyFrame.transform, progression);
+        out.pose.insert(out.pose.end(), instance.pose.begin(), instance.pose.end());
+        out.instanceModels.push_back(instance.model);
+    }
+    out.visible = !out.instanceModels.empty();
+}
+
+/*
+* Culling and pose evaluation, no GL call: may run on the simulation thread
+*/
+static void GPUUpdate(const FrameInput& input, AnimPackage& anim, FrameContext& frame, PoseFrame& out)
+{
+    glm::mat4 projectionMatrix = glm::perspective(glm::radians(input.camera._zoom), input.aspect, 0.01f, 100.0f);
+    glm::mat4 viewMatrix = input.camera.view_matrix();
+    out.viewProjection = projectionMatrix * viewMatrix;
 
-        globalTransform = parentTransform * newTransform.toTransformMatrix();
+    if (!anim.crowd.empty())
+    {
+        GPUCrowdUpdate(input, anim, frame, out);
+        return;
     }
-    output[bone.id()] = globalInverseTransform * globalTransform * bone.offset();
 
-    for (Bone& child : bone.children()) {
-        getPoseGPU(animation, child, animationTime, output, globalTransform, globalInverseTransform);
+    glm::mat4 modelMatrix = modelMatrixGPU();
+
+    // Off-screen characters skip both the pose evaluation and the draw
+    out.visible = Frustum(out.viewProjection * modelMatrix).intersects(anim.bounds.at(input.time));
+    float distance = glm::distance(input.camera._position, glm::vec3(modelMatrix[3]));
+    bool update = frame.budget.shouldUpdate(anim.budgetHandle, distance, out.visible);
+    if (!out.visible)
+        return;
+
+    if (update)
+    {
+        ProfileScope scope(frame.profiler, ProfileStage::Pose);
+        unsigned int lodLevel = std::min(frame.budget.tier(anim.budgetHandle), anim.skeletonLOD.levels() - 1);
+        const std::vector<bool>& kept = anim.skeletonLOD.kept(lodLevel);
+        anim.sampleLocal(input.time, &kept, frame.transition);
+        getPoseFromLocal(anim.localPose, anim.flatSkeleton, anim.pose, anim.globalInvTr, &kept);
+        anim.skeletonLOD.applyRemap(lodLevel, anim.pose);
+        anim.poseVersion++;
     }
+    out.pose = anim.pose;
 }
 
-static void GPULoop(float time, FreeCamera camera, AnimPackage& anim)
+/*
+* All the visible instances of a crowd in one draw, their palettes read from a storage buffer
+*/
+static void GPUCrowdDraw(AnimPackage& anim, const PoseFrame& in, FrameContext& frame)
 {
-    glm::mat4 identity(1.0);
+    const GLsizei instances = GLsizei(in.instanceModels.size());
 
-    std::vector<glm::mat4> currentPose;
-    currentPose.resize(anim.boneCount, identity);
+    anim.shader.start();
+    anim.shader.loadMatrix4("view_projection_matrix", glm::value_ptr(in.viewProjection));
+    anim.shader.loadInt("bone_count", GLint(anim.boneCount));
+    {
+        ProfileScope scope(frame.profiler, ProfileStage::Upload, true);
+        // Rows of the affine transforms, as the row_major storage buffer of PALETTE_3X4 reads them
+        glm::mat3x4* palette = frame.arena.allocate<glm::mat3x4>(in.pose.size());
+        for (unsigned int i = 0; i < in.pose.size(); i++)
+            palette[i] = glm::transpose(glm::mat4x3(in.pose[i]));
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, crowdPaletteBufferId);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::mat3x4) * in.pose.size(), palette, GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, crowdPaletteBufferId);
 
-    getPoseGPU(anim.animation, anim.skeleton, time, currentPose, identity, anim.globalInvTr);
+        glBindBuffer(GL_ARRAY_BUFFER, crowdInstanceBufferId);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * instances, glm::value_ptr(in.instanceModels[0]), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
 
-    glm::mat4 projectionMatrix = glm::perspective(glm::radians(camera._zoom), ((float) WIDTH / HEIGHT), 0.01f, 100.0f);
-    glm::mat4 viewMatrix = camera.view_matrix();
-    glm::mat4 viewProjectionMatrix = projectionMatrix * viewMatrix;
+    glActiveTexture(GL_TEXTURE0);
+    anim.texture.load();
+
+    anim.vao.bind();
+    {
+        ProfileScope scope(frame.profiler, ProfileStage::Draw, true);
+        glDrawElementsInstanced(GL_TRIANGLES, anim.vao.getVertexCount(), GL_UNSIGNED_INT, 0, instances);
+    }
+    anim.vao.unbind();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    anim.shader.stop();
+}
 
+static void GPUDraw(AnimPackage& anim, const PoseFrame& in, FrameContext& frame)
+{
     glClearColor(0.f, 0.f, 0.f, 1.f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    anim.shader.start();
+    if (!in.visible)
+        return;
+    if (!anim.crowd.empty())
+    {
+        GPUCrowdDraw(anim, in, frame);
+        return;
+    }
 
+    glm::mat4 modelMatrix = modelMatrixGPU();
 
-    glm::mat4 modelMatrix = glm::mat4(1.0f);
-    modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 1.0f, 0.0f));
-    //modelMatrix = glm::scale(modelMatrix, glm::vec3(.2f, .2f, .2f));
+    anim.shader.start();
 
-    anim.shader.loadMatrix4("view_projection_matrix", glm::value_ptr(viewProjectionMatrix));
+    anim.shader.loadMatrix4("view_projection_matrix", glm::value_ptr(in.viewProjection));
     anim.shader.loadMatrix4("model_matrix", glm::value_ptr(modelMatrix));
-    anim.shader.loadMatrix4("bone_transforms", glm::value_ptr(currentPose[0]), GLsizei(anim.boneCount));
+    {
+        ProfileScope scope(frame.profiler, ProfileStage::Upload, true);
+        glm::mat4x3* palette = frame.arena.allocate<glm::mat4x3>(in.pose.size());
+        for (unsigned int i = 0; i < in.pose.size(); i++)
+            palette[i] = glm::mat4x3(in.pose[i]);
+        anim.shader.loadMatrix4x3("bone_transforms", glm::value_ptr(palette[0]), GLsizei(anim.boneCount));
+    }
 
     glActiveTexture(GL_TEXTURE0);
     anim.texture.load();
 
     anim.vao.bind();
-    glDrawElements(GL_TRIANGLES, anim.vao.getVertexCount(), GL_UNSIGNED_INT, 0);
+    {
+        ProfileScope scope(frame.profiler, ProfileStage::Draw, true);
+        glDrawElements(GL_TRIANGLES, anim.vao.getVertexCount(), GL_UNSIGNED_INT, 0);
+    }
     anim.vao.unbind();
     anim.shader.stop();
 }
 
-static AnimPackage initGPU(const aiScene* scene, aiMesh* mesh)
+/*
+* With a crowdSize, the package draws that many characters in rows behind the place of the
+* single one, through the instanced variant, with compact vertices when the bone IDs fit them
+*/
+static AnimPackage initGPU(const aiScene* scene, aiMesh* mesh, AnimationLibrary& library, unsigned int clip, ShaderVariants& shaders,
+    unsigned int crowdSize = 0)
 {
     std::cout << "Init anim on GPU" << std::endl;
 
     std::vector<Vertex> vertices = {};
     std::vector<GLuint> indices = {};
     GLuint boneCount = 0;
-    Animation animation;
     Bone skeleton;
 
     glm::mat4 globalInverseTransform = assimpToGlmMatrix(scene->mRootNode->mTransformation);
     globalInverseTransform = glm::inverse(globalInverseTransform);
    
     loadModel(scene, mesh, vertices, indices, skeleton, boneCount);
-    loadAnimation(scene, skeleton, animation);
 
-    Vao vao = createVertexArrayGPU(vertices, indices);
+    // Palettes are affine, so the 3x4 upload is always correct for them
+    SkinningVariant variant;
+    variant.method = SkinningMethod::LBS;
+    variant.influences = maxInfluences(vertices);
+    variant.palette3x4 = true;
+    variant.instanced = crowdSize > 0;
 
-    Shader shader("V_shader.glsl", "F_shader.glsl");
+    std::vector<VertexCompact> compactVertices;
+    glm::vec3 positionScale, positionBias;
+    if (variant.instanced)
+    {
+        variant.compactVertex = quantizeVertices(vertices, compactVertices, positionScale, positionBias);
+        if (!variant.compactVertex)
+            std::cout << "WARNING::CROWD::COMPACT_VERTEX bone IDs do not fit 8 bits, using full vertices" << std::endl;
+        if (crowdPaletteBufferId == 0)
+            glGenBuffers(1, &crowdPaletteBufferId);
+    }
+    Shader shader = shaders.get(variant);
 
-    shader.start();
-    shader.loadInt("diff_texture", 0);
-    shader.stop();
+    Vao vao = variant.compactVertex
+        ? createVertexArrayCompact(compactVertices, indices, positionScale, positionBias, shader, variant.instanced)
+        : createVertexArrayGPU(vertices, indices, variant.instanced);
+
+    AnimPackage package(shader, vao, library, clip, skeleton, boneCount, globalInverseTransform);
+    package.skeletonLOD.build(package.skeleton, boneCount, SKELETON_LOD_LEVELS);
+    package.boneBounds = computeBoneBounds(vertices, boneCount);
+    package.paletteFromLocal = matrixPaletteFromLocal;
+    package.buildBounds();
+
+    // Square grid centered on the single character's place, rows going away from the camera
+    const AABB& extent = package.bounds.bounds();
+    float spacing = extent.empty() ? 1.f : 1.25f * std::max(extent.max.x - extent.min.x, extent.max.z - extent.min.z);
+    unsigned int side = unsigned(std::ceil(std::sqrt(float(crowdSize))));
+    package.crowd.resize(crowdSize);
+    for (unsigned int i = 0; i < crowdSize; i++)
+    {
+        CrowdInstance& instance = package.crowd[i];
+        float column = float(i % side) - 0.5f * float(side - 1);
+        instance.model = glm::translate(modelMatrixGPU(), glm::vec3(column * spacing, 0.f, -float(i / side) * spacing));
+        instance.timeOffset = library.duration(clip) * float(i) / float(crowdSize);
+        instance.pose.assign(boneCount, glm::mat4(1.f));
+    }
 
-    return AnimPackage(shader, vao, animation, skeleton, boneCount, globalInverseTransform);
+    return package;
+}
+
+static void cleanUpGPU()
+{
+    glDeleteBuffers(1, &crowdPaletteBufferId);
+    glDeleteBuffers(1, &crowdInstanceBufferId);
+    crowdPaletteBufferId = crowdInstanceBufferId = 0;
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "headless_context.h"
+
+#include <iostream>
+#include <glad/glad.h>
+
+#ifdef ANIMATION_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+
+bool createHeadlessContext(int major, int minor)
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+        std::cout << "ERROR::HEADLESS::NO_EGL_DISPLAY" << std::endl;
+        return false;
+    }
+    eglBindAPI(EGL_OPENGL_API);
+
+    // Nothing is ever presented, any config able to render GL will do
+    const EGLint configAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config = NULL;
+    EGLint nbConfigs = 0;
+    eglChooseConfig(display, configAttribs, &config, 1, &nbConfigs);
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, major,
+        EGL_CONTEXT_MINOR_VERSION, minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    context = eglCreateContext(display, nbConfigs > 0 ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cout << "ERROR::HEADLESS::CONTEXT_CREATION_FAILED" << std::endl;
+        destroyHeadlessContext();
+        return false;
+    }
+
+    return gladLoadGLLoader((GLADloadproc)headlessProcAddress) > 0;
+}
+
+void destroyHeadlessContext()
+{
+    if (display == EGL_NO_DISPLAY)
+        return;
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT)
+        eglDestroyContext(display, context);
+    eglTerminate(display);
+
+    context = EGL_NO_CONTEXT;
+    display = EGL_NO_DISPLAY;
+}
+
+void* headlessProcAddress(const char* name)
+{
+    return (void*)eglGetProcAddress(name);
+}
+#else
+bool createHeadlessContext(int major, int minor)
+{
+    (void)major;
+    (void)minor;
+    std::cout << "ERROR::HEADLESS::NOT_BUILT (configure with -DANIMATION_HEADLESS=ON)" << std::endl;
+    return false;
+}
+
+void destroyHeadlessContext()
+{
+}
+
+void* headlessProcAddress(const char* name)
+{
+    (void)name;
+    return nullptr;
+}
+#endif
@@ -0,0 +1,17 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+/*
+* Surfaceless EGL context for hosts without a display, software GL stacks included.
+* Only available when built with ANIMATION_HEADLESS, otherwise creation always fails
+*/
+bool createHeadlessContext(int major, int minor);
+
+void destroyHeadlessContext();
+
+/*
+* Function loader of the headless context, for extensions glad does not know about
+*/
+void* headlessProcAddress(const char* name);
+
+#endif // HEADLESS_CONTEXT_H
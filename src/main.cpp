@@ -1,12 +1,19 @@
 #include "utils.h"
 #include "texture.h"
-#include "cpu_animator.h"
-#include "gpu_animator.h"
-#include "dual_gpu_animator.h"
+#include "simulation.h"
+#include "framebuffer.h"
+#include "headless_context.h"
+#include "camera_path.h"
+
+#include <chrono>
+#include <cstdlib>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+int WIDTH = 800;
+int HEIGHT = 600;
+
 static void OnWindowResize(GLFWwindow* window, int width, int height)
 {
     AppState* app = static_cast<AppState*>(glfwGetWindowUserPointer(window));
@@ -74,6 +81,10 @@ static void OnKeyFun(GLFWwindow* window, int key, int scancode, int action, int
         app->mode = Mode::GPU_DUAL;
         std::cout << "Animation started on GPU with dual" << std::endl;
         break;
+    case GLFW_KEY_F4:
+        app->mode = Mode::VAT;
+        std::cout << "Animation started with vertex animation texture" << std::endl;
+        break;
     }
     if (app->previous_mode != app->mode)
         app->reset = true;
@@ -92,7 +103,7 @@ static void HandleInput(GLFWwindow* window)
     FreeCamera& camera = app->camera;
     Mode& mode = app->mode;
 
-    const struct KeyDelta
+    struct KeyDelta
     {
         int key;
         glm::vec3 delta;
@@ -116,30 +127,198 @@ static void HandleInput(GLFWwindow* window)
     }
 }
 
-int main()
+/*
+* Deterministic runs: fixed animation steps, scripted camera, offscreen target and
+* a timing report after a fixed number of frames
+*/
+struct BenchmarkOptions
+{
+    unsigned int frames = 0; // 0 runs interactively
+    float fixedStep = 0;     // 0 follows the wall clock
+    std::string cameraPath;
+    bool headless = false;
+    Mode mode = Mode::CPU;
+};
+
+static bool ParseMode(const std::string& name, Mode& mode)
+{
+    if (name == "cpu")
+        mode = Mode::CPU;
+    else if (name == "gpu")
+        mode = Mode::GPU;
+    else if (name == "dual")
+        mode = Mode::GPU_DUAL;
+    else if (name == "vat")
+        mode = Mode::VAT;
+    else
+        return false;
+    return true;
+}
+
+/*
+* ID of the clip of the library by name or index, prints the available clips when there is none
+*/
+static int findClip(const AnimationLibrary& library, const std::string& name)
+{
+    int clip = library.find(name);
+    if (clip < 0 && !name.empty() && name.find_first_not_of("0123456789") == std::string::npos)
+        clip = std::atoi(name.c_str());
+    if (clip < 0 || clip >= int(library.size()))
+    {
+        std::cout << "Unknown clip " << name << ", " << library.size() << " clips:" << std::endl;
+        for (unsigned int i = 0; i < library.size(); i++)
+            std::cout << "  " << i << " " << library.name(i) << std::endl;
+        return -1;
+    }
+    return clip;
+}
+
+/*
+* Usage: Animation [--profile [output.csv|output.json]]
+*                  [--benchmark frames] [--fixed-step seconds] [--camera-path file]
+*                  [--mode cpu|gpu|dual|vat] [--vat file] [--headless] [--interpolation slerp|nlerp|onlerp]
+*                  [--clip name|index] [--transition seconds] [--additive name|index[:weight]]
+*                  [--threaded] [--expect-shader-cache] [--crowd count]
+* --crowd draws count characters in the gpu mode, all of them in one instanced draw
+* --expect-shader-cache fails the run when a program had to be compiled instead of being
+* loaded from the binary cache
+*/
+int main(int argc, char** argv)
 {
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_SAMPLES, 4);
+    bool profile = false;
+    std::string profileOutput;
+    std::string clipName;
+    std::string additiveName;
+    std::string vatFile;
+    float additiveWeight = 1.f;
+    float transition = 0.25f;
+    bool threaded = false;
+    bool expectShaderCache = false;
+    unsigned int crowdSize = 0;
+    BenchmarkOptions benchmark;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--profile")
+        {
+            profile = true;
+            if (hasValue && argv[i + 1][0] != '-')
+                profileOutput = argv[++i];
+        }
+        else if (arg == "--benchmark" && hasValue)
+            benchmark.frames = unsigned(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--fixed-step" && hasValue)
+            benchmark.fixedStep = std::max(0.f, float(std::atof(argv[++i])));
+        else if (arg == "--camera-path" && hasValue)
+            benchmark.cameraPath = argv[++i];
+        else if (arg == "--mode" && hasValue && ParseMode(argv[i + 1], benchmark.mode))
+            i++;
+        else if (arg == "--headless")
+            benchmark.headless = true;
+        else if (arg == "--clip" && hasValue)
+            clipName = argv[++i];
+        else if (arg == "--additive" && hasValue)
+        {
+            additiveName = argv[++i];
+            size_t colon = additiveName.rfind(':');
+            if (colon != std::string::npos)
+            {
+                additiveWeight = float(std::atof(additiveName.c_str() + colon + 1));
+                additiveName.resize(colon);
+            }
+        }
+        else if (arg == "--vat" && hasValue)
+            vatFile = argv[++i];
+        else if (arg == "--threaded")
+            threaded = true;
+        else if (arg == "--expect-shader-cache")
+            expectShaderCache = true;
+        else if (arg == "--crowd" && hasValue)
+            crowdSize = unsigned(std::max(0, std::atoi(argv[++i])));
+        else if (arg == "--transition" && hasValue)
+            transition = std::max(0.f, float(std::atof(argv[++i])));
+        else if (arg == "--interpolation" && hasValue)
+        {
+            RotationInterpolation interpolation;
+            if (!parseRotationInterpolation(argv[++i], interpolation))
+            {
+                std::cout << "Unknown interpolation " << argv[i] << std::endl;
+                return 1;
+            }
+            Animation::setDefaultInterpolation(interpolation);
+        }
+        else
+        {
+            std::cout << "Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    const bool offscreen = benchmark.frames > 0;
+    if (offscreen && benchmark.fixedStep == 0)
+        benchmark.fixedStep = 1.f / 60.f;
+    if (benchmark.headless && !offscreen)
+    {
+        std::cout << "--headless requires --benchmark" << std::endl;
+        return 1;
+    }
+
+    CameraPath cameraPath;
+    if (!benchmark.cameraPath.empty() && !cameraPath.load(benchmark.cameraPath))
+        return 1;
 
     AppState app;
-    GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "Projet Animation", nullptr, nullptr);
-    assert(window && "Failed to create window.");
-    glfwSetWindowUserPointer(window, &app);
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, OnWindowResize);
-    glfwSetCursorPosCallback(window, OnMouseMove);
-    glfwSetScrollCallback(window, OnMouseScroll);
-    glfwSetKeyCallback(window, OnKeyFun);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    const int glad_ok = gladLoadGL();
-    assert(glad_ok > 0);
+    app.mode = app.previous_mode = benchmark.mode;
+
+    GLFWwindow* window = nullptr;
+    if (benchmark.headless)
+    {
+        if (!createHeadlessContext(4, 1))
+            return 1;
+        Shader::enableParallelCompile((GLADloadproc)headlessProcAddress);
+    }
+    else
+    {
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_SAMPLES, 4);
+        if (offscreen)
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+        window = glfwCreateWindow(WIDTH, HEIGHT, "Projet Animation", nullptr, nullptr);
+        assert(window && "Failed to create window.");
+        glfwSetWindowUserPointer(window, &app);
+        glfwMakeContextCurrent(window);
+        if (!offscreen)
+        {
+            glfwSetFramebufferSizeCallback(window, OnWindowResize);
+            glfwSetCursorPosCallback(window, OnMouseMove);
+            glfwSetScrollCallback(window, OnMouseScroll);
+            glfwSetKeyCallback(window, OnKeyFun);
+            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        }
+        const int glad_ok = gladLoadGL();
+        assert(glad_ok > 0);
+        // No vsync: the benchmark measures the frame, not the display
+        glfwSwapInterval(offscreen ? 0 : 1);
+        Shader::enableParallelCompile((GLADloadproc)glfwGetProcAddress);
+    }
 
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_MULTISAMPLE);
 
+    // Same target size whatever the host, so that runs stay comparable
+    Framebuffer* target = nullptr;
+    if (offscreen)
+    {
+        target = new Framebuffer(WIDTH, HEIGHT);
+        target->bind();
+        glViewport(0, 0, WIDTH, HEIGHT);
+    }
+
     app.camera.force_refresh();
 
     Assimp::Importer importer;
@@ -155,19 +334,118 @@ int main()
 
     aiMesh* mesh = scene->mMeshes[0];
 
-	AnimPackage CPUAnim = initCPU(scene, mesh);
+    // All clips of the model, the played one is decoded when first drawn
+    AnimationLibrary library;
+    if (library.import(scene) == 0)
+    {
+        std::cout << "ERROR::ANIMATION_LIBRARY::NO_CLIP " << filePath << std::endl;
+        exit(1);
+    }
+    int clip = findClip(library, clipName.empty() ? "0" : clipName);
+    if (clip < 0)
+        return 1;
+
+    // Additive layer: clips that are not already additive get a copy made against the bind pose
+    int additiveClip = -1;
+    if (!additiveName.empty())
+    {
+        additiveClip = findClip(library, additiveName);
+        if (additiveClip < 0)
+            return 1;
+        if (!library.additive(additiveClip))
+        {
+            ReferencePose bindPose;
+            loadBindPose(scene->mRootNode, bindPose);
+            Animation additive = *library.get(additiveClip);
+            additive.makeAdditive(bindPose);
+            additive.setName(additive.name() + "_additive");
+            additiveClip = int(library.add(additive));
+        }
+    }
+
+    ShaderVariants skinningShaders("V_skinning.glsl", "F_shader.glsl");
+
+	AnimPackage CPUAnim = initCPU(scene, mesh, library, clip, skinningShaders);
     CPUAnim.texture = diffuseTexture;
 
-	AnimPackage GPUAnim = initGPU(scene, mesh);
+	AnimPackage GPUAnim = initGPU(scene, mesh, library, clip, skinningShaders, crowdSize);
     GPUAnim.texture = diffuseTexture;
 
-	AnimPackage DualGPUAnim = initDualGPU(scene, mesh);
+	AnimPackage DualGPUAnim = initDualGPU(scene, mesh, library, clip, skinningShaders);
     DualGPUAnim.texture = diffuseTexture;
 
-    float start_time = float(glfwGetTime());
-    while (!glfwWindowShouldClose(window))
+	AnimPackage VATAnim = initVAT(scene, mesh, library, clip, skinningShaders, vatFile);
+    VATAnim.texture = diffuseTexture;
+
+    for (AnimPackage* anim : { &CPUAnim, &GPUAnim, &DualGPUAnim })
+    {
+        anim->additiveClip = additiveClip;
+        anim->additiveWeight = additiveWeight;
+        // The bounds were sampled from the clip alone, the layer can move the mesh out of them
+        if (additiveClip >= 0)
+            anim->buildBounds();
+    }
+
+    // The init functions only submit their programs, statuses are queried
+    // here once the driver had the chance to compile all of them at once
+    for (AnimPackage* anim : { &CPUAnim, &GPUAnim, &DualGPUAnim, &VATAnim })
+    {
+        anim->shader.start();
+        anim->shader.loadInt("diff_texture", 0);
+        anim->shader.stop();
+    }
+    setupVAT(VATAnim);
+
+    ModePackages packages = { &CPUAnim, &GPUAnim, &DualGPUAnim, &VATAnim };
+
+    unsigned int frameIndex = 0;
+    float start_time = offscreen ? 0.f : float(glfwGetTime());
+    unsigned int switches = 0;
+
+    FrameInput previousInput;
+    previousInput.clock = start_time;
+    previousInput.mode = app.mode;
+
+    // Pose evaluation and skinning run on the simulation thread when there is one,
+    // its context then holds the budget and the transitions
+    FrameContext frame;
+    SimulationThread* simulation = threaded ? new SimulationThread(packages, previousInput) : nullptr;
+    FrameContext& simulationContext = simulation ? simulation->context() : frame;
+    simulationContext.transition.setDuration(transition);
+    for (AnimPackage* anim : { &CPUAnim, &GPUAnim, &DualGPUAnim })
+    {
+        anim->budgetHandle = simulationContext.budget.add();
+        for (CrowdInstance& instance : anim->crowd)
+            instance.budgetHandle = simulationContext.budget.add();
+    }
+    if (profile || offscreen)
+    {
+        frame.profiler.enable(profileOutput, offscreen ? benchmark.frames : 240);
+        if (simulation)
+        {
+            simulationContext.profiler.setLabel("Simulation");
+            simulationContext.profiler.enable("", offscreen ? benchmark.frames : 240, false);
+        }
+    }
+
+    // Frame drawn by the single threaded loop, and before the first simulated one
+    PoseFrame current;
+    current.input = previousInput;
+
+    // Loading and compilation are kept out of the measured frames
+    glFinish();
+    if (simulation)
+        simulation->start();
+    std::chrono::steady_clock::time_point benchmarkStart = std::chrono::steady_clock::now();
+
+    while (offscreen ? frameIndex < benchmark.frames : !glfwWindowShouldClose(window))
     {
-        const float current_time = float(glfwGetTime());
+        frame.profiler.beginFrame();
+        frame.arena.reset();
+        frame.allocations.beginFrame();
+        ProfileScope frameScope(frame.profiler, ProfileStage::Frame);
+
+        const float current_time = benchmark.fixedStep > 0 ? frameIndex * benchmark.fixedStep : float(glfwGetTime());
         if (app.pause_delay != 0)
         {
             start_time += app.pause_delay;
@@ -178,30 +456,99 @@ int main()
         {
             start_time = current_time;
             app.reset = false;
+            switches++;
+            frame.allocations.restartWarmup();
         }
 
         float anim_time = current_time - start_time;
 
-        HandleInput(window);
+        {
+            ProfileScope scope(frame.profiler, ProfileStage::Input);
+            if (!cameraPath.empty())
+            {
+                CameraPath::Key key = cameraPath.sample(current_time);
+                app.camera._position = key.position;
+                app.camera._yaw = key.yaw;
+                app.camera._pitch = key.pitch;
+                app.camera.force_refresh();
+            }
+            else if (!offscreen)
+                HandleInput(window);
+        }
         if (app.paused)
         {
             anim_time = app.paused_time;
         }
-        switch (app.mode)
+
+        FrameInput input;
+        input.clock = current_time;
+        input.time = anim_time;
+        input.mode = app.mode;
+        input.camera = app.camera;
+        input.aspect = float(WIDTH) / HEIGHT;
+        input.switches = switches;
+        if (simulation)
+        {
+            // The newest completed frame, the step of this input is computed meanwhile
+            simulation->submit(input);
+            const PoseFrame* latest = simulation->latest();
+            Submit(latest ? *latest : current, packages, frame);
+        }
+        else
         {
-        case Mode::CPU:
-            CPULoop(anim_time, app.camera, CPUAnim);
-            break;
-        case Mode::GPU:
-            GPULoop(anim_time, app.camera, GPUAnim);
-            break;
-        case Mode::GPU_DUAL:
-            DualGPULoop(anim_time, app.camera, DualGPUAnim);
-            break;
+            Simulate(input, previousInput, packages, frame, current);
+            previousInput = input;
+            Submit(current, packages, frame);
+        }
+        frameIndex++;
+
+        if (offscreen)
+        {
+            // Nothing is presented, waiting here keeps the CPU from queuing frames ahead
+            glFinish();
+        }
+        else
+        {
+            glfwSwapBuffers(window);
+
+            ProfileScope scope(frame.profiler, ProfileStage::Input);
+            glfwPollEvents();
         }
+        frame.allocations.endFrame();
+    }
+
+    if (simulation)
+    {
+        simulation->stop();
+        delete simulation;
+    }
+
+    if (offscreen)
+    {
+        double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - benchmarkStart).count();
+        std::cout << "Benchmark: " << frameIndex << " frames in " << totalMs << " ms, "
+            << totalMs / frameIndex << " ms/frame, " << 1000.0 * frameIndex / totalMs << " fps" << std::endl;
+        std::cout << "Shader cache: " << Shader::cacheHits() << " programs loaded, " << Shader::compiled() << " compiled" << std::endl;
+    }
+    int status = 0;
+    if (expectShaderCache && Shader::compiled() > 0)
+    {
+        std::cout << "ERROR::SHADER::CACHE_MISSED " << Shader::compiled() << " programs compiled" << std::endl;
+        status = 1;
+    }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    frame.profiler.cleanUp();
+    cleanUpVAT();
+    cleanUpGPU();
+    skinningShaders.cleanUp();
+    if (target)
+    {
+        target->cleanUp();
+        delete target;
     }
-    glfwTerminate();
-}
\ No newline at end of file
+    if (benchmark.headless)
+        destroyHeadlessContext();
+    else
+        glfwTerminate();
+    return status;
+}
@@ -0,0 +1,279 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+Profiler::Profiler() : _enabled(false), _gpu(false), _frame(0), _reportInterval(240), _origin(Clock::now()),
+    _sampleCount(0), _chromeTrace(false), _firstEvent(true)
+{
+
+}
+
+void Profiler::enable(const std::string& outputPath, unsigned int reportInterval, bool gpu)
+{
+    this->_enabled = true;
+    this->_gpu = gpu;
+    this->_reportInterval = std::max(1u, reportInterval);
+    this->_origin = Clock::now();
+
+    for (unsigned int i = 0; i <= LATENCY; i++) {
+        if (gpu)
+            glGenQueries(STAGE_COUNT, this->_queries[i]);
+        this->_records[i].frame = 0;
+        std::fill(this->_records[i].cpuUs, this->_records[i].cpuUs + STAGE_COUNT, -1.0);
+        std::fill(this->_records[i].gpuIssued, this->_records[i].gpuIssued + STAGE_COUNT, false);
+    }
+    for (unsigned int stage = 0; stage < STAGE_COUNT; stage++) {
+        this->_cpuSamples[stage].assign(this->_reportInterval, -1.0);
+        this->_gpuSamples[stage].assign(this->_reportInterval, -1.0);
+    }
+
+    if (outputPath.empty())
+        return;
+
+    this->_output.open(outputPath);
+    if (!this->_output) {
+        std::cout << "WARNING::PROFILER::OUTPUT_NOT_WRITABLE " << outputPath << std::endl;
+        return;
+    }
+
+    this->_chromeTrace = outputPath.size() >= 5 && outputPath.compare(outputPath.size() - 5, 5, ".json") == 0;
+    if (this->_chromeTrace)
+        this->_output << "[\n";
+    else
+        this->_output << "frame,stage,start_us,cpu_us,gpu_us\n";
+}
+
+double Profiler::nowUs() const
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - this->_origin).count();
+}
+
+void Profiler::beginFrame()
+{
+    if (!this->_enabled)
+        return;
+
+    this->_frame++;
+
+    // The slot was last used LATENCY + 1 frames ago, its queries are done unless the GPU is far behind
+    FrameRecord& record = this->_records[this->_frame % (LATENCY + 1)];
+    if (record.frame != 0) {
+        readQueries(record);
+        emit(record);
+    }
+
+    record.frame = this->_frame;
+    std::fill(record.cpuUs, record.cpuUs + STAGE_COUNT, -1.0);
+    std::fill(record.gpuUs, record.gpuUs + STAGE_COUNT, -1.0);
+    std::fill(record.gpuIssued, record.gpuIssued + STAGE_COUNT, false);
+}
+
+void Profiler::beginCpu(ProfileStage stage)
+{
+    if (!this->_enabled)
+        return;
+
+    unsigned int idx = (unsigned int)stage;
+    FrameRecord& record = this->_records[this->_frame % (LATENCY + 1)];
+    this->_cpuStart[idx] = Clock::now();
+    if (record.cpuUs[idx] < 0) {
+        record.startUs[idx] = nowUs();
+        record.cpuUs[idx] = 0;
+    }
+}
+
+void Profiler::endCpu(ProfileStage stage)
+{
+    if (!this->_enabled)
+        return;
+
+    unsigned int idx = (unsigned int)stage;
+    FrameRecord& record = this->_records[this->_frame % (LATENCY + 1)];
+    record.cpuUs[idx] += std::chrono::duration<double, std::micro>(Clock::now() - this->_cpuStart[idx]).count();
+}
+
+void Profiler::beginGpu(ProfileStage stage)
+{
+    if (!this->_enabled || !this->_gpu)
+        return;
+
+    unsigned int slot = this->_frame % (LATENCY + 1);
+    unsigned int idx = (unsigned int)stage;
+    if (this->_records[slot].gpuIssued[idx])
+        return; // Only the first occurrence of a stage is timed on the GPU
+    glBeginQuery(GL_TIME_ELAPSED, this->_queries[slot][idx]);
+}
+
+void Profiler::endGpu(ProfileStage stage)
+{
+    if (!this->_enabled || !this->_gpu)
+        return;
+
+    unsigned int slot = this->_frame % (LATENCY + 1);
+    unsigned int idx = (unsigned int)stage;
+    if (this->_records[slot].gpuIssued[idx])
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    this->_records[slot].gpuIssued[idx] = true;
+}
+
+void Profiler::readQueries(FrameRecord& record)
+{
+    unsigned int slot = record.frame % (LATENCY + 1);
+    for (unsigned int stage = 0; stage < STAGE_COUNT; stage++) {
+        if (!record.gpuIssued[stage])
+            continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(this->_queries[slot][stage], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue; // Dropped rather than stalling the pipeline
+
+        GLuint64 elapsedNs = 0;
+        glGetQueryObjectui64v(this->_queries[slot][stage], GL_QUERY_RESULT, &elapsedNs);
+        record.gpuUs[stage] = double(elapsedNs) / 1000.0;
+    }
+}
+
+void Profiler::emit(const FrameRecord& record)
+{
+    unsigned int sample = this->_sampleCount % this->_reportInterval;
+    for (unsigned int stage = 0; stage < STAGE_COUNT; stage++) {
+        this->_cpuSamples[stage][sample] = record.cpuUs[stage];
+        this->_gpuSamples[stage][sample] = record.gpuUs[stage];
+
+        if (!this->_output.is_open() || record.cpuUs[stage] < 0)
+            continue;
+
+        const char* name = stageName(ProfileStage(stage));
+        if (this->_chromeTrace) {
+            // GPU durations have no timestamp of their own, they are placed at the CPU submission
+            this->_output << (this->_firstEvent ? "" : ",\n")
+                << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":" << record.startUs[stage]
+                << ",\"dur\":" << record.cpuUs[stage] << ",\"args\":{\"frame\":" << record.frame << "}}";
+            if (record.gpuUs[stage] >= 0)
+                this->_output << ",\n{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":1,\"ts\":" << record.startUs[stage]
+                    << ",\"dur\":" << record.gpuUs[stage] << ",\"args\":{\"frame\":" << record.frame << "}}";
+            this->_firstEvent = false;
+        } else {
+            this->_output << record.frame << ',' << name << ',' << record.startUs[stage] << ','
+                << record.cpuUs[stage] << ',' << record.gpuUs[stage] << '\n';
+        }
+    }
+
+    this->_sampleCount++;
+    if (this->_sampleCount % this->_reportInterval == 0)
+        report();
+}
+
+static bool percentiles(std::vector<double> samples, double res[3])
+{
+    samples.erase(std::remove_if(samples.begin(), samples.end(), [](double v) { return v < 0; }), samples.end());
+    if (samples.empty())
+        return false;
+
+    const double ranks[3] = { 0.5, 0.95, 0.99 };
+    for (int i = 0; i < 3; i++) {
+        std::vector<double>::iterator it = samples.begin() + size_t(ranks[i] * (samples.size() - 1));
+        std::nth_element(samples.begin(), it, samples.end());
+        res[i] = *it / 1000.0;
+    }
+    return true;
+}
+
+void Profiler::report()
+{
+    if (!this->_label.empty())
+        std::cout << this->_label << " ";
+    std::cout << "Frames " << this->_sampleCount - std::min(this->_sampleCount, this->_reportInterval) + 1
+        << "-" << this->_sampleCount << " (ms)       cpu p50    p95    p99 |  gpu p50    p95    p99" << std::endl;
+    std::streamsize precision = std::cout.precision();
+    std::cout << std::fixed << std::setprecision(3);
+    for (unsigned int stage = 0; stage < STAGE_COUNT; stage++) {
+        double cpu[3], gpu[3];
+        if (!percentiles(this->_cpuSamples[stage], cpu))
+            continue;
+
+        std::cout << "  " << std::left << std::setw(10) << stageName(ProfileStage(stage)) << std::right;
+        for (double v : cpu)
+            std::cout << std::setw(7) << v;
+        std::cout << " |";
+        if (percentiles(this->_gpuSamples[stage], gpu)) {
+            for (double v : gpu)
+                std::cout << std::setw(7) << v;
+        }
+        std::cout << std::endl;
+    }
+    std::cout.unsetf(std::ios_base::floatfield);
+    std::cout.precision(precision);
+}
+
+void Profiler::cleanUp()
+{
+    if (!this->_enabled)
+        return;
+
+    // Frames still in flight are emitted with the queries that completed
+    if (this->_gpu)
+        glFinish();
+    for (unsigned int i = 1; i <= LATENCY + 1; i++) {
+        FrameRecord& record = this->_records[(this->_frame + i) % (LATENCY + 1)];
+        if (record.frame == 0)
+            continue;
+        readQueries(record);
+        emit(record);
+        record.frame = 0;
+    }
+    if (this->_sampleCount % this->_reportInterval != 0)
+        report();
+
+    if (this->_output.is_open()) {
+        if (this->_chromeTrace)
+            this->_output << "\n]\n";
+        this->_output.close();
+    }
+
+    if (this->_gpu) {
+        for (unsigned int i = 0; i <= LATENCY; i++)
+            glDeleteQueries(STAGE_COUNT, this->_queries[i]);
+    }
+    this->_enabled = false;
+}
+
+const char* Profiler::stageName(ProfileStage stage)
+{
+    switch (stage)
+    {
+    case ProfileStage::Input:
+        return "Input";
+    case ProfileStage::Pose:
+        return "Pose";
+    case ProfileStage::Skinning:
+        return "Skinning";
+    case ProfileStage::Upload:
+        return "Upload";
+    case ProfileStage::Draw:
+        return "Draw";
+    case ProfileStage::Frame:
+        return "Frame";
+    default:
+        return "Unknown";
+    }
+}
+
+ProfileScope::ProfileScope(Profiler& profiler, ProfileStage stage, bool gpu) :
+    _profiler(profiler), _stage(stage), _gpu(gpu)
+{
+    this->_profiler.beginCpu(stage);
+    if (gpu)
+        this->_profiler.beginGpu(stage);
+}
+
+ProfileScope::~ProfileScope()
+{
+    if (this->_gpu)
+        this->_profiler.endGpu(this->_stage);
+    this->_profiler.endCpu(this->_stage);
+}
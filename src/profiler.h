@@ -0,0 +1,118 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+enum class ProfileStage
+{
+    Input,
+    Pose,
+    Skinning,
+    Upload,
+    Draw,
+    Frame,
+    Count
+};
+
+/*
+* Per-stage timings of the main loop. CPU stages are measured with scopes, GPU stages
+* with GL_TIME_ELAPSED queries double-buffered over frames so that reading them never stalls.
+* Keeps a rolling window to print p50/p95/p99 on stdout, and can stream every frame to a
+* CSV file or to a Chrome trace (chrome://tracing) when the output path ends with .json
+*/
+class Profiler
+{
+public:
+    Profiler();
+
+    /*
+    * outputPath may be empty to only get the stdout summary, printed every reportInterval frames.
+    * Without gpu no query is made, and the profiler can be used from a thread without GL context
+    */
+    void enable(const std::string& outputPath = "", unsigned int reportInterval = 240, bool gpu = true);
+
+    /*
+    * Name printed before the summaries, to tell apart profilers of different threads
+    */
+    inline void setLabel(const std::string& label) { this->_label = label; }
+
+    inline bool enabled() const { return this->_enabled; }
+
+    void beginFrame();
+
+    void beginCpu(ProfileStage stage);
+    void endCpu(ProfileStage stage);
+
+    /*
+    * GPU stages must not overlap, GL_TIME_ELAPSED queries cannot be nested
+    */
+    void beginGpu(ProfileStage stage);
+    void endGpu(ProfileStage stage);
+
+    /*
+    * Prints the last summary, closes the output file and deletes the queries
+    */
+    void cleanUp();
+
+    static const char* stageName(ProfileStage stage);
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    static const unsigned int STAGE_COUNT = (unsigned int)ProfileStage::Count;
+    static const unsigned int LATENCY = 2; // Frames before a query result is read back
+
+    struct FrameRecord
+    {
+        unsigned long long frame;
+        double startUs[STAGE_COUNT];
+        double cpuUs[STAGE_COUNT];
+        double gpuUs[STAGE_COUNT];
+        bool gpuIssued[STAGE_COUNT];
+    };
+
+    double nowUs() const;
+    void readQueries(FrameRecord& record);
+    void emit(const FrameRecord& record);
+    void report();
+private:
+    bool _enabled;
+    bool _gpu;
+    std::string _label;
+    unsigned long long _frame;
+    unsigned int _reportInterval;
+
+    Clock::time_point _origin;
+    Clock::time_point _cpuStart[STAGE_COUNT];
+
+    GLuint _queries[LATENCY + 1][STAGE_COUNT];
+    FrameRecord _records[LATENCY + 1];
+
+    // Rolling windows of the last reportInterval frames, in microseconds
+    std::vector<double> _cpuSamples[STAGE_COUNT];
+    std::vector<double> _gpuSamples[STAGE_COUNT];
+    unsigned int _sampleCount;
+
+    std::ofstream _output;
+    bool _chromeTrace;
+    bool _firstEvent;
+};
+
+/*
+* Measures the CPU time of the enclosing block, and its GPU time when gpu is set
+*/
+class ProfileScope
+{
+public:
+    ProfileScope(Profiler& profiler, ProfileStage stage, bool gpu = false);
+    ~ProfileScope();
+private:
+    Profiler& _profiler;
+    ProfileStage _stage;
+    bool _gpu;
+};
+
+#endif // PROFILER_H
@@ -1,8 +1,95 @@
 ﻿#include "shader.h"
 
+#include <cstdint>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#define MAKE_DIR(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define MAKE_DIR(path) mkdir(path, 0755)
+#endif
+
+// GL_KHR_parallel_shader_compile is not part of the generated glad loader
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
 const std::string Shader::SHADER_PATH = "../../../../src/shaders/";
+const std::string Shader::CACHE_PATH = "../../../../shader_cache/";
+
+bool Shader::PARALLEL_COMPILE = false;
+unsigned int Shader::CACHE_HITS = 0;
+unsigned int Shader::COMPILED = 0;
+
+static uint64_t hashString(const std::string& str, uint64_t hash = 14695981039346656037ULL)
+{
+    // FNV-1a
+    for (unsigned char c : str) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string driverString()
+{
+    std::string res;
+    const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    for (GLenum name : names) {
+        const GLubyte* str = glGetString(name);
+        if (str)
+            res += reinterpret_cast<const char*>(str);
+        res += '\n';
+    }
+    return res;
+}
 
-Shader::Shader(std::string vertexPath, std::string fragmentPath): _started(false), _deleted(false) {
+static std::string injectDefines(const std::string& code, const std::vector<std::string>& defines)
+{
+    if (defines.empty())
+        return code;
+
+    std::string header;
+    for (const std::string& define : defines)
+        header += "#define " + define + "\n";
+
+    // #version has to stay the first statement of the source
+    size_t versionPos = code.find("#version");
+    if (versionPos == std::string::npos)
+        return header + code;
+
+    size_t lineEnd = code.find('\n', versionPos);
+    if (lineEnd == std::string::npos)
+        return code + "\n" + header;
+
+    return code.substr(0, lineEnd + 1) + header + code.substr(lineEnd + 1);
+}
+
+void Shader::enableParallelCompile(GLADloadproc loader)
+{
+    GLint nbExtensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &nbExtensions);
+    for (GLint i = 0; i < nbExtensions; i++) {
+        std::string extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (extension != "GL_KHR_parallel_shader_compile" && extension != "GL_ARB_parallel_shader_compile")
+            continue;
+
+        PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)
+            loader(extension[3] == 'K' ? "glMaxShaderCompilerThreadsKHR" : "glMaxShaderCompilerThreadsARB");
+        if (!maxThreads)
+            continue;
+
+        maxThreads(0xFFFFFFFF); // Let the driver pick
+        PARALLEL_COMPILE = true;
+        std::cout << "Parallel shader compilation enabled (" << extension << ")" << std::endl;
+        return;
+    }
+}
+
+Shader::Shader(std::string vertexPath, std::string fragmentPath, const std::vector<std::string>& defines): _started(false), _deleted(false), _linked(false),
+    _vertexID(0), _fragmentID(0) {
     std::string vertexCode;
     std::string fragmentCode;
     std::ifstream vShaderFile;
@@ -20,56 +107,160 @@ Shader::Shader(std::string vertexPath, std::string fragmentPath): _started(false
         vShaderFile.close();
         fShaderFile.close();
 
-        vertexCode   = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
+        vertexCode   = injectDefines(vShaderStream.str(), defines);
+        fragmentCode = injectDefines(fShaderStream.str(), defines);
     } catch(std::ifstream::failure e) {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
     }
 
+    // The binary is only valid for the exact sources and driver that produced it
+    uint64_t key = hashString(fragmentCode, hashString(vertexCode, hashString(driverString())));
+    std::stringstream cacheFile;
+    cacheFile << Shader::CACHE_PATH << std::hex << key << ".bin";
+    this->_cacheFile = cacheFile.str();
+
+    this->ID = glCreateProgram();
+    if (loadBinary()) {
+        CACHE_HITS++;
+        return;
+    }
+
+    COMPILED++;
+    compile(vertexCode, fragmentCode);
+}
+
+void Shader::compile(const std::string& vertexCode, const std::string& fragmentCode)
+{
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
 
-	int success;
-	char infoLog[512];
-	
-	this->_vertexID = glCreateShader(GL_VERTEX_SHADER);
+    // Statuses are only queried in finishLink() so that the driver can keep
+    // compiling in the background while the other programs are submitted
+    this->_vertexID = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(this->_vertexID, 1, &vShaderCode, NULL);
     glCompileShader(this->_vertexID);
 
-    glGetShaderiv(this->_vertexID, GL_COMPILE_STATUS, &success);
-	if(!success) {
-        glGetShaderInfoLog(this->_vertexID, 512, NULL, infoLog);
-	    std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-	}
-	
     this->_fragmentID = glCreateShader(GL_FRAGMENT_SHADER);
     glShaderSource(this->_fragmentID, 1, &fShaderCode, NULL);
     glCompileShader(this->_fragmentID);
+
+    glAttachShader(this->ID, this->_vertexID);
+    glAttachShader(this->ID, this->_fragmentID);
+    glProgramParameteri(this->ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(this->ID);
+}
+
+bool Shader::loadBinary()
+{
+    std::ifstream file(this->_cacheFile, std::ios::binary);
+    if (!file)
+        return false;
+
+    // The format is followed by the binary up to the end of the file
+    file.seekg(0, std::ios::end);
+    std::streamoff size = std::streamoff(file.tellg()) - std::streamoff(sizeof(GLenum));
+    file.seekg(0, std::ios::beg);
+    if (size <= 0)
+        return false;
+
+    GLenum format = 0;
+    file.read(reinterpret_cast<char*>(&format), sizeof(format));
+    std::vector<char> binary(size_t(size), 0);
+    file.read(binary.data(), size);
+    if (file.gcount() != size)
+        return false; // Truncated, e.g. by an interrupted write
+
+    glProgramBinary(this->ID, format, binary.data(), GLsizei(binary.size()));
+
+    int success;
+    glGetProgramiv(this->ID, GL_LINK_STATUS, &success);
+    if (!success)
+        return false; // Rejected by the driver, fall back to compiling
+
+    this->_linked = true;
+    return true;
+}
+
+void Shader::saveBinary() const
+{
+    GLint nbFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nbFormats);
+    if (nbFormats == 0)
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(this->ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(this->ID, length, NULL, &format, binary.data());
+
+    MAKE_DIR(Shader::CACHE_PATH.c_str());
+    std::ofstream file(this->_cacheFile, std::ios::binary);
+    if (!file) {
+        std::cout << "WARNING::SHADER::CACHE_NOT_WRITABLE " << this->_cacheFile << std::endl;
+        return;
+    }
+    file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+    file.write(binary.data(), binary.size());
+}
+
+void Shader::finishLink()
+{
+    if (this->_linked)
+        return;
+    this->_linked = true;
+
+    int success;
+    char infoLog[512];
+
+    glGetShaderiv(this->_vertexID, GL_COMPILE_STATUS, &success);
+    if(!success) {
+        glGetShaderInfoLog(this->_vertexID, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+
     glGetShaderiv(this->_fragmentID, GL_COMPILE_STATUS, &success);
     if (!success) {
         glGetShaderInfoLog(this->_fragmentID, 512, NULL, infoLog);
         std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
     }
-	
-	this->ID = glCreateProgram();
-    glAttachShader(this->ID, this->_vertexID);
-    glAttachShader(this->ID, this->_fragmentID);
-    glLinkProgram(this->ID);
 
     glGetProgramiv(this->ID, GL_LINK_STATUS, &success);
-	if(!success) {
+    if(!success) {
         glGetProgramInfoLog(this->ID, 512, NULL, infoLog);
-	    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-	}
-	
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    } else {
+        saveBinary();
+    }
+
     glDeleteShader(this->_vertexID);
     glDeleteShader(this->_fragmentID);
 }
 
+bool Shader::isReady()
+{
+    if (this->_linked)
+        return true;
+
+    if (PARALLEL_COMPILE) {
+        int done;
+        glGetProgramiv(this->ID, GL_COMPLETION_STATUS_KHR, &done);
+        if (!done)
+            return false;
+    }
+
+    finishLink();
+    return true;
+}
+
 void Shader::start() 
 {
     if(!this->_started)
     {
+        finishLink();
         this->_started = true;
         glUseProgram(this->ID);
     }
@@ -91,11 +282,14 @@ void Shader::cleanUp()
 
     stop();
 
-    glDetachShader(this->ID, this->_vertexID);
-    glDetachShader(this->ID, this->_fragmentID);
+    if (this->_vertexID != 0) // Programs restored from the cache have no shader objects
+    {
+        glDetachShader(this->ID, this->_vertexID);
+        glDetachShader(this->ID, this->_fragmentID);
 
-    glDeleteShader(this->_vertexID);
-    glDeleteShader(this->_fragmentID);
+        glDeleteShader(this->_vertexID);
+        glDeleteShader(this->_fragmentID);
+    }
 
     glDeleteProgram(this->ID);
 
@@ -103,32 +297,42 @@ void Shader::cleanUp()
 }
 
 
-void Shader::loadInt(const std::string& name, int value) const
+void Shader::loadInt(const char* name, int value) const
 {
-    glUniform1i(glGetUniformLocation(this->ID, name.c_str()), value);
+    glUniform1i(glGetUniformLocation(this->ID, name), value);
 }
 
-void Shader::loadBool(const std::string& name, bool value) const
+void Shader::loadBool(const char* name, bool value) const
 {         
     loadInt(name, (int) value);
 }
 
-void Shader::loadFloat(const std::string& name, float value) const
+void Shader::loadFloat(const char* name, float value) const
+{
+    glUniform1f(glGetUniformLocation(this->ID, name), value);
+}
+
+void Shader::loadMatrix4(const char* name, const glm::f32* value, int nb) const
+{
+    glUniformMatrix4fv(glGetUniformLocation(this->ID, name), nb, GL_FALSE, value);
+}
+
+void Shader::loadMatrix4x3(const char* name, const glm::f32* value, int nb) const
 {
-    glUniform1f(glGetUniformLocation(this->ID, name.c_str()), value);
+    glUniformMatrix4x3fv(glGetUniformLocation(this->ID, name), nb, GL_FALSE, value);
 }
 
-void Shader::loadMatrix4(const std::string& name, glm::f32* value, int nb) const
+void Shader::loadMatrix2x4(const char* name, const glm::f32* value, int nb) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(this->ID, name.c_str()), nb, GL_FALSE, value);
+    glUniformMatrix2x4fv(glGetUniformLocation(this->ID, name), nb, GL_FALSE, value);
 }
 
-void Shader::loadMatrix2x4(const std::string& name, glm::mat2x4 value, int nb) const
+void Shader::loadVec3(const char* name, glm::vec3 value) const
 {
-    glUniformMatrix2x4fv(glGetUniformLocation(this->ID, name.c_str()), nb, GL_FALSE, &value[0][0]);
+    glUniform3f(glGetUniformLocation(this->ID, name), value[0], value[1], value[2]);
 }
 
-void Shader::loadVec3(const std::string& name, glm::vec3 value) const
+void Shader::loadIVec2(const char* name, glm::ivec2 value) const
 {
-    glUniform3f(glGetUniformLocation(this->ID, name.c_str()), value[0], value[1], value[2]);
+    glUniform2i(glGetUniformLocation(this->ID, name), value[0], value[1]);
 }
@@ -8,32 +8,69 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
 #include <glad/glad.h>
 
 class Shader
 {
 public:
-    Shader(std::string vertexPath, std::string fragmentPath);
+    /*
+    * Each define ("NAME" or "NAME VALUE") is inserted right after the #version
+    * line of both stages
+    */
+    Shader(std::string vertexPath, std::string fragmentPath, const std::vector<std::string>& defines = {});
 
     void start();
     void stop();
     void cleanUp();
 
-    void loadBool(const std::string& name, bool value) const;  
-    void loadInt(const std::string& name, int value) const;   
-    void loadFloat(const std::string& name, float value) const;
-    void loadMatrix4(const std::string& name, glm::f32* value, int nb = 1) const;
-    void loadMatrix2x4(const std::string& name, glm::mat2x4 value, int nb = 1) const;
-    void loadVec3(const std::string& name, glm::vec3 value) const;
+    /*
+    * Returns true once the program is linked and usable. Never blocks when
+    * the driver exposes GL_KHR_parallel_shader_compile
+    */
+    bool isReady();
+
+    void loadBool(const char* name, bool value) const;
+    void loadInt(const char* name, int value) const;
+    void loadFloat(const char* name, float value) const;
+    void loadMatrix4(const char* name, const glm::f32* value, int nb = 1) const;
+    void loadMatrix4x3(const char* name, const glm::f32* value, int nb = 1) const;
+    void loadMatrix2x4(const char* name, const glm::f32* value, int nb = 1) const;
+    void loadVec3(const char* name, glm::vec3 value) const;
+    void loadIVec2(const char* name, glm::ivec2 value) const;
+
+    /*
+    * Lets the driver spread compilation over several threads. Must be called
+    * once after the context is created and before any Shader is built
+    */
+    static void enableParallelCompile(GLADloadproc loader);
+
+    /*
+    * Programs created from the binary cache and programs compiled from source so far
+    */
+    static inline unsigned int cacheHits() { return CACHE_HITS; }
+    static inline unsigned int compiled() { return COMPILED; }
+private:
+    void compile(const std::string& vertexCode, const std::string& fragmentCode);
+    bool loadBinary();
+    void saveBinary() const;
+    void finishLink();
 private:
     unsigned int ID;
 
-    bool _started, _deleted;
+    bool _started, _deleted, _linked;
 
     GLuint _vertexID;
     GLuint _fragmentID;
 
+    std::string _cacheFile;
+
     static const std::string SHADER_PATH;
+    static const std::string CACHE_PATH;
+
+    static bool PARALLEL_COMPILE;
+    static unsigned int CACHE_HITS;
+    static unsigned int COMPILED;
 };
 
 #endif // SHADER_H
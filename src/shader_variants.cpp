@@ -0,0 +1,64 @@
+#include "shader_variants.h"
+
+unsigned int SkinningVariant::key() const
+{
+    // Fields ignored by a method are left out so that they do not create duplicate programs
+    unsigned int res = unsigned(this->method);
+    if (this->method != SkinningMethod::CPU && this->method != SkinningMethod::VAT)
+        res |= unsigned(this->influences) << 2 | unsigned(this->instanced) << 6 | unsigned(this->compactVertex) << 7;
+    if (this->method == SkinningMethod::LBS)
+        res |= unsigned(this->palette3x4) << 5;
+    return res;
+}
+
+std::vector<std::string> SkinningVariant::defines() const
+{
+    std::vector<std::string> res;
+    switch (this->method)
+    {
+    case SkinningMethod::CPU:
+        res.push_back("SKINNING_CPU");
+        break;
+    case SkinningMethod::LBS:
+        res.push_back("SKINNING_LBS");
+        if (this->palette3x4)
+            res.push_back("PALETTE_3X4");
+        break;
+    case SkinningMethod::DQ:
+        res.push_back("SKINNING_DQ");
+        break;
+    case SkinningMethod::VAT:
+        res.push_back("SKINNING_VAT");
+        break;
+    }
+    if (this->method != SkinningMethod::CPU && this->method != SkinningMethod::VAT)
+    {
+        res.push_back("INFLUENCES " + std::to_string(this->influences));
+        if (this->instanced)
+            res.push_back("INSTANCED");
+        if (this->compactVertex)
+            res.push_back("COMPACT_VERTEX");
+    }
+    return res;
+}
+
+ShaderVariants::ShaderVariants(std::string vertexPath, std::string fragmentPath) :
+    _vertexPath(vertexPath), _fragmentPath(fragmentPath), _shaders({})
+{
+
+}
+
+Shader& ShaderVariants::get(const SkinningVariant& variant)
+{
+    std::unordered_map<unsigned int, Shader>::iterator it = this->_shaders.find(variant.key());
+    if (it == this->_shaders.end())
+        it = this->_shaders.emplace(variant.key(), Shader(this->_vertexPath, this->_fragmentPath, variant.defines())).first;
+    return it->second;
+}
+
+void ShaderVariants::cleanUp()
+{
+    for (auto& shader : this->_shaders)
+        shader.second.cleanUp();
+    this->_shaders.clear();
+}
@@ -0,0 +1,56 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "shader.h"
+
+enum class SkinningMethod
+{
+    CPU,
+    LBS,
+    DQ,
+    VAT // Baked vertex animation, no bones
+};
+
+/*
+* One permutation of the skinning vertex shader. Each field maps to a define of V_skinning.glsl
+*/
+struct SkinningVariant
+{
+    SkinningMethod method = SkinningMethod::LBS;
+    int influences = 4;
+    bool palette3x4 = false;
+    // Palettes of all instances in a storage buffer, model matrix as a per-instance attribute
+    bool instanced = false;
+    // VertexCompact layout, positions dequantized with the position_scale and position_bias uniforms
+    bool compactVertex = false;
+
+    unsigned int key() const;
+
+    std::vector<std::string> defines() const;
+};
+
+/*
+* Compiles permutations of one vertex/fragment pair on demand and keeps them by variant key
+*/
+class ShaderVariants
+{
+public:
+    ShaderVariants(std::string vertexPath, std::string fragmentPath);
+
+    Shader& get(const SkinningVariant& variant);
+
+    inline size_t size() const { return this->_shaders.size(); }
+
+    void cleanUp();
+private:
+    std::string _vertexPath;
+    std::string _fragmentPath;
+
+    std::unordered_map<unsigned int, Shader> _shaders;
+};
+
+#endif // SHADER_VARIANTS_H
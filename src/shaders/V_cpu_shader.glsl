@@ -1,30 +0,0 @@
-#version 430 core
-layout (location = 0) in vec3 position; 
-layout (location = 1) in vec3 normal;
-layout (location = 2) in vec2 uv;
-layout (location = 3) in vec4 boneTransform0;
-layout (location = 4) in vec4 boneTransform1;
-layout (location = 5) in vec4 boneTransform2;
-layout (location = 6) in vec4 boneTransform3;
-
-out vec2 tex_cord;
-out vec3 v_normal;
-out vec3 v_pos;
-
-uniform mat4 view_projection_matrix;
-uniform mat4 model_matrix;
-
-void main()
-{
-    mat4 boneTransform = mat4(1.0);
-    boneTransform[0] = boneTransform0;
-    boneTransform[1] = boneTransform1;
-    boneTransform[2] = boneTransform2;
-    boneTransform[3] = boneTransform3;
-    vec4 pos = boneTransform * vec4(position, 1.0);
-    gl_Position = view_projection_matrix * model_matrix * pos;
-    v_pos = vec3(model_matrix * boneTransform * pos);
-    tex_cord = uv;
-    v_normal = mat3(transpose(inverse(model_matrix * boneTransform))) * normal;
-    v_normal = normalize(v_normal);
-}
\ No newline at end of file
@@ -0,0 +1,205 @@
+#version 430 core
+// Permutations are selected by the defines injected by ShaderVariants:
+//   SKINNING_CPU | SKINNING_LBS | SKINNING_DQ | SKINNING_VAT
+//   INFLUENCES      number of bone influences read per vertex (1 to 4)
+//   PALETTE_3X4     LBS palette stored as affine mat4x3 instead of mat4
+//   INSTANCED       per-instance model matrix, palettes read from a storage buffer
+//   COMPACT_VERTEX  VertexCompact layout, positions dequantized with position_scale/bias
+//   MAX_BONES       size of the uniform palette
+
+#ifndef INFLUENCES
+#define INFLUENCES 4
+#endif
+
+#ifndef MAX_BONES
+#define MAX_BONES 100
+#endif
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 uv;
+#if defined(SKINNING_VAT)
+// Baked positions and normals, fetched by vertex and frame (VertexAnimation)
+#elif defined(SKINNING_CPU)
+layout (location = 3) in vec4 boneTransform0;
+layout (location = 4) in vec4 boneTransform1;
+layout (location = 5) in vec4 boneTransform2;
+layout (location = 6) in vec4 boneTransform3;
+#elif defined(COMPACT_VERTEX)
+layout (location = 3) in uvec4 boneIds;
+layout (location = 4) in vec4 boneWeights;
+#else
+layout (location = 3) in ivec4 boneIds;
+layout (location = 4) in vec4 boneWeights;
+#endif
+
+#ifdef INSTANCED
+layout (location = 8) in mat4 instance_model_matrix;
+#define MODEL_MATRIX instance_model_matrix
+#else
+uniform mat4 model_matrix;
+#define MODEL_MATRIX model_matrix
+#endif
+
+out vec2 tex_cord;
+out vec3 v_normal;
+out vec3 v_pos;
+
+uniform mat4 view_projection_matrix;
+
+#ifdef COMPACT_VERTEX
+uniform vec3 position_scale;
+uniform vec3 position_bias;
+#endif
+
+#if defined(SKINNING_DQ)
+#define PALETTE_T mat2x4
+#elif defined(PALETTE_3X4)
+#define PALETTE_T mat4x3
+#else
+#define PALETTE_T mat4
+#endif
+
+#ifdef SKINNING_VAT
+uniform samplerBuffer vat_texels;
+uniform int vat_vertex_count;
+uniform ivec2 vat_frames;
+uniform float vat_blend;
+uniform vec3 vat_min;
+uniform vec3 vat_extent;
+
+vec3 decodeOctahedral(float encoded)
+{
+    uint bits = uint(encoded * 65535.0 + 0.5);
+    vec2 e = vec2(float(bits >> 8u), float(bits & 255u)) / 255.0 * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void vatFetch(out vec3 skinnedPosition, out vec3 skinnedNormal)
+{
+    vec4 a = texelFetch(vat_texels, vat_frames.x * vat_vertex_count + gl_VertexID);
+    vec4 b = texelFetch(vat_texels, vat_frames.y * vat_vertex_count + gl_VertexID);
+    skinnedPosition = vat_min + mix(a.xyz, b.xyz, vat_blend) * vat_extent;
+    skinnedNormal = normalize(mix(decodeOctahedral(a.w), decodeOctahedral(b.w), vat_blend));
+}
+#endif
+
+#if !defined(SKINNING_CPU) && !defined(SKINNING_VAT)
+#ifdef INSTANCED
+// bone_count palettes per instance, one after the other. Affine palettes are stored by rows:
+// std430 would pad each column of a column major mat4x3 to a vec4
+#ifdef PALETTE_3X4
+layout (std430, row_major, binding = 0) readonly buffer BonePalette
+#else
+layout (std430, binding = 0) readonly buffer BonePalette
+#endif
+{
+    PALETTE_T bone_transforms[];
+};
+uniform int bone_count;
+#define BONE(id) bone_transforms[gl_InstanceID * bone_count + int(id)]
+#else
+uniform PALETTE_T bone_transforms[MAX_BONES];
+#define BONE(id) bone_transforms[id]
+#endif
+#endif
+
+#ifdef SKINNING_DQ
+mat4x4 DQtoMat(vec4 real, vec4 dual) {
+	mat4x4 m;
+	float len2 = dot(real, real);
+	float w = real.w, x = real.x, y = real.y, z = real.z;
+	float t0 = dual.w, t1 = dual.x, t2 = dual.y, t3 = dual.z;
+
+	m[0][0] = w * w + x * x - y * y - z * z;
+	m[1][0] = 2 * x * y - 2 * w * z;
+	m[2][0] = 2 * x * z + 2 * w * y;
+
+	m[0][1] = 2 * x * y + 2 * w * z;
+	m[1][1] = w * w + y * y - x * x - z * z;
+	m[2][1] = 2 * y * z - 2 * w * x;
+
+	m[0][2] = 2 * x * z - 2 * w * y;
+	m[1][2] = 2 * y * z + 2 * w * x;
+	m[2][2] = w * w + z * z - x * x - y * y;
+
+	m[3][0] = -2 * t0 * x + 2 * w * t1 - 2 * t2 * z + 2 * y * t3;
+	m[3][1] = -2 * t0 * y + 2 * t1 * z - 2 * x * t3 + 2 * w * t2;
+	m[3][2] = -2 * t0 * z + 2 * x * t2 + 2 * w * t3 - 2 * t1 * y;
+
+	m[0][3] = 0;
+	m[1][3] = 0;
+	m[2][3] = 0;
+	m[3][3] = len2;
+	m /= len2;
+
+	return m;
+}
+#endif
+
+#ifndef SKINNING_VAT
+mat4 skinningMatrix()
+{
+#if defined(SKINNING_CPU)
+    return mat4(boneTransform0, boneTransform1, boneTransform2, boneTransform3);
+#elif defined(SKINNING_DQ)
+	mat2x4 dq0 = BONE(boneIds[0]);
+	mat2x4 blendDQ = dq0 * boneWeights[0];
+#if INFLUENCES > 1
+	mat2x4 dq1 = BONE(boneIds[1]);
+	if (dot(dq0[0], dq1[0]) < 0.0) dq1 *= -1.0;
+	blendDQ += dq1 * boneWeights[1];
+#endif
+#if INFLUENCES > 2
+	mat2x4 dq2 = BONE(boneIds[2]);
+	if (dot(dq0[0], dq2[0]) < 0.0) dq2 *= -1.0;
+	blendDQ += dq2 * boneWeights[2];
+#endif
+#if INFLUENCES > 3
+	mat2x4 dq3 = BONE(boneIds[3]);
+	if (dot(dq0[0], dq3[0]) < 0.0) dq3 *= -1.0;
+	blendDQ += dq3 * boneWeights[3];
+#endif
+    return DQtoMat(blendDQ[0], blendDQ[1]);
+#else
+    PALETTE_T boneTransform = BONE(boneIds.x) * boneWeights.x;
+#if INFLUENCES > 1
+    boneTransform += BONE(boneIds.y) * boneWeights.y;
+#endif
+#if INFLUENCES > 2
+    boneTransform += BONE(boneIds.z) * boneWeights.z;
+#endif
+#if INFLUENCES > 3
+    boneTransform += BONE(boneIds.w) * boneWeights.w;
+#endif
+    return mat4(boneTransform);
+#endif
+}
+#endif
+
+void main()
+{
+#ifdef COMPACT_VERTEX
+    vec3 localPosition = position * position_scale + position_bias;
+#else
+    vec3 localPosition = position;
+#endif
+#ifdef SKINNING_VAT
+    vec3 skinnedPosition, skinnedNormal;
+    vatFetch(skinnedPosition, skinnedNormal);
+    vec4 pos = MODEL_MATRIX * vec4(skinnedPosition, 1.0);
+    v_normal = normalize(mat3(transpose(inverse(MODEL_MATRIX))) * skinnedNormal);
+#else
+    mat4 boneTransform = skinningMatrix();
+
+    vec4 pos = MODEL_MATRIX * boneTransform * vec4(localPosition, 1.0);
+    v_normal = mat3(transpose(inverse(MODEL_MATRIX * boneTransform))) * normal;
+    v_normal = normalize(v_normal);
+#endif
+    gl_Position = view_projection_matrix * pos;
+    v_pos = vec3(pos);
+    tex_cord = uv;
+}
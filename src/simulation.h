@@ -0,0 +1,179 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "utils.h"
+#include "cpu_animator.h"
+#include "gpu_animator.h"
+#include "dual_gpu_animator.h"
+#include "vat_animator.h"
+#include "triple_buffer.h"
+
+/*
+* Package drawn by each mode
+*/
+struct ModePackages
+{
+    AnimPackage* cpu;
+    AnimPackage* gpu;
+    AnimPackage* dual;
+    AnimPackage* vat;
+};
+
+/*
+* Update half of a frame for the mode of the input: transitions, culling, pose evaluation
+* and skinning into out. Never touches GL, previous is the input of the last call
+*/
+static void Simulate(const FrameInput& input, const FrameInput& previous, const ModePackages& packages,
+    FrameContext& frame, PoseFrame& out)
+{
+    // Transitions follow the wall clock, however many inputs were skipped in between
+    frame.transition.advance(input.clock - previous.clock);
+    if (input.switches != previous.switches)
+    {
+        // The new animation starts over, the pose shown so far eases into it
+        frame.transition.start();
+    }
+
+    frame.budget.beginFrame();
+    out.input = input;
+    switch (input.mode)
+    {
+    case Mode::CPU:
+        CPUUpdate(input, *packages.cpu, frame, out);
+        break;
+    case Mode::GPU:
+        GPUUpdate(input, *packages.gpu, frame, out);
+        break;
+    case Mode::GPU_DUAL:
+        DualGPUUpdate(input, *packages.dual, frame, out);
+        break;
+    case Mode::VAT:
+        VATUpdate(input, *packages.vat, frame, out);
+        break;
+    }
+}
+
+/*
+* Draw half of a frame: uploads and draws what Simulate produced, on the GL thread
+*/
+static void Submit(const PoseFrame& in, const ModePackages& packages, FrameContext& frame)
+{
+    switch (in.input.mode)
+    {
+    case Mode::CPU:
+        CPUDraw(*packages.cpu, in, frame);
+        break;
+    case Mode::GPU:
+        GPUDraw(*packages.gpu, in, frame);
+        break;
+    case Mode::GPU_DUAL:
+        DualGPUDraw(*packages.dual, in, frame);
+        break;
+    case Mode::VAT:
+        VATDraw(*packages.vat, in, frame);
+        break;
+    }
+}
+
+/*
+* Runs Simulate on its own thread. The GL thread hands over its input and draws the newest
+* completed frame, both through triple buffers: pose evaluation and skinning of the next
+* frame overlap with the submission and the swap of the current one, and neither thread
+* ever blocks the other. Frames are shown one step after their input.
+* The packages belong to the simulation thread between start() and stop(), it has its own
+* FrameContext for the budget, the transitions and the CPU stages of its profiler
+*/
+class SimulationThread
+{
+public:
+    SimulationThread(const ModePackages& packages, const FrameInput& first) :
+        _packages(packages), _previous(first), _running(false), _received(false)
+    {
+
+    }
+
+    ~SimulationThread()
+    {
+        stop();
+    }
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    inline FrameContext& context() { return this->_context; }
+
+    void start()
+    {
+        if (this->_running.exchange(true))
+            return;
+        this->_thread = std::thread(&SimulationThread::run, this);
+    }
+
+    void stop()
+    {
+        if (!this->_running.exchange(false))
+            return;
+        this->_thread.join();
+        this->_context.profiler.cleanUp();
+    }
+
+    /*
+    * GL thread: input of the next step, replaces the last one if it was not picked up yet
+    */
+    void submit(const FrameInput& input)
+    {
+        this->_inputs.back() = input;
+        this->_inputs.publish();
+    }
+
+    /*
+    * GL thread: newest completed frame, nullptr until the first one. Stays valid until the next call
+    */
+    const PoseFrame* latest()
+    {
+        if (this->_frames.update())
+            this->_received = true;
+        return this->_received ? &this->_frames.front() : nullptr;
+    }
+private:
+    void run()
+    {
+        unsigned int idle = 0;
+        while (this->_running.load(std::memory_order_acquire))
+        {
+            if (!this->_inputs.update())
+            {
+                // Spins for a short wait, then gives the core back while the GL thread waits on vsync
+                if (++idle < 64)
+                    std::this_thread::yield();
+                else
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+            idle = 0;
+
+            this->_context.profiler.beginFrame();
+            {
+                ProfileScope frameScope(this->_context.profiler, ProfileStage::Frame);
+                const FrameInput& input = this->_inputs.front();
+                Simulate(input, this->_previous, this->_packages, this->_context, this->_frames.back());
+                this->_previous = input;
+            }
+            this->_frames.publish();
+        }
+    }
+private:
+    ModePackages _packages;
+    FrameContext _context;
+    FrameInput _previous;
+
+    TripleBuffer<FrameInput> _inputs;
+    TripleBuffer<PoseFrame> _frames;
+
+    std::atomic<bool> _running;
+    std::thread _thread;
+    bool _received;
+};
@@ -7,9 +7,13 @@ const std::string Texture::DIR_PATH = "../../../../assets/";
 
 Texture::Texture(const std::string& file)
 {
-    int width, height, nrChannels;
+    int width = 0, height = 0, nrChannels = 0;
     std::string str = Texture::DIR_PATH + file;
     stbi_uc* data = stbi_load(str.c_str(), &width, &height, &nrChannels, 4);
+    // A missing file gives a single white texel rather than an upload of undefined size
+    stbi_uc white[4] = { 255, 255, 255, 255 };
+    if (!data)
+        std::cout << "ERROR::TEXTURE::FILE_NOT_LOADED " << str << std::endl;
     glGenTextures(1, &this->_id);
 
     load();
@@ -20,7 +24,10 @@ Texture::Texture(const std::string& file)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 3);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    if (data)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
 
     stbi_image_free(data);
 
@@ -0,0 +1,775 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/dual_quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include "affine.h"
+#include "animation.h"
+#include "animation_library.h"
+#include "bone.h"
+#include "bone_query.h"
+#include "flat_skeleton.h"
+#include "framebuffer.h"
+#include "headless_context.h"
+#include "importer.h"
+#include "inertialization.h"
+#include "pose.h"
+#include "pose_blend.h"
+#include "pose_group.h"
+#include "skeleton_lod.h"
+#include "skinning.h"
+
+/*
+* Accuracy harness: evaluates clips through a double precision reference of getPose and
+* measures how far each optimized path drifts from it, as positional errors per bone
+* (palette applied to the bone's bind-space extents) and per skinned vertex.
+* Also bounds the approximate rotation interpolations (nlerp, onlerp) against slerp.
+* --gpu also reads the GPU skinning back through transform feedback (needs ANIMATION_HEADLESS).
+* Usage: Accuracy [--samples N] [--gpu] [--csv file] [model files relative to assets/...]
+*/
+
+static const unsigned int LOD_LEVELS = 4;
+
+struct ErrorStats
+{
+    double max = 0;
+    double sum = 0;
+    unsigned long long count = 0;
+
+    void add(double error)
+    {
+        max = std::max(max, error);
+        sum += error;
+        count++;
+    }
+
+    double mean() const { return count ? sum / count : 0; }
+};
+
+/*
+* Errors of one path, indexed by bone id and by vertex index. Either may be empty
+*/
+struct PathReport
+{
+    std::string name;
+    std::vector<ErrorStats> bones;
+    std::vector<ErrorStats> vertices;
+};
+
+/*
+* Reference sampling: keys located by interval, held past the last one, everything in double
+*/
+static glm::dmat4 referenceLocalTransform(const std::vector<KeyFrame>& keyFrames, double time)
+{
+    unsigned int idx = 0;
+    while (idx + 1 < keyFrames.size() && keyFrames[idx + 1].timeStamp <= time)
+        idx++;
+
+    const KeyFrame& current = keyFrames[idx];
+    const KeyFrame& next = keyFrames[std::min(idx + 1, (unsigned int)keyFrames.size() - 1)];
+    double progression = 0;
+    if (next.timeStamp > current.timeStamp && time > current.timeStamp)
+        progression = std::min(1.0, (time - current.timeStamp) / (double(next.timeStamp) - current.timeStamp));
+
+    const Transformation& a = current.transform;
+    const Transformation& b = next.transform;
+    glm::dvec3 position = glm::mix(glm::dvec3(a.position()), glm::dvec3(b.position()), progression);
+    glm::dquat rotation = glm::slerp(glm::dquat(a.rotation()), glm::dquat(b.rotation()), progression);
+    glm::dvec3 scale = glm::mix(glm::dvec3(a.scale()), glm::dvec3(b.scale()), progression);
+
+    glm::dmat4 res = glm::mat4_cast(glm::normalize(rotation));
+    res[0] *= scale.x;
+    res[1] *= scale.y;
+    res[2] *= scale.z;
+    res[3] = glm::dvec4(position, 1.0);
+    return res;
+}
+
+static void getPoseReference(Animation& animation, Bone& bone, double time, std::vector<glm::dmat4>& output,
+    const glm::dmat4& parentTransform, const glm::dmat4& globalInverseTransform)
+{
+    const std::vector<KeyFrame>& keyFrames = animation.getBoneKeyFrames(bone.name());
+    glm::dmat4 globalTransform = parentTransform;
+    if (!keyFrames.empty())
+        globalTransform = parentTransform * referenceLocalTransform(keyFrames, time);
+    output[bone.id()] = globalInverseTransform * globalTransform * glm::dmat4(bone.offset());
+
+    for (Bone& child : bone.children())
+        getPoseReference(animation, child, time, output, globalTransform, globalInverseTransform);
+}
+
+static void readBoneNames(Bone& bone, std::vector<std::string>& names)
+{
+    names[bone.id()] = bone.name();
+    for (Bone& child : bone.children())
+        readBoneNames(child, names);
+}
+
+/*
+* Blends like V_skinning.glsl does: sign-aligned with the first influence, then normalized
+*/
+template<typename T>
+static glm::tvec3<T, glm::defaultp> skinDual(const std::vector<glm::tdualquat<T, glm::defaultp>>& pose, const Vertex& vertex)
+{
+    typedef glm::tdualquat<T, glm::defaultp> DualQuat;
+    const DualQuat& first = pose[vertex.boneIds[0]];
+    DualQuat blend = first * T(vertex.boneWeights[0]);
+    for (int i = 1; i < 4; i++) {
+        DualQuat dq = pose[vertex.boneIds[i]];
+        T weight = T(vertex.boneWeights[i]);
+        if (glm::dot(first.real, dq.real) < 0)
+            weight = -weight;
+        blend.real = blend.real + dq.real * weight;
+        blend.dual = blend.dual + dq.dual * weight;
+    }
+    return glm::normalize(blend) * glm::tvec3<T, glm::defaultp>(vertex.position);
+}
+
+static void skinLinear(const std::vector<glm::mat4>& pose, const std::vector<Vertex>& vertices, std::vector<glm::vec3>& output)
+{
+    for (unsigned int i = 0; i < vertices.size(); i++) {
+        const Vertex& vertex = vertices[i];
+        glm::mat4 blend(0.0f);
+        for (int k = 0; k < 4; k++)
+            blend += pose[vertex.boneIds[k]] * vertex.boneWeights[k];
+        output[i] = glm::vec3(blend * glm::vec4(vertex.position, 1.0f));
+    }
+}
+
+static glm::ddualquat toDualQuat(const glm::dmat4& m)
+{
+    glm::dquat rotation = glm::normalize(glm::quat_cast(glm::dmat3(m)));
+    return glm::normalize(glm::ddualquat(rotation, glm::dvec3(m[3])));
+}
+
+/*
+* 8 corners of the bone's bind-space extents, or its origin when no vertex follows it
+*/
+static std::vector<glm::dvec3> probePoints(const AABB& bounds)
+{
+    if (bounds.empty())
+        return { glm::dvec3(0.0) };
+
+    std::vector<glm::dvec3> points;
+    for (int corner = 0; corner < 8; corner++) {
+        points.push_back(glm::dvec3(corner & 1 ? bounds.max.x : bounds.min.x,
+            corner & 2 ? bounds.max.y : bounds.min.y,
+            corner & 4 ? bounds.max.z : bounds.min.z));
+    }
+    return points;
+}
+
+static void comparePalette(const std::vector<glm::mat4>& pose, const std::vector<glm::dmat4>& reference,
+    const std::vector<std::vector<glm::dvec3>>& probes, std::vector<ErrorStats>& stats)
+{
+    for (unsigned int bone = 0; bone < reference.size(); bone++) {
+        double error = 0;
+        for (const glm::dvec3& p : probes[bone]) {
+            glm::dvec3 expected = glm::dvec3(reference[bone] * glm::dvec4(p, 1.0));
+            glm::dvec3 actual = glm::dvec3(glm::dmat4(pose[bone]) * glm::dvec4(p, 1.0));
+            error = std::max(error, glm::length(actual - expected));
+        }
+        stats[bone].add(error);
+    }
+}
+
+static void compareVertices(const std::vector<glm::vec3>& positions, const std::vector<glm::dvec3>& reference,
+    std::vector<ErrorStats>& stats)
+{
+    for (unsigned int i = 0; i < reference.size(); i++)
+        stats[i].add(glm::length(glm::dvec3(positions[i]) - reference[i]));
+}
+
+static PathReport makeReport(const std::string& name, unsigned int boneCount, size_t vertexCount)
+{
+    PathReport report;
+    report.name = name;
+    report.bones.resize(boneCount);
+    report.vertices.resize(vertexCount);
+    return report;
+}
+
+/*
+* GPU skinning read back through transform feedback: every vertex is drawn once as a
+* point with rasterization disabled, and v_pos (model space, identity model matrix) is captured.
+* Surfaceless contexts have no default framebuffer, draws still need a complete one bound
+*/
+class GpuSkinning
+{
+public:
+    GpuSkinning(const std::vector<Vertex>& vertices) : _vertexCount((GLsizei)vertices.size()), _target(1, 1)
+    {
+        glGenVertexArrays(1, &this->_vao);
+        glBindVertexArray(this->_vao);
+        glGenBuffers(1, &this->_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, this->_vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, uv));
+        glEnableVertexAttribArray(3);
+        glVertexAttribIPointer(3, 4, GL_INT, sizeof(Vertex), (GLvoid*)offsetof(Vertex, boneIds));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, boneWeights));
+        glBindVertexArray(0);
+
+        glGenBuffers(1, &this->_feedback);
+        glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, this->_feedback);
+        glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, sizeof(glm::vec3) * vertices.size(), nullptr, GL_STREAM_READ);
+        glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+
+        this->_lbs = createProgram("SKINNING_LBS");
+        this->_dual = createProgram("SKINNING_DQ");
+    }
+
+    inline bool valid() const { return this->_lbs && this->_dual; }
+
+    void skin(const std::vector<glm::mat4>& pose, std::vector<glm::vec3>& output)
+    {
+        glUseProgram(this->_lbs);
+        glUniformMatrix4fv(glGetUniformLocation(this->_lbs, "bone_transforms"), (GLsizei)pose.size(), GL_FALSE, glm::value_ptr(pose[0]));
+        run(output);
+    }
+
+    void skin(const std::vector<glm::fdualquat>& pose, std::vector<glm::vec3>& output)
+    {
+        std::vector<glm::mat2x4> palette(pose.size());
+        for (unsigned int i = 0; i < pose.size(); i++)
+            palette[i] = glm::mat2x4_cast(pose[i]);
+        glUseProgram(this->_dual);
+        glUniformMatrix2x4fv(glGetUniformLocation(this->_dual, "bone_transforms"), (GLsizei)palette.size(), GL_FALSE, glm::value_ptr(palette[0]));
+        run(output);
+    }
+
+    void cleanUp()
+    {
+        glDeleteProgram(this->_lbs);
+        glDeleteProgram(this->_dual);
+        glDeleteBuffers(1, &this->_feedback);
+        glDeleteBuffers(1, &this->_vbo);
+        glDeleteVertexArrays(1, &this->_vao);
+        this->_target.cleanUp();
+    }
+private:
+    static GLuint createProgram(const std::string& method)
+    {
+        std::ifstream file(std::string(PROJECT_SOURCE_DIR) + "/src/shaders/V_skinning.glsl");
+        std::stringstream stream;
+        stream << file.rdbuf();
+        std::string code = stream.str();
+        if (code.empty()) {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            return 0;
+        }
+        size_t versionEnd = code.find('\n') + 1;
+        code.insert(versionEnd, "#define " + method + "\n");
+
+        const char* source = code.c_str();
+        GLuint shader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+
+        GLuint program = glCreateProgram();
+        glAttachShader(program, shader);
+        const char* varyings[] = { "v_pos" };
+        glTransformFeedbackVaryings(program, 1, varyings, GL_INTERLEAVED_ATTRIBS);
+        glLinkProgram(program);
+        glDeleteShader(shader);
+
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            char infoLog[1024];
+            glGetProgramInfoLog(program, 1024, NULL, infoLog);
+            std::cout << "ERROR::PROGRAM_LINKING_ERROR " << method << "\n" << infoLog << std::endl;
+            glDeleteProgram(program);
+            return 0;
+        }
+
+        glUseProgram(program);
+        glm::mat4 identity(1.0f);
+        glUniformMatrix4fv(glGetUniformLocation(program, "model_matrix"), 1, GL_FALSE, glm::value_ptr(identity));
+        glUniformMatrix4fv(glGetUniformLocation(program, "view_projection_matrix"), 1, GL_FALSE, glm::value_ptr(identity));
+        return program;
+    }
+
+    void run(std::vector<glm::vec3>& output)
+    {
+        this->_target.bind();
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(this->_vao);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, this->_feedback);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, this->_vertexCount);
+        glEndTransformFeedback();
+        glBindVertexArray(0);
+        glDisable(GL_RASTERIZER_DISCARD);
+        this->_target.unbind();
+
+        output.resize(this->_vertexCount);
+        glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, this->_feedback);
+        glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, sizeof(glm::vec3) * output.size(), &output[0]);
+        glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+    }
+private:
+    GLsizei _vertexCount;
+    GLuint _vao, _vbo, _feedback;
+    GLuint _lbs, _dual;
+    Framebuffer _target;
+};
+
+static void printReport(const PathReport& report, const std::vector<std::string>& boneNames)
+{
+    std::cout << "  " << std::left << std::setw(20) << report.name << std::right;
+
+    ErrorStats bones, vertices;
+    unsigned int worstBone = 0, worstVertex = 0;
+    for (unsigned int i = 0; i < report.bones.size(); i++) {
+        if (report.bones[i].max > report.bones[worstBone].max)
+            worstBone = i;
+        bones.max = std::max(bones.max, report.bones[i].max);
+        bones.sum += report.bones[i].sum;
+        bones.count += report.bones[i].count;
+    }
+    for (unsigned int i = 0; i < report.vertices.size(); i++) {
+        if (report.vertices[i].max > report.vertices[worstVertex].max)
+            worstVertex = i;
+        vertices.max = std::max(vertices.max, report.vertices[i].max);
+        vertices.sum += report.vertices[i].sum;
+        vertices.count += report.vertices[i].count;
+    }
+
+    std::cout << std::scientific << std::setprecision(2);
+    if (bones.count)
+        std::cout << std::setw(10) << bones.max << std::setw(10) << bones.mean() << "  " << std::left << std::setw(16)
+            << boneNames[worstBone].substr(0, 15) << std::right;
+    else
+        std::cout << std::setw(36) << "-";
+    if (vertices.count)
+        std::cout << " |" << std::setw(10) << vertices.max << std::setw(10) << vertices.mean() << std::setw(8) << worstVertex;
+    else
+        std::cout << " |" << std::setw(10) << "-";
+    std::cout << std::endl;
+    std::cout.unsetf(std::ios_base::floatfield);
+}
+
+static void writeCsv(std::ofstream& csv, const std::string& file, const PathReport& report)
+{
+    for (unsigned int i = 0; i < report.bones.size(); i++)
+        csv << file << ',' << report.name << ",bone," << i << ',' << report.bones[i].max << ',' << report.bones[i].mean() << '\n';
+    for (unsigned int i = 0; i < report.vertices.size(); i++)
+        csv << file << ',' << report.name << ",vertex," << i << ',' << report.vertices[i].max << ',' << report.vertices[i].mean() << '\n';
+}
+
+/*
+* Rotation error of nlerp and onlerp against a double precision slerp, over random key pairs
+* at most maxAngle apart and progressions in [0, 1]. Bounds the approximate interpolation modes
+* independently of the clips' key spacing
+*/
+static void printInterpolationBounds()
+{
+    const double angles[5] = { 10, 30, 60, 90, 180 };
+    const unsigned int pairs = 4096, steps = 64;
+    unsigned int seed = 12345;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return double(seed >> 8) / double(1 << 24);
+    };
+
+    std::cout << "rotation interpolation vs slerp   max error (degrees)" << std::endl;
+    std::cout << "  key spacing      nlerp      onlerp" << std::endl;
+    for (double maxAngle : angles) {
+        double worst[2] = { 0, 0 };
+        for (unsigned int p = 0; p < pairs; p++) {
+            glm::dvec3 axis = glm::normalize(glm::dvec3(random() - 0.5, random() - 0.5, random() - 0.5) + glm::dvec3(1e-9));
+            glm::dvec3 startAxis = glm::normalize(glm::dvec3(random() - 0.5, random() - 0.5, random() - 0.5) + glm::dvec3(1e-9));
+            glm::dquat start = glm::angleAxis(random() * 2 * glm::pi<double>(), startAxis);
+            glm::dquat end = glm::angleAxis(glm::radians(maxAngle) * random(), axis) * start;
+            glm::quat a(start), b(end);
+            for (unsigned int step = 0; step <= steps; step++) {
+                float t = float(step) / steps;
+                glm::dquat exact = glm::slerp(start, end, double(t));
+                const RotationInterpolation modes[2] = { RotationInterpolation::Nlerp, RotationInterpolation::ONlerp };
+                for (unsigned int m = 0; m < 2; m++) {
+                    // Angle of the relative rotation, atan2 keeps its precision where acos of a dot near 1 would not
+                    glm::dquat approximate = glm::normalize(glm::dquat(Transformation::interpolateRotation(a, b, t, modes[m])));
+                    glm::dquat difference = glm::inverse(exact) * approximate;
+                    double angle = 2 * std::atan2(glm::length(glm::dvec3(difference.x, difference.y, difference.z)), std::abs(difference.w));
+                    worst[m] = std::max(worst[m], glm::degrees(angle));
+                }
+            }
+        }
+        std::cout << "  <= " << std::setw(3) << int(maxAngle) << " deg  " << std::fixed << std::setprecision(4)
+            << std::setw(10) << worst[0] << "  " << std::setw(10) << worst[1] << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+    }
+}
+
+/*
+* Restarts the clip from the middle at 60 fps and prints the largest vertex step between two
+* frames around the switch, without then with inertialization, and how long the latter takes
+* to settle back on the clip
+*/
+static void printTransitionCheck(Animation& animation, const FlatSkeleton& skeleton, unsigned int boneCount,
+    const std::vector<Vertex>& vertices, const glm::mat4& globalInverseTransform)
+{
+    const float step = 1.f / 60.f;
+    const float switchTime = 0.5f * animation.duration();
+    Inertializer transition(0.25f);
+    LocalPose local;
+    std::vector<glm::mat4> pose(boneCount, glm::mat4(1.f));
+    std::vector<glm::vec3> previous(vertices.size()), current(vertices.size()), plain(vertices.size());
+
+    double jump[2] = { 0.0, 0.0 };
+    float settled = 0.f;
+    for (int frame = -2; frame < 60; frame++) {
+        float time = frame < 0 ? switchTime + frame * step : frame * step;
+        if (frame == 0)
+            transition.start();
+        transition.advance(step);
+        sampleLocalPose(animation, skeleton, time, local);
+        getPoseFromLocal(local, skeleton, pose, globalInverseTransform);
+        skinLinear(pose, vertices, plain);
+        transition.apply(local);
+        getPoseFromLocal(local, skeleton, pose, globalInverseTransform);
+        skinLinear(pose, vertices, current);
+
+        if (frame >= 0 && frame < 2) {
+            for (unsigned int i = 0; i < vertices.size(); i++) {
+                if (frame == 0)
+                    jump[0] = std::max(jump[0], double(glm::distance(previous[i], plain[i])));
+                jump[1] = std::max(jump[1], double(glm::distance(previous[i], current[i])));
+            }
+        }
+        double offset = 0.0;
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            offset = std::max(offset, double(glm::distance(current[i], plain[i])));
+        if (frame >= 0 && offset > 1e-4 && !transition.active())
+            settled = -1.f; // Should not happen: the offset outlives the transition
+        else if (frame >= 0 && offset > 1e-4 && settled >= 0.f)
+            settled = (frame + 1) * step;
+        previous.swap(current);
+    }
+
+    std::cout << "  transition at " << switchTime << " s: largest vertex step " << jump[0] << " restarted, "
+        << jump[1] << " inertialized, ";
+    if (settled < 0.f)
+        std::cout << "offset left after the transition" << std::endl;
+    else
+        std::cout << "settled after " << settled << " s" << std::endl;
+}
+
+static bool checkModel(const std::string& file, unsigned int samples, bool gpu, std::ofstream& csv)
+{
+    Assimp::Importer importer;
+    std::string path = std::string(PROJECT_SOURCE_DIR) + "/assets/" + file;
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+        return false;
+    }
+
+    aiMesh* mesh = nullptr;
+    for (unsigned int i = 0; i < scene->mNumMeshes && !mesh; i++) {
+        if (scene->mMeshes[i]->HasBones())
+            mesh = scene->mMeshes[i];
+    }
+    if (!mesh || !scene->HasAnimations()) {
+        std::cout << file << ": no skinned mesh or animation" << std::endl;
+        return false;
+    }
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    unsigned int boneCount = 0;
+    Bone skeleton;
+    Animation animation;
+    loadModel(scene, mesh, vertices, indices, skeleton, boneCount);
+    loadAnimation(scene, skeleton, animation);
+
+    std::vector<std::string> boneNames(boneCount);
+    readBoneNames(skeleton, boneNames);
+
+    std::vector<AABB> boneBounds = computeBoneBounds(vertices, boneCount);
+    std::vector<std::vector<glm::dvec3>> probes;
+    for (const AABB& bounds : boneBounds)
+        probes.push_back(probePoints(bounds));
+
+    FlatSkeleton flatSkeleton;
+    flatSkeleton.build(skeleton);
+
+    AnimationLibrary library;
+    library.import(scene);
+
+    // Layers that all sample the clip at the same time, so that the blend has to give it back
+    BoneMask halfMask;
+    halfMask.build(flatSkeleton, 0.5f);
+    std::vector<BlendLayer> layers = {
+        { &animation, 0.f, 0.3f, nullptr, BlendMode::Blend },
+        { &animation, 0.f, 0.7f, nullptr, BlendMode::Blend },
+        { &animation, 0.f, 1.f, &halfMask, BlendMode::Override } };
+
+    LocalPose localPose;
+    BoneQuery query;
+
+    // The clip as deltas from its first frame, added back onto that frame: gives the clip back
+    ReferencePose firstFrame;
+    sampleReferencePose(animation, 0.f, firstFrame);
+    Animation additive = animation;
+    additive.makeAdditive(firstFrame);
+    std::vector<BlendLayer> additiveLayers = {
+        { &animation, 0.f, 1.f, nullptr, BlendMode::Blend },
+        { &additive, 0.f, 1.f, nullptr, BlendMode::Additive } };
+
+    SkeletonLOD skeletonLOD;
+    skeletonLOD.build(skeleton, boneCount, LOD_LEVELS);
+
+    GpuSkinning* gpuSkinning = nullptr;
+    if (gpu) {
+        gpuSkinning = new GpuSkinning(vertices);
+        if (!gpuSkinning->valid()) {
+            gpuSkinning->cleanUp();
+            delete gpuSkinning;
+            gpuSkinning = nullptr;
+        }
+    }
+
+    glm::mat4 identity(1.0f);
+    glm::mat4 globalInverseTransform = glm::inverse(assimpToGlmMatrix(scene->mRootNode->mTransformation));
+    glm::dmat4 globalInverseReference = glm::inverse(glm::dmat4(assimpToGlmMatrix(scene->mRootNode->mTransformation)));
+    glm::fdualquat identityQuat = glm::fdualquat(glm::quat(1.f, 0.f, 0.f, 0.f), glm::quat(0.f, 0.f, 0.f, 0.f));
+
+    std::vector<glm::dmat4> reference(boneCount), referenceRoot(boneCount);
+    std::vector<glm::ddualquat> referenceDual(boneCount);
+    std::vector<glm::dvec3> referenceLinear(vertices.size()), referenceBlend(vertices.size());
+    std::vector<glm::mat4> pose(boneCount, identity);
+    std::vector<glm::fdualquat> dualPose(boneCount, identityQuat);
+    std::vector<glm::mat4> dualPalette(boneCount);
+    std::vector<VertexCPU> verticesCPU(vertices.size());
+    std::vector<glm::vec3> positions(vertices.size()), cpuPositions(vertices.size()), gpuPositions;
+
+    // The sample is evaluated in the last lane, the others play the clip at other times
+    PoseGroup group;
+    group.build(flatSkeleton, globalInverseTransform);
+    std::vector<std::vector<glm::mat4>> groupPoses(group.width(), std::vector<glm::mat4>(boneCount, identity));
+    std::vector<std::vector<glm::mat4>*> groupOutputs;
+    for (std::vector<glm::mat4>& groupPose : groupPoses)
+        groupOutputs.push_back(&groupPose);
+    std::vector<Animation*> groupClips(group.width(), &animation);
+    std::vector<float> groupTimes(group.width());
+
+    std::vector<PathReport> reports;
+    reports.push_back(makeReport("matrix", boneCount, vertices.size()));
+    reports.push_back(makeReport("dual quat", boneCount, vertices.size()));
+    reports.push_back(makeReport("flat affine", boneCount, vertices.size()));
+    reports.push_back(makeReport("flat nlerp", boneCount, vertices.size()));
+    reports.push_back(makeReport("flat onlerp", boneCount, vertices.size()));
+    reports.push_back(makeReport("library clip", boneCount, vertices.size()));
+    reports.push_back(makeReport("blend same clip", boneCount, vertices.size()));
+    reports.push_back(makeReport("dual quat flat", boneCount, vertices.size()));
+    reports.push_back(makeReport("additive on ref", boneCount, vertices.size()));
+    reports.push_back(makeReport("bone query", boneCount, vertices.size()));
+    reports.push_back(makeReport("pose group", boneCount, vertices.size()));
+    for (unsigned int level = 1; level < skeletonLOD.levels(); level++)
+        reports.push_back(makeReport("matrix lod" + std::to_string(level), boneCount, vertices.size()));
+    if (gpuSkinning) {
+        reports.push_back(makeReport("gpu lbs", 0, vertices.size()));
+        reports.push_back(makeReport("gpu dual quat", 0, vertices.size()));
+        reports.push_back(makeReport("gpu lbs vs cpu", 0, vertices.size()));
+    }
+
+    for (unsigned int sample = 0; sample < samples; sample++) {
+        float time = animation.duration() * sample / samples;
+
+        getPoseReference(animation, skeleton, time, reference, glm::dmat4(1.0), globalInverseReference);
+        // getPoseDual leaves the root transform out, the DQ loop's model matrix makes up for it
+        getPoseReference(animation, skeleton, time, referenceRoot, glm::dmat4(1.0), glm::dmat4(1.0));
+        for (unsigned int bone = 0; bone < boneCount; bone++)
+            referenceDual[bone] = toDualQuat(referenceRoot[bone]);
+        for (unsigned int i = 0; i < vertices.size(); i++) {
+            const Vertex& vertex = vertices[i];
+            glm::dmat4 blend(0.0);
+            for (int k = 0; k < 4; k++)
+                blend += reference[vertex.boneIds[k]] * double(vertex.boneWeights[k]);
+            referenceLinear[i] = glm::dvec3(blend * glm::dvec4(glm::dvec3(vertex.position), 1.0));
+            referenceBlend[i] = skinDual(referenceDual, vertex);
+        }
+
+        // Matrix path: palette, then the CPU skinning matrices applied to the bind positions
+        getPose(animation, skeleton, time, pose, identity, globalInverseTransform);
+        comparePalette(pose, reference, probes, reports[0].bones);
+        getBoneTransform(pose, vertices, verticesCPU);
+        for (unsigned int i = 0; i < vertices.size(); i++) {
+            const VertexCPU& v = verticesCPU[i];
+            cpuPositions[i] = glm::vec3(glm::mat4(v.boneTr0, v.boneTr1, v.boneTr2, v.boneTr3) * glm::vec4(vertices[i].position, 1.0f));
+        }
+        compareVertices(cpuPositions, referenceLinear, reports[0].vertices);
+
+        if (gpuSkinning) {
+            gpuSkinning->skin(pose, gpuPositions);
+            compareVertices(gpuPositions, referenceLinear, reports[reports.size() - 3].vertices);
+            std::vector<glm::dvec3> cpuReference(cpuPositions.begin(), cpuPositions.end());
+            compareVertices(gpuPositions, cpuReference, reports[reports.size() - 1].vertices);
+        }
+
+        // Dual quaternion path: palette as the matrices the shader rebuilds, vertices with the DQ blend
+        getPoseDual(animation, skeleton, time, dualPose, identityQuat);
+        for (unsigned int bone = 0; bone < boneCount; bone++)
+            dualPalette[bone] = glm::transpose(glm::mat4(glm::mat3x4_cast(dualPose[bone])));
+        comparePalette(dualPalette, referenceRoot, probes, reports[1].bones);
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            positions[i] = skinDual(dualPose, vertices[i]);
+        compareVertices(positions, referenceBlend, reports[1].vertices);
+
+        if (gpuSkinning) {
+            gpuSkinning->skin(dualPose, gpuPositions);
+            compareVertices(gpuPositions, referenceBlend, reports[reports.size() - 2].vertices);
+        }
+
+        // Flattened hierarchy with the affine kernels
+        getPoseFlat(animation, flatSkeleton, time, pose, globalInverseTransform);
+        comparePalette(pose, reference, probes, reports[2].bones);
+        skinLinear(pose, vertices, positions);
+        compareVertices(positions, referenceLinear, reports[2].vertices);
+
+        // Same with the approximate rotation interpolations
+        const RotationInterpolation approximations[2] = { RotationInterpolation::Nlerp, RotationInterpolation::ONlerp };
+        for (unsigned int k = 0; k < 2; k++) {
+            animation.setInterpolation(approximations[k]);
+            getPoseFlat(animation, flatSkeleton, time, pose, globalInverseTransform);
+            comparePalette(pose, reference, probes, reports[3 + k].bones);
+            skinLinear(pose, vertices, positions);
+            compareVertices(positions, referenceLinear, reports[3 + k].vertices);
+        }
+        animation.resetInterpolation();
+
+        // Same clip after the quantization of the library
+        getPoseFlat(*library.get(0), flatSkeleton, time, pose, globalInverseTransform);
+        comparePalette(pose, reference, probes, reports[5].bones);
+        skinLinear(pose, vertices, positions);
+        compareVertices(positions, referenceLinear, reports[5].vertices);
+
+        for (BlendLayer& layer : layers)
+            layer.time = time;
+        getPoseBlended(layers, flatSkeleton, pose, globalInverseTransform, nullptr, RotationInterpolation::Slerp);
+        comparePalette(pose, reference, probes, reports[6].bones);
+        skinLinear(pose, vertices, positions);
+        compareVertices(positions, referenceLinear, reports[6].vertices);
+
+        // Dual quaternions from the local pose, as the DQ loop evaluates them
+        sampleLocalPose(animation, flatSkeleton, time, localPose);
+        getPoseDualFromLocal(localPose, flatSkeleton, dualPose);
+        for (unsigned int bone = 0; bone < boneCount; bone++)
+            dualPalette[bone] = glm::transpose(glm::mat4(glm::mat3x4_cast(dualPose[bone])));
+        comparePalette(dualPalette, referenceRoot, probes, reports[7].bones);
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            positions[i] = skinDual(dualPose, vertices[i]);
+        compareVertices(positions, referenceBlend, reports[7].vertices);
+
+        additiveLayers[1].time = time;
+        getPoseBlended(additiveLayers, flatSkeleton, pose, globalInverseTransform, nullptr, RotationInterpolation::Slerp);
+        comparePalette(pose, reference, probes, reports[8].bones);
+        skinLinear(pose, vertices, positions);
+        compareVertices(positions, referenceLinear, reports[8].vertices);
+
+        // Bones one at a time, each chain stopping at its memoized parent. In skeleton order, since
+        // entries that are not bones share palette slot 0 and the last one written wins in the other paths
+        query.begin(flatSkeleton, animation, time, globalInverseTransform);
+        for (unsigned int b = 0; b < flatSkeleton.size(); b++)
+            pose[flatSkeleton.id(b)] = affineToMat4(query.palette(b));
+        comparePalette(pose, reference, probes, reports[9].bones);
+        skinLinear(pose, vertices, positions);
+        compareVertices(positions, referenceLinear, reports[9].vertices);
+
+        for (unsigned int lane = 0; lane < group.width(); lane++)
+            groupTimes[lane] = lane + 1 == group.width() ? time
+                : animation.duration() * (sample + (lane + 1) * samples / group.width()) / samples;
+        group.evaluate(&groupClips[0], &groupTimes[0], group.width(), &groupOutputs[0]);
+        comparePalette(groupPoses.back(), reference, probes, reports[10].bones);
+        skinLinear(groupPoses.back(), vertices, positions);
+        compareVertices(positions, referenceLinear, reports[10].vertices);
+
+        // Skeleton LODs, measured against the full reference to show what each level costs
+        for (unsigned int level = 1; level < skeletonLOD.levels(); level++) {
+            PathReport& report = reports[10 + level];
+            getPose(animation, skeleton, time, pose, identity, globalInverseTransform, &skeletonLOD.kept(level));
+            skeletonLOD.applyRemap(level, pose);
+            comparePalette(pose, reference, probes, report.bones);
+            skinLinear(pose, vertices, positions);
+            compareVertices(positions, referenceLinear, report.vertices);
+        }
+    }
+
+    std::cout << file << ": " << vertices.size() << " vertices, " << boneCount << " bones, " << samples << " samples" << std::endl;
+    std::cout << "  path                 palette max    mean  worst bone       |  vertex max    mean  worst" << std::endl;
+    for (const PathReport& report : reports) {
+        printReport(report, boneNames);
+        if (csv.is_open())
+            writeCsv(csv, file, report);
+    }
+    printTransitionCheck(animation, flatSkeleton, boneCount, vertices, globalInverseTransform);
+
+    if (gpuSkinning) {
+        gpuSkinning->cleanUp();
+        delete gpuSkinning;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int samples = 256;
+    bool gpu = false;
+    std::string csvPath;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--samples" && i + 1 < argc)
+            samples = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--gpu")
+            gpu = true;
+        else if (arg == "--csv" && i + 1 < argc)
+            csvPath = argv[++i];
+        else
+            files.push_back(arg);
+    }
+    if (files.empty())
+        files = { "model.dae", "astroboy.dae" };
+
+    std::ofstream csv;
+    if (!csvPath.empty()) {
+        csv.open(csvPath);
+        csv << "file,path,kind,index,max,mean\n";
+    }
+
+    if (gpu && !createHeadlessContext(4, 3))
+        return EXIT_FAILURE;
+
+    printInterpolationBounds();
+
+    bool success = true;
+    for (const std::string& file : files)
+        success &= checkModel(file, samples, gpu, csv);
+
+    if (gpu)
+        destroyHeadlessContext();
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
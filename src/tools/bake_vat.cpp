@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include "animation.h"
+#include "animation_library.h"
+#include "bone.h"
+#include "flat_skeleton.h"
+#include "importer.h"
+#include "job_system.h"
+#include "pose.h"
+#include "skinning.h"
+#include "vertex_animation.h"
+
+/*
+* Bakes clips into vertex animation textures for the far crowd LOD (Animation --mode vat --vat file),
+* then reports the size and the error of the playback against CPU skinning.
+* Usage: BakeVAT [--rate hz] [--clip name|index] [--threads count] [model relative to assets/] [output.vat]
+* Without --clip every clip of the model is baked, to output_<index>.vat when there are several.
+* Import and bake run on a job system, one thread per hardware thread unless --threads is given
+*/
+
+static aiMesh* findSkinnedMesh(const aiScene* scene)
+{
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        if (scene->mMeshes[i]->HasBones())
+            return scene->mMeshes[i];
+    }
+    return nullptr;
+}
+
+/*
+* Largest position (model units) and normal (degrees) error of the playback at the given fraction
+* of every frame interval: 0 shows the quantization alone, 0.5 adds the blend between frames
+*/
+static void measureError(Animation& animation, const FlatSkeleton& skeleton, const std::vector<Vertex>& vertices,
+    unsigned int boneCount, const glm::mat4& globalInverseTransform, const VertexAnimation& vat, float phase,
+    double& positionError, double& normalError)
+{
+    std::vector<glm::mat4> pose(boneCount, glm::mat4(1.f));
+    std::vector<VertexCPU> skinned(vertices.size());
+    positionError = normalError = 0.0;
+    for (unsigned int frame = 0; frame < vat.frameCount(); frame++) {
+        if (frame + 1 == vat.frameCount() && phase > 0.f)
+            break;
+        float time = glm::mix(vat.frameTime(frame), vat.frameTime(std::min(frame + 1, vat.frameCount() - 1)), phase);
+        getPoseFlat(animation, skeleton, time, pose, globalInverseTransform);
+        getBoneTransform(pose, vertices, skinned);
+
+        unsigned int first, second;
+        float blend;
+        vat.frames(time, first, second, blend);
+        for (unsigned int i = 0; i < vertices.size(); i++) {
+            const VertexCPU& v = skinned[i];
+            glm::mat4 skinning(v.boneTr0, v.boneTr1, v.boneTr2, v.boneTr3);
+            glm::vec3 position(skinning * glm::vec4(vertices[i].position, 1.f));
+            glm::vec3 normal = glm::normalize(glm::transpose(glm::inverse(glm::mat3(skinning))) * vertices[i].normal);
+
+            glm::vec3 played = glm::mix(vat.position(first, i), vat.position(second, i), blend);
+            glm::vec3 playedNormal = glm::normalize(glm::mix(vat.normal(first, i), vat.normal(second, i), blend));
+            positionError = std::max(positionError, double(glm::distance(position, played)));
+            float cosAngle = std::min(std::max(glm::dot(normal, playedNormal), -1.f), 1.f);
+            normalError = std::max(normalError, double(glm::degrees(std::acos(cosAngle))));
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    float frameRate = 30.f;
+    unsigned int threads = 0;
+    std::string clipName;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--rate" && i + 1 < argc)
+            frameRate = std::max(1.f, float(std::atof(argv[++i])));
+        else if (arg == "--clip" && i + 1 < argc)
+            clipName = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = unsigned(std::max(1, std::atoi(argv[++i])));
+        else
+            files.push_back(arg);
+    }
+    std::string file = files.size() > 0 ? files[0] : "model.dae";
+    std::string output = files.size() > 1 ? files[1] : file.substr(0, file.rfind('.')) + ".vat";
+
+    Assimp::Importer importer;
+    std::string path = std::string(PROJECT_SOURCE_DIR) + "/assets/" + file;
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+        return EXIT_FAILURE;
+    }
+    aiMesh* mesh = findSkinnedMesh(scene);
+    if (!mesh || !scene->HasAnimations()) {
+        std::cout << file << ": no skinned mesh or animation" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    unsigned int boneCount = 0;
+    Bone skeleton;
+    loadModel(scene, mesh, vertices, indices, skeleton, boneCount);
+    FlatSkeleton flatSkeleton;
+    flatSkeleton.build(skeleton);
+    glm::mat4 globalInverseTransform = glm::inverse(assimpToGlmMatrix(scene->mRootNode->mTransformation));
+
+    JobSystem jobs(threads);
+    AnimationLibrary library;
+    library.import(scene, &jobs);
+    std::vector<unsigned int> clips;
+    if (clipName.empty()) {
+        for (unsigned int clip = 0; clip < library.size(); clip++)
+            clips.push_back(clip);
+    }
+    else {
+        int clip = library.find(clipName);
+        if (clip < 0 && clipName.find_first_not_of("0123456789") == std::string::npos)
+            clip = std::atoi(clipName.c_str());
+        if (clip < 0 || clip >= int(library.size())) {
+            std::cout << "Unknown clip " << clipName << std::endl;
+            return EXIT_FAILURE;
+        }
+        clips.push_back(unsigned(clip));
+    }
+
+    std::cout << std::fixed << std::setprecision(4);
+    for (unsigned int clip : clips) {
+        std::string target = output;
+        if (clips.size() > 1)
+            target = output.substr(0, output.rfind('.')) + "_" + std::to_string(clip) + ".vat";
+
+        Animation& animation = *library.get(clip);
+        VertexAnimation vat;
+        vat.bake(animation, flatSkeleton, vertices, boneCount, globalInverseTransform, frameRate, &jobs);
+        if (!vat.save(target))
+            return EXIT_FAILURE;
+
+        std::cout << target << ": clip " << clip << " (" << library.name(clip) << "), " << vat.vertexCount() << " vertices, "
+            << vat.frameCount() << " frames at " << vat.frameRate() << " Hz, " << vat.bytes() / 1024.0 << " KB" << std::endl;
+        const float phases[2] = { 0.f, 0.5f };
+        const char* labels[2] = { "  on frames      ", "  between frames " };
+        for (int p = 0; p < 2; p++) {
+            double positionError, normalError;
+            measureError(animation, flatSkeleton, vertices, boneCount, globalInverseTransform, vat, phases[p],
+                positionError, normalError);
+            std::cout << labels[p] << "max error " << positionError << " position, " << normalError << " deg normal" << std::endl;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,483 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include "animation.h"
+#include "animation_library.h"
+#include "bone.h"
+#include "bone_query.h"
+#include "flat_skeleton.h"
+#include "importer.h"
+#include "inertialization.h"
+#include "job_system.h"
+#include "pose.h"
+#include "pose_blend.h"
+#include "pose_cache.h"
+#include "pose_group.h"
+#include "simd_math.h"
+#include "skinning.h"
+
+/*
+* Headless benchmark of the animation core: load time, pose evaluation and CPU skinning.
+* Usage: Benchmark [iterations] [--threads count] [model files relative to assets/...]
+* The job crowd is measured from 1 thread to --threads, one per hardware thread by default
+*/
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double elapsedNs(Clock::time_point start)
+{
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+static aiMesh* findSkinnedMesh(const aiScene* scene)
+{
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        if (scene->mMeshes[i]->HasBones())
+            return scene->mMeshes[i];
+    }
+    return nullptr;
+}
+
+struct CrowdResult
+{
+    double directNs;
+    double cachedNs;
+    float hitRate;
+};
+
+/*
+* 256 instances of the clip for a number of 60 Hz frames, phases from the given groups plus
+* jitter, evaluated directly then through a PoseCache. Times are per instance and frame
+*/
+static CrowdResult benchmarkCrowd(Animation& animation, const FlatSkeleton& skeleton, unsigned int boneCount,
+    const glm::mat4& globalInverseTransform, unsigned int groups, float jitter, unsigned int frames)
+{
+    const unsigned int instances = 256;
+    std::vector<float> phases(instances);
+    srand(7);
+    for (unsigned int i = 0; i < instances; i++)
+        phases[i] = animation.duration() * (i % groups) / groups + jitter * (float(rand()) / RAND_MAX - 0.5f);
+
+    std::vector<glm::mat4> pose(boneCount, glm::mat4(1.f));
+    PoseCache::PoseSampler samplePose = [&](float time, std::vector<glm::mat4>& palette) {
+        getPoseFlat(animation, skeleton, time, palette, globalInverseTransform);
+    };
+    CrowdResult result;
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        for (unsigned int i = 0; i < instances; i++)
+            getPoseFlat(animation, skeleton, std::fmod(phases[i] + frame / 60.f + animation.duration(), animation.duration()),
+                pose, globalInverseTransform);
+    }
+    result.directNs = elapsedNs(start) / (double(frames) * instances);
+
+    PoseCache cache;
+    float checksum = 0.f;
+    start = Clock::now();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        cache.beginFrame();
+        for (unsigned int i = 0; i < instances; i++) {
+            float time = std::fmod(phases[i] + frame / 60.f + animation.duration(), animation.duration());
+            checksum += cache.get(0, time, 0, boneCount, samplePose)[0][3][0];
+        }
+    }
+    result.cachedNs = elapsedNs(start) / (double(frames) * instances) + checksum * 0.f;
+    result.hitRate = cache.hitRate();
+    return result;
+}
+
+/*
+* The scattered crowd of benchmarkCrowd, evaluated width characters at a time by a PoseGroup
+*/
+static double benchmarkLaneCrowd(Animation& animation, const FlatSkeleton& skeleton, unsigned int boneCount,
+    const glm::mat4& globalInverseTransform, unsigned int width, unsigned int frames)
+{
+    const unsigned int instances = 256;
+    PoseGroup group;
+    group.build(skeleton, globalInverseTransform, width);
+    std::vector<std::vector<glm::mat4>> poses(instances, std::vector<glm::mat4>(boneCount, glm::mat4(1.f)));
+    std::vector<std::vector<glm::mat4>*> outputs;
+    for (std::vector<glm::mat4>& pose : poses)
+        outputs.push_back(&pose);
+    std::vector<Animation*> clips(instances, &animation);
+    std::vector<float> times(instances);
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        for (unsigned int i = 0; i < instances; i++)
+            times[i] = std::fmod(animation.duration() * i / instances + frame / 60.f + animation.duration(), animation.duration());
+        group.evaluate(&clips[0], &times[0], instances, &outputs[0]);
+    }
+    return elapsedNs(start) / (double(frames) * instances);
+}
+
+/*
+* One character of the job crowd and what it shares with the others. Each stage is a job
+* reading the output of the previous one
+*/
+struct CrowdScene
+{
+    Animation* animation;
+    Animation* additive;
+    const FlatSkeleton* skeleton;
+    const std::vector<Vertex>* vertices;
+    glm::mat4 globalInverseTransform;
+    std::vector<float> additiveWeights;
+};
+
+struct CrowdCharacter
+{
+    const CrowdScene* scene;
+    float time;
+    LocalPose pose;
+    LocalPose layer;
+    std::vector<glm::mat4> palette;
+    std::vector<VertexCPU> skinned;
+};
+
+// Vertices per skinning job, larger meshes are split over several threads
+static const unsigned int SKINNING_GRAIN = 1024;
+
+static void sampleStage(void* data, unsigned int, unsigned int)
+{
+    CrowdCharacter& character = *static_cast<CrowdCharacter*>(data);
+    const CrowdScene& scene = *character.scene;
+    sampleLocalPose(*scene.animation, *scene.skeleton, character.time, character.pose);
+    sampleLocalPose(*scene.additive, *scene.skeleton, character.time * 0.5f, character.layer);
+}
+
+static void blendStage(void* data, unsigned int, unsigned int)
+{
+    CrowdCharacter& character = *static_cast<CrowdCharacter*>(data);
+    addLocalPose(character.pose, character.layer, &character.scene->additiveWeights[0], character.pose);
+}
+
+static void hierarchyStage(void* data, unsigned int, unsigned int)
+{
+    CrowdCharacter& character = *static_cast<CrowdCharacter*>(data);
+    const CrowdScene& scene = *character.scene;
+    getPoseFromLocal(character.pose, *scene.skeleton, character.palette, scene.globalInverseTransform);
+}
+
+static void skinningStage(void* data, unsigned int begin, unsigned int end)
+{
+    CrowdCharacter& character = *static_cast<CrowdCharacter*>(data);
+    getBoneTransform(character.palette, *character.scene->vertices, character.skinned, begin, end);
+}
+
+/*
+* 256 characters with a base clip, an additive layer and CPU skinning, each frame one job graph:
+* sample, blend, hierarchy then skinning per character, the characters independent of each other.
+* Returns the time per character and frame, and a checksum of the skinned vertices
+*/
+static double benchmarkJobCrowd(CrowdScene& scene, unsigned int boneCount, unsigned int threads, unsigned int frames,
+    double& checksum)
+{
+    const unsigned int count = 256;
+    const unsigned int vertexCount = (unsigned int)scene.vertices->size();
+    std::vector<CrowdCharacter> characters(count);
+    for (unsigned int i = 0; i < count; i++) {
+        characters[i].scene = &scene;
+        characters[i].palette.assign(boneCount, glm::mat4(1.f));
+        characters[i].skinned.resize(vertexCount);
+    }
+
+    JobSystem jobs(threads);
+    Clock::time_point start;
+    for (unsigned int frame = 0; frame <= frames; frame++) {
+        // The first frame grows the per-thread scratch and is not measured
+        if (frame == 1)
+            start = Clock::now();
+
+        JobSystem::Job* root = jobs.create(nullptr, nullptr);
+        for (unsigned int i = 0; i < count; i++) {
+            CrowdCharacter& character = characters[i];
+            character.time = std::fmod(scene.animation->duration() * i / count + frame / 60.f, scene.animation->duration());
+            JobSystem::Job* sample = jobs.create(&sampleStage, &character, 0, 1, 0, root);
+            JobSystem::Job* blend = jobs.create(&blendStage, &character, 0, 1, 0, root);
+            JobSystem::Job* hierarchy = jobs.create(&hierarchyStage, &character, 0, 1, 0, root);
+            JobSystem::Job* skinning = jobs.create(&skinningStage, &character, 0, vertexCount, SKINNING_GRAIN, root);
+            jobs.then(sample, blend);
+            jobs.then(blend, hierarchy);
+            jobs.then(hierarchy, skinning);
+            jobs.run(sample);
+        }
+        jobs.run(root);
+        jobs.wait(root);
+    }
+    double ns = elapsedNs(start) / (double(frames) * count);
+
+    checksum = 0.0;
+    for (const CrowdCharacter& character : characters) {
+        for (unsigned int v = 0; v < vertexCount; v += 97)
+            checksum += character.skinned[v].boneTr3.x + character.skinned[v].boneTr0.y;
+    }
+    return ns;
+}
+
+static bool benchmarkModel(const std::string& file, unsigned int iterations, unsigned int maxThreads)
+{
+    Clock::time_point loadStart = Clock::now();
+
+    Assimp::Importer importer;
+    std::string path = std::string(PROJECT_SOURCE_DIR) + "/assets/" + file;
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+        return false;
+    }
+
+    aiMesh* mesh = findSkinnedMesh(scene);
+    if (!mesh || !scene->HasAnimations()) {
+        std::cout << file << ": no skinned mesh or animation" << std::endl;
+        return false;
+    }
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    unsigned int boneCount = 0;
+    Bone skeleton;
+    Animation animation;
+    loadModel(scene, mesh, vertices, indices, skeleton, boneCount);
+    loadAnimation(scene, skeleton, animation);
+
+    double loadMs = elapsedNs(loadStart) / 1e6;
+
+    // Every clip of the file quantized, then decoded back one after the other
+    Clock::time_point start = Clock::now();
+    AnimationLibrary library;
+    library.import(scene);
+    double importMs = elapsedNs(start) / 1e6;
+    start = Clock::now();
+    for (unsigned int clip = 0; clip < library.size(); clip++)
+        library.get(clip);
+    double decodeUs = elapsedNs(start) / (1e3 * library.size());
+
+    glm::mat4 identity(1.0f);
+    glm::mat4 globalInverseTransform = glm::inverse(assimpToGlmMatrix(scene->mRootNode->mTransformation));
+    glm::fdualquat identityQuat = glm::fdualquat(glm::quat(1.f, 0.f, 0.f, 0.f), glm::quat(0.f, 0.f, 0.f, 0.f));
+
+    std::vector<glm::mat4> pose(boneCount, identity);
+    std::vector<glm::fdualquat> dualPose(boneCount, identityQuat);
+    std::vector<VertexCPU> verticesCPU(vertices.size());
+
+    // Sample times are spread over the clip so that every key interval is visited
+    start = Clock::now();
+    for (unsigned int i = 0; i < iterations; i++)
+        getPose(animation, skeleton, animation.duration() * i / iterations, pose, identity, globalInverseTransform);
+    double poseNs = elapsedNs(start) / (double(iterations) * boneCount);
+
+    FlatSkeleton flatSkeleton;
+    flatSkeleton.build(skeleton);
+    const RotationInterpolation modes[3] = { RotationInterpolation::Slerp, RotationInterpolation::Nlerp, RotationInterpolation::ONlerp };
+    double flatPoseNs[3];
+    for (unsigned int m = 0; m < 3; m++) {
+        animation.setInterpolation(modes[m]);
+        start = Clock::now();
+        for (unsigned int i = 0; i < iterations; i++)
+            getPoseFlat(animation, flatSkeleton, animation.duration() * i / iterations, pose, globalInverseTransform);
+        flatPoseNs[m] = elapsedNs(start) / (double(iterations) * boneCount);
+    }
+    animation.resetInterpolation();
+
+    // Two clips mixed, then an upper body override and an additive layer, with one hierarchy pass.
+    // The clip stands in for all of them, only the cost is measured
+    BoneMask upperBody;
+    upperBody.build(flatSkeleton, 0.f);
+    for (unsigned int i = flatSkeleton.size() / 2; i < flatSkeleton.size(); i++)
+        upperBody.set(i, 1.f);
+    std::vector<BlendLayer> layers = {
+        { &animation, 0.f, 0.6f, nullptr, BlendMode::Blend },
+        { &animation, 0.f, 0.4f, nullptr, BlendMode::Blend },
+        { &animation, 0.f, 1.f, &upperBody, BlendMode::Override },
+        { &animation, 0.f, 0.5f, nullptr, BlendMode::Additive } };
+    double blendNs[2];
+    for (unsigned int layerCount = 2; layerCount <= 4; layerCount += 2) {
+        std::vector<BlendLayer> used(layers.begin(), layers.begin() + layerCount);
+        start = Clock::now();
+        for (unsigned int i = 0; i < iterations; i++) {
+            for (unsigned int layer = 0; layer < layerCount; layer++)
+                used[layer].time = animation.duration() * ((i + layer * iterations / layerCount) % iterations) / iterations;
+            getPoseBlended(used, flatSkeleton, pose, globalInverseTransform);
+        }
+        blendNs[layerCount / 2 - 1] = elapsedNs(start) / (double(iterations) * boneCount);
+    }
+
+    // One bone at the end of the longest chain, as a socket query would ask, then every bone
+    // through the same query to show what the memoization saves over separate chains
+    unsigned int deepest = 0, deepestDepth = 0;
+    for (unsigned int b = 0; b < flatSkeleton.size(); b++) {
+        unsigned int depth = 0;
+        for (int p = flatSkeleton.parent(b); p >= 0; p = flatSkeleton.parent(p))
+            depth++;
+        if (depth >= deepestDepth) {
+            deepest = b;
+            deepestDepth = depth;
+        }
+    }
+    BoneQuery query;
+    glm::mat4x3 socket(1.f);
+    start = Clock::now();
+    for (unsigned int i = 0; i < iterations; i++) {
+        query.begin(flatSkeleton, animation, animation.duration() * i / iterations, globalInverseTransform);
+        socket += query.global(deepest);
+    }
+    double queryNs = elapsedNs(start) / iterations;
+    start = Clock::now();
+    for (unsigned int i = 0; i < iterations; i++) {
+        query.begin(flatSkeleton, animation, animation.duration() * i / iterations, globalInverseTransform);
+        for (unsigned int b = 0; b < flatSkeleton.size(); b++)
+            socket += query.global(b);
+    }
+    double queryAllNs = elapsedNs(start) / (double(iterations) * boneCount);
+
+    // Same phase, a few phase groups within a millisecond, and no shared phase at all
+    const unsigned int crowdFrames = std::max(1u, iterations / 50);
+    CrowdResult crowds[3] = {
+        benchmarkCrowd(animation, flatSkeleton, boneCount, globalInverseTransform, 1, 0.f, crowdFrames),
+        benchmarkCrowd(animation, flatSkeleton, boneCount, globalInverseTransform, 16, 0.002f, crowdFrames),
+        benchmarkCrowd(animation, flatSkeleton, boneCount, globalInverseTransform, 256, 0.f, crowdFrames) };
+    const char* crowdNames[3] = { "marching", "idle", "scattered" };
+    const unsigned int laneWidths[2] = { 4, 8 };
+    double laneCrowdNs[2];
+    for (unsigned int w = 0; w < 2; w++)
+        laneCrowdNs[w] = benchmarkLaneCrowd(animation, flatSkeleton, boneCount, globalInverseTransform, laneWidths[w], crowdFrames);
+
+    // Base clip with an additive layer, made against the first frame of the clip
+    ReferencePose referencePose;
+    sampleReferencePose(animation, 0.f, referencePose);
+    Animation additive = animation;
+    additive.makeAdditive(referencePose);
+    std::vector<BlendLayer> additiveLayers = {
+        { &animation, 0.f, 1.f, nullptr, BlendMode::Blend },
+        { &additive, 0.f, 0.5f, nullptr, BlendMode::Additive } };
+    start = Clock::now();
+    for (unsigned int i = 0; i < iterations; i++) {
+        additiveLayers[0].time = animation.duration() * i / iterations;
+        additiveLayers[1].time = animation.duration() * ((i * 3) % iterations) / iterations;
+        getPoseBlended(additiveLayers, flatSkeleton, pose, globalInverseTransform);
+    }
+    double additiveNs = elapsedNs(start) / (double(iterations) * boneCount);
+
+    // Transitions in the inertialized form: a switch every 15 frames to another phase of the clip,
+    // the new clip alone is sampled and the previous pose eases into it. Compared to blend 2,
+    // what a crossfade would cost on those frames
+    Inertializer transition(0.25f);
+    LocalPose local;
+    start = Clock::now();
+    for (unsigned int i = 0; i < iterations; i++) {
+        if (i % 15 == 0)
+            transition.start();
+        transition.advance(1.f / 60.f);
+        sampleLocalPose(animation, flatSkeleton, animation.duration() * ((i * 7) % iterations) / iterations, local);
+        transition.apply(local);
+        getPoseFromLocal(local, flatSkeleton, pose, globalInverseTransform);
+    }
+    double inertializedNs = elapsedNs(start) / (double(iterations) * boneCount);
+
+    // The same crowd frame on more and more threads, results must not depend on the count
+    CrowdScene crowdScene = { &animation, &additive, &flatSkeleton, &vertices, globalInverseTransform,
+        std::vector<float>(flatSkeleton.size() + 4, 0.5f) };
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+    std::vector<double> jobCrowdNs(threadCounts.size());
+    std::vector<bool> jobCrowdMatch(threadCounts.size(), true);
+    double referenceChecksum = 0.0;
+    for (unsigned int t = 0; t < threadCounts.size(); t++) {
+        double crowdChecksum;
+        jobCrowdNs[t] = benchmarkJobCrowd(crowdScene, boneCount, threadCounts[t], std::max(2u, iterations / 200), crowdChecksum);
+        if (t == 0)
+            referenceChecksum = crowdChecksum;
+        jobCrowdMatch[t] = crowdChecksum == referenceChecksum;
+    }
+
+    start = Clock::now();
+    for (unsigned int i = 0; i < iterations; i++)
+        getPoseDual(animation, skeleton, animation.duration() * i / iterations, dualPose, identityQuat);
+    double dualPoseNs = elapsedNs(start) / (double(iterations) * boneCount);
+
+    start = Clock::now();
+    for (unsigned int i = 0; i < iterations; i++)
+        getBoneTransform(pose, vertices, verticesCPU);
+    double skinningNs = elapsedNs(start) / (double(iterations) * vertices.size());
+
+    // Keeps the results alive
+    float checksum = pose[boneCount - 1][3][0] + socket[3][0] * 1e-6f + dualPose[boneCount - 1].real.w + verticesCPU.back().boneTr3.x;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << file << ": " << vertices.size() << " vertices, " << boneCount << " bones" << std::endl;
+    std::cout << "  load              " << std::setw(10) << loadMs << " ms" << std::endl;
+    std::cout << "  library           " << std::setw(10) << library.size() << " clips, " << library.encodedBytes() / 1024.0
+        << " KB quantized, " << library.decodedBytes() / 1024.0 << " KB decoded" << std::endl;
+    std::cout << "  library import    " << std::setw(10) << importMs << " ms" << std::endl;
+    std::cout << "  clip decode       " << std::setw(10) << decodeUs << " us/clip" << std::endl;
+    std::cout << "  pose (matrix)     " << std::setw(10) << poseNs << " ns/bone" << std::endl;
+    for (unsigned int m = 0; m < 3; m++) {
+        std::string label = std::string("pose (flat ") + rotationInterpolationName(modes[m]) + ")";
+        std::cout << "  " << std::left << std::setw(18) << label << std::right << std::setw(10) << flatPoseNs[m] << " ns/bone" << std::endl;
+    }
+    std::cout << "  pose (blend 2)    " << std::setw(10) << blendNs[0] << " ns/bone" << std::endl;
+    std::cout << "  pose (blend 4)    " << std::setw(10) << blendNs[1] << " ns/bone" << std::endl;
+    std::cout << "  query (1 bone)    " << std::setw(10) << queryNs << " ns, chain of " << deepestDepth + 1 << " bones" << std::endl;
+    std::cout << "  query (all bones) " << std::setw(10) << queryAllNs << " ns/bone" << std::endl;
+    std::cout << "  pose (additive)   " << std::setw(10) << additiveNs << " ns/bone" << std::endl;
+    std::cout << "  pose (inertialized)" << std::setw(9) << inertializedNs << " ns/bone" << std::endl;
+    for (unsigned int c = 0; c < 3; c++) {
+        std::string label = std::string("crowd (") + crowdNames[c] + ")";
+        std::cout << "  " << std::left << std::setw(18) << label << std::right << std::setw(10) << crowds[c].directNs
+            << " ns/instance, " << crowds[c].cachedNs << " cached, " << 100.f * crowds[c].hitRate << "% hits" << std::endl;
+    }
+    for (unsigned int w = 0; w < 2; w++) {
+        std::string label = "crowd (lanes " + std::to_string(laneWidths[w]) + ")";
+        std::cout << "  " << std::left << std::setw(18) << label << std::right << std::setw(10) << laneCrowdNs[w]
+            << " ns/instance, " << crowds[2].directNs / laneCrowdNs[w] << "x scattered" << std::endl;
+    }
+    for (unsigned int t = 0; t < threadCounts.size(); t++) {
+        std::string label = "crowd jobs (" + std::to_string(threadCounts[t]) + ")";
+        std::cout << "  " << std::left << std::setw(18) << label << std::right << std::setw(10) << jobCrowdNs[t] / 1e3
+            << " us/character, " << jobCrowdNs[0] / jobCrowdNs[t] << "x" << (jobCrowdMatch[t] ? "" : ", RESULTS DIFFER") << std::endl;
+    }
+    std::cout << "  pose (dual quat)  " << std::setw(10) << dualPoseNs << " ns/bone" << std::endl;
+    std::cout << "  skinning (CPU)    " << std::setw(10) << skinningNs << " ns/vertex" << std::endl;
+    std::cout << "  checksum          " << std::setw(10) << checksum << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int iterations = 1000;
+    unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc)
+            maxThreads = unsigned(std::max(1, std::atoi(argv[++i])));
+        else if (i == 1 && arg.find_first_not_of("0123456789") == std::string::npos)
+            iterations = std::max(1, std::atoi(argv[i]));
+        else
+            files.push_back(arg);
+    }
+    if (files.empty())
+        files = { "model.dae", "astroboy.dae" };
+
+    std::cout << "SIMD level: " << simdLevelName(simdLevel()) << std::endl;
+    bool success = true;
+    for (const std::string& file : files)
+        success &= benchmarkModel(file, iterations, maxThreads);
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
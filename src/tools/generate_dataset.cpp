@@ -0,0 +1,365 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#ifdef _WIN32
+#include <direct.h>
+#define MAKE_DIR(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define MAKE_DIR(path) mkdir(path, 0755)
+#endif
+
+#include <assimp/Exporter.hpp>
+#include <assimp/material.h>
+#include <assimp/scene.h>
+
+/*
+* Procedural skinned assets to find where each backend stops scaling: a bone tree of
+* configurable size, depth and branching, triangles scattered along the bones, skinned
+* to a bone and its ancestors, and looping clips with the requested key density.
+* Output is written through the Assimp exporter, so the importer loads it like any asset.
+* Usage: GenerateDataset [--bones N] [--depth N] [--branching N] [--vertices N] [--influences 1-4]
+*                        [--duration seconds] [--key-rate keys/s] [--clips N] [--seed N]
+*                        [--format assbin|collada] [--output file]
+* The default output is assets/generated/<parameters>.<format extension>
+*/
+
+struct DatasetOptions
+{
+    unsigned int bones = 64;
+    unsigned int depth = 8;
+    unsigned int branching = 2;
+    unsigned int vertices = 10000;
+    unsigned int influences = 4;
+    float duration = 4.f;
+    float keyRate = 30.f;
+    unsigned int clips = 1;
+    unsigned int seed = 1;
+    std::string format = "assbin";
+    std::string output;
+};
+
+struct SkeletonLayout
+{
+    std::vector<int> parents;
+    std::vector<glm::vec3> localTranslations;
+    std::vector<glm::mat4> globalBind;
+};
+
+static aiMatrix4x4 glmToAssimpMatrix(const glm::mat4& m)
+{
+    return aiMatrix4x4(m[0][0], m[1][0], m[2][0], m[3][0],
+                       m[0][1], m[1][1], m[2][1], m[3][1],
+                       m[0][2], m[1][2], m[2][2], m[3][2],
+                       m[0][3], m[1][3], m[2][3], m[3][3]);
+}
+
+static std::string boneName(unsigned int bone)
+{
+    return "Bone" + std::to_string(bone);
+}
+
+/*
+* Breadth-first tree: every bone takes up to `branching` children while the depth allows it,
+* parents are visited again with more children once the depth limit is reached everywhere
+*/
+static SkeletonLayout buildSkeleton(const DatasetOptions& options, std::mt19937& rng)
+{
+    SkeletonLayout layout;
+    std::vector<unsigned int> depths(1, 0), childCounts(1, 0);
+    std::vector<unsigned int> open(1, 0);
+    layout.parents.push_back(-1);
+
+    unsigned int cursor = 0, allowedChildren = options.branching;
+    for (unsigned int bone = 1; bone < options.bones; bone++) {
+        while (childCounts[open[cursor]] >= allowedChildren) {
+            if (++cursor == open.size()) {
+                cursor = 0;
+                allowedChildren += options.branching;
+            }
+        }
+        unsigned int parent = open[cursor];
+        childCounts[parent]++;
+        layout.parents.push_back(parent);
+        depths.push_back(depths[parent] + 1);
+        childCounts.push_back(0);
+        if (depths.back() + 1 < options.depth)
+            open.push_back(bone);
+    }
+
+    // Children fan out around their parent's direction, segments shorten with depth
+    std::uniform_real_distribution<float> spread(-0.6f, 0.6f);
+    layout.globalBind.resize(options.bones);
+    for (unsigned int bone = 0; bone < options.bones; bone++) {
+        glm::vec3 translation(0.f);
+        if (layout.parents[bone] >= 0) {
+            float length = 2.f / (1.f + 0.25f * depths[bone]);
+            translation = glm::normalize(glm::vec3(spread(rng), 1.f, spread(rng))) * length;
+        }
+        layout.localTranslations.push_back(translation);
+
+        glm::mat4 local = glm::mat4(1.f);
+        local[3] = glm::vec4(translation, 1.f);
+        layout.globalBind[bone] = layout.parents[bone] >= 0 ? layout.globalBind[layout.parents[bone]] * local : local;
+    }
+    return layout;
+}
+
+static aiNode* buildNodes(const SkeletonLayout& layout, unsigned int bone, aiNode* parent)
+{
+    aiNode* node = new aiNode(boneName(bone));
+    node->mParent = parent;
+    glm::mat4 local(1.f);
+    local[3] = glm::vec4(layout.localTranslations[bone], 1.f);
+    node->mTransformation = glmToAssimpMatrix(local);
+
+    std::vector<unsigned int> children;
+    for (unsigned int child = 0; child < layout.parents.size(); child++) {
+        if (layout.parents[child] == int(bone))
+            children.push_back(child);
+    }
+    if (!children.empty()) {
+        node->mNumChildren = (unsigned int)children.size();
+        node->mChildren = new aiNode*[children.size()];
+        for (unsigned int i = 0; i < children.size(); i++)
+            node->mChildren[i] = buildNodes(layout, children[i], node);
+    }
+    return node;
+}
+
+/*
+* Small triangles along each bone's segment, each skinned to its bone and the closest ancestors
+*/
+static aiMesh* buildMesh(const DatasetOptions& options, const SkeletonLayout& layout, std::mt19937& rng)
+{
+    unsigned int triangleCount = (options.vertices + 2) / 3;
+    unsigned int vertexCount = triangleCount * 3;
+
+    aiMesh* mesh = new aiMesh();
+    mesh->mName = "SyntheticMesh";
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    mesh->mMaterialIndex = 0;
+    mesh->mNumVertices = vertexCount;
+    mesh->mVertices = new aiVector3D[vertexCount];
+    mesh->mNormals = new aiVector3D[vertexCount];
+    mesh->mTextureCoords[0] = new aiVector3D[vertexCount];
+    mesh->mNumUVComponents[0] = 2;
+    mesh->mNumFaces = triangleCount;
+    mesh->mFaces = new aiFace[triangleCount];
+
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::uniform_real_distribution<float> jitter(-0.15f, 0.15f);
+    std::vector<std::vector<aiVertexWeight>> weights(options.bones);
+
+    for (unsigned int triangle = 0; triangle < triangleCount; triangle++) {
+        unsigned int bone = triangle % options.bones;
+        glm::vec3 start = glm::vec3(layout.globalBind[bone][3]);
+        glm::vec3 end = layout.parents[bone] >= 0 ? glm::vec3(layout.globalBind[layout.parents[bone]][3]) : start + glm::vec3(0.f, -0.5f, 0.f);
+        glm::vec3 center = glm::mix(start, end, unit(rng));
+
+        // The bone itself and its closest ancestors, heavier on the bone
+        std::vector<unsigned int> influences(1, bone);
+        while (influences.size() < options.influences && layout.parents[influences.back()] >= 0)
+            influences.push_back(layout.parents[influences.back()]);
+        std::vector<float> influenceWeights;
+        float total = 0;
+        for (unsigned int i = 0; i < influences.size(); i++) {
+            influenceWeights.push_back((i == 0 ? 1.f : 0.f) + unit(rng));
+            total += influenceWeights.back();
+        }
+
+        aiFace& face = mesh->mFaces[triangle];
+        face.mNumIndices = 3;
+        face.mIndices = new unsigned int[3];
+        for (unsigned int corner = 0; corner < 3; corner++) {
+            unsigned int vertex = triangle * 3 + corner;
+            glm::vec3 position = center + glm::vec3(jitter(rng), jitter(rng), jitter(rng));
+            glm::vec3 normal = glm::normalize(position - center + glm::vec3(0.f, 0.f, 1e-3f));
+            mesh->mVertices[vertex] = aiVector3D(position.x, position.y, position.z);
+            mesh->mNormals[vertex] = aiVector3D(normal.x, normal.y, normal.z);
+            mesh->mTextureCoords[0][vertex] = aiVector3D(unit(rng), unit(rng), 0.f);
+            face.mIndices[corner] = vertex;
+
+            for (unsigned int i = 0; i < influences.size(); i++)
+                weights[influences[i]].push_back(aiVertexWeight(vertex, influenceWeights[i] / total));
+        }
+    }
+
+    mesh->mNumBones = options.bones;
+    mesh->mBones = new aiBone*[options.bones];
+    for (unsigned int bone = 0; bone < options.bones; bone++) {
+        aiBone* aiB = new aiBone();
+        aiB->mName = boneName(bone);
+        aiB->mOffsetMatrix = glmToAssimpMatrix(glm::inverse(layout.globalBind[bone]));
+        aiB->mNumWeights = (unsigned int)weights[bone].size();
+        if (aiB->mNumWeights > 0) {
+            aiB->mWeights = new aiVertexWeight[aiB->mNumWeights];
+            std::copy(weights[bone].begin(), weights[bone].end(), aiB->mWeights);
+        }
+        mesh->mBones[bone] = aiB;
+    }
+    return mesh;
+}
+
+/*
+* Every bone swings around a random axis, with the same key times on all channels.
+* The last key repeats the first one so that the clip loops
+*/
+static aiAnimation* buildAnimation(const DatasetOptions& options, const SkeletonLayout& layout, const std::string& name,
+    std::mt19937& rng)
+{
+    unsigned int keyCount = std::max(2u, (unsigned int)std::ceil(options.duration * options.keyRate) + 1);
+
+    aiAnimation* animation = new aiAnimation();
+    animation->mName = name;
+    animation->mTicksPerSecond = 1.0;
+    animation->mDuration = options.duration;
+    animation->mNumChannels = options.bones;
+    animation->mChannels = new aiNodeAnim*[options.bones];
+
+    std::normal_distribution<float> normal;
+    std::uniform_real_distribution<float> phase(0.f, 6.2831853f);
+    std::uniform_real_distribution<float> amplitude(0.1f, 0.6f);
+    std::uniform_int_distribution<int> cycles(1, 3);
+
+    for (unsigned int bone = 0; bone < options.bones; bone++) {
+        aiNodeAnim* channel = new aiNodeAnim();
+        channel->mNodeName = boneName(bone);
+        channel->mNumPositionKeys = channel->mNumRotationKeys = channel->mNumScalingKeys = keyCount;
+        channel->mPositionKeys = new aiVectorKey[keyCount];
+        channel->mRotationKeys = new aiQuatKey[keyCount];
+        channel->mScalingKeys = new aiVectorKey[keyCount];
+
+        glm::vec3 axis = glm::normalize(glm::vec3(normal(rng), normal(rng), normal(rng)) + glm::vec3(0.f, 0.f, 1e-3f));
+        float start = phase(rng), swing = amplitude(rng);
+        int frequency = cycles(rng);
+        const glm::vec3& translation = layout.localTranslations[bone];
+
+        for (unsigned int key = 0; key < keyCount; key++) {
+            double time = options.duration * key / (keyCount - 1);
+            float angle = swing * std::sin(start + 6.2831853f * frequency * float(key) / (keyCount - 1));
+            glm::quat rotation = glm::angleAxis(angle, axis);
+
+            channel->mPositionKeys[key] = aiVectorKey(time, aiVector3D(translation.x, translation.y, translation.z));
+            channel->mRotationKeys[key] = aiQuatKey(time, aiQuaternion(rotation.w, rotation.x, rotation.y, rotation.z));
+            channel->mScalingKeys[key] = aiVectorKey(time, aiVector3D(1.f, 1.f, 1.f));
+        }
+        animation->mChannels[bone] = channel;
+    }
+    return animation;
+}
+
+static aiScene* buildScene(const DatasetOptions& options)
+{
+    std::mt19937 rng(options.seed);
+    SkeletonLayout layout = buildSkeleton(options, rng);
+
+    aiScene* scene = new aiScene();
+    // The mesh gets a node of its own, the Collada exporter skips the root's meshes
+    aiNode* meshNode = new aiNode("SyntheticMesh");
+    meshNode->mNumMeshes = 1;
+    meshNode->mMeshes = new unsigned int[1] { 0 };
+
+    scene->mRootNode = new aiNode("SyntheticRoot");
+    scene->mRootNode->mNumChildren = 2;
+    scene->mRootNode->mChildren = new aiNode*[2] { meshNode, buildNodes(layout, 0, scene->mRootNode) };
+    meshNode->mParent = scene->mRootNode;
+
+    scene->mNumMaterials = 1;
+    scene->mMaterials = new aiMaterial*[1] { new aiMaterial() };
+
+    scene->mNumMeshes = 1;
+    scene->mMeshes = new aiMesh*[1] { buildMesh(options, layout, rng) };
+
+    // A single clip keeps the name earlier datasets used
+    scene->mNumAnimations = options.clips;
+    scene->mAnimations = new aiAnimation*[options.clips];
+    for (unsigned int clip = 0; clip < options.clips; clip++) {
+        std::string name = options.clips == 1 ? "SyntheticClip" : "SyntheticClip" + std::to_string(clip);
+        scene->mAnimations[clip] = buildAnimation(options, layout, name, rng);
+    }
+    return scene;
+}
+
+static unsigned int clampOption(const char* value, unsigned int low, unsigned int high)
+{
+    return (unsigned int)std::min<long>(high, std::max<long>(low, std::atol(value)));
+}
+
+int main(int argc, char** argv)
+{
+    DatasetOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cout << "Missing value for " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+        const char* value = argv[++i];
+        if (arg == "--bones")
+            options.bones = clampOption(value, 1, 1000);
+        else if (arg == "--depth")
+            options.depth = clampOption(value, 1, 1000);
+        else if (arg == "--branching")
+            options.branching = clampOption(value, 1, 1000);
+        else if (arg == "--vertices")
+            options.vertices = clampOption(value, 3, 2000000);
+        else if (arg == "--influences")
+            options.influences = clampOption(value, 1, 4);
+        else if (arg == "--duration")
+            options.duration = std::max(0.1f, float(std::atof(value)));
+        else if (arg == "--key-rate")
+            options.keyRate = std::max(0.1f, float(std::atof(value)));
+        else if (arg == "--clips")
+            options.clips = clampOption(value, 1, 10000);
+        else if (arg == "--seed")
+            options.seed = (unsigned int)std::atol(value);
+        else if (arg == "--format")
+            options.format = value;
+        else if (arg == "--output")
+            options.output = value;
+        else {
+            std::cout << "Unknown argument " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    Assimp::Exporter exporter;
+    const aiExportFormatDesc* format = nullptr;
+    for (size_t i = 0; i < exporter.GetExportFormatCount(); i++) {
+        if (options.format == exporter.GetExportFormatDescription(i)->id)
+            format = exporter.GetExportFormatDescription(i);
+    }
+    if (!format) {
+        std::cout << "ERROR::GENERATE_DATASET::UNKNOWN_FORMAT " << options.format << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (options.output.empty()) {
+        options.output = std::string(PROJECT_SOURCE_DIR) + "/assets/generated/b" + std::to_string(options.bones)
+            + "_d" + std::to_string(options.depth) + "_br" + std::to_string(options.branching)
+            + "_v" + std::to_string(options.vertices) + "_i" + std::to_string(options.influences)
+            + "_k" + std::to_string(int(options.keyRate))
+            + (options.clips > 1 ? "_c" + std::to_string(options.clips) : std::string()) + "." + format->fileExtension;
+        MAKE_DIR((std::string(PROJECT_SOURCE_DIR) + "/assets/generated").c_str());
+    }
+
+    aiScene* scene = buildScene(options);
+    aiReturn result = exporter.Export(scene, format->id, options.output);
+    delete scene;
+
+    if (result != aiReturn_SUCCESS) {
+        std::cout << "ERROR::ASSIMP::" << exporter.GetErrorString() << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << options.output << std::endl;
+    return EXIT_SUCCESS;
+}
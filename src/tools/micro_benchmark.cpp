@@ -0,0 +1,682 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <glm/gtx/dual_quaternion.hpp>
+
+#include "affine.h"
+#include "animation_budget.h"
+#include "importer.h"
+#include "job_system.h"
+#include "pose_cache.h"
+#include "simd_math.h"
+#include "transformation.h"
+
+/*
+* Micro-benchmarks of the transform math of the innermost loops, over large randomized batches.
+* Usage: MicroBenchmark [--batch N] [--repetitions N] [--filter substring] [--simd scalar|sse2|avx2|neon]
+*                       [--json output.json] [--baseline baseline.json] [--threshold 0.10] [--verify]
+* With a baseline, any benchmark slower than baseline * (1 + threshold) fails the run.
+* --verify compares the SIMD kernels of every supported level with glm instead of measuring
+*/
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct Result
+{
+    std::string name;
+    double nsPerOp;  // Best repetition, the least disturbed by the rest of the system
+    double medianNs;
+};
+
+/*
+* Inputs shared by every benchmark, generated once from a fixed seed
+*/
+struct Batch
+{
+    std::vector<Transformation> transformsA, transformsB;
+    std::vector<float> progressions;
+    std::vector<aiMatrix4x4> assimpMatrices;
+    std::vector<glm::quat> quatsA, quatsB;
+    std::vector<glm::mat4> palette;
+    std::vector<glm::fdualquat> dualPalette;
+    std::vector<glm::ivec4> boneIds;
+    std::vector<glm::vec4> boneWeights;
+    std::vector<float> channels[10]; // transformsA as structure of arrays, for the 4-wide kernels
+    std::vector<glm::mat4x3> affines;
+
+    // Outputs of the batched kernels
+    std::vector<glm::mat4x3> affineOutput;
+    std::vector<glm::quat> quatOutput;
+    std::vector<float> floatOutput;
+    std::vector<glm::mat4> matrixOutput;
+
+    static const unsigned int PALETTE_SIZE = 64;
+};
+
+static glm::quat randomQuat(std::mt19937& rng)
+{
+    std::normal_distribution<float> normal;
+    return glm::normalize(glm::quat(normal(rng), normal(rng), normal(rng), normal(rng)));
+}
+
+static Batch makeBatch(unsigned int size)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::uniform_real_distribution<float> coordinate(-10.f, 10.f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.f);
+    std::uniform_int_distribution<int> bone(0, Batch::PALETTE_SIZE - 1);
+
+    Batch batch;
+    for (unsigned int i = 0; i < size; i++) {
+        for (std::vector<Transformation>* transforms : { &batch.transformsA, &batch.transformsB })
+            transforms->push_back(Transformation(glm::vec3(coordinate(rng), coordinate(rng), coordinate(rng)), randomQuat(rng),
+                glm::vec3(scale(rng), scale(rng), scale(rng))));
+        batch.progressions.push_back(unit(rng));
+        batch.quatsA.push_back(randomQuat(rng));
+        batch.quatsB.push_back(randomQuat(rng));
+
+        glm::mat4 m = batch.transformsA.back().toTransformMatrix();
+        batch.assimpMatrices.push_back(aiMatrix4x4(m[0][0], m[1][0], m[2][0], m[3][0], m[0][1], m[1][1], m[2][1], m[3][1],
+            m[0][2], m[1][2], m[2][2], m[3][2], m[0][3], m[1][3], m[2][3], m[3][3]));
+
+        glm::vec4 weights(unit(rng), unit(rng), unit(rng), unit(rng));
+        batch.boneWeights.push_back(weights / (weights.x + weights.y + weights.z + weights.w));
+        batch.boneIds.push_back(glm::ivec4(bone(rng), bone(rng), bone(rng), bone(rng)));
+
+        const Transformation& transform = batch.transformsA.back();
+        const float values[10] = { transform.position().x, transform.position().y, transform.position().z,
+            transform.rotation().x, transform.rotation().y, transform.rotation().z, transform.rotation().w,
+            transform.scale().x, transform.scale().y, transform.scale().z };
+        for (int c = 0; c < 10; c++)
+            batch.channels[c].push_back(values[c]);
+        batch.affines.push_back(transform.toAffine());
+    }
+    // Padding so that the last group of 4 stays in bounds
+    for (unsigned int i = size; i < ((size + 3) & ~3u); i++) {
+        for (int c = 0; c < 10; c++)
+            batch.channels[c].push_back(c >= 6 ? 1.f : 0.f);
+        batch.affines.push_back(glm::mat4x3(1.f));
+    }
+    batch.affineOutput.resize(batch.affines.size());
+    batch.quatOutput.resize(size);
+    batch.floatOutput.resize(size);
+    batch.matrixOutput.resize(size);
+    for (unsigned int i = 0; i < Batch::PALETTE_SIZE; i++) {
+        Transformation transform(glm::vec3(coordinate(rng), coordinate(rng), coordinate(rng)), randomQuat(rng));
+        batch.palette.push_back(transform.toTransformMatrix());
+        batch.dualPalette.push_back(transform.toDualQuat());
+    }
+    return batch;
+}
+
+static glm::quat nlerp(const glm::quat& a, const glm::quat& b, float t)
+{
+    glm::quat end = glm::dot(a, b) < 0.f ? -b : b;
+    return glm::normalize(a * (1.f - t) + end * t);
+}
+
+// Results are folded in here so that the compiler cannot drop the measured work
+static volatile float sink;
+
+static Result measure(const std::string& name, unsigned int batchSize, unsigned int repetitions, const std::function<float()>& run)
+{
+    std::vector<double> samples;
+    run(); // Warm-up: caches, page faults, branch predictors
+    for (unsigned int r = 0; r < repetitions; r++) {
+        Clock::time_point start = Clock::now();
+        sink = run();
+        double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+        samples.push_back(ns / batchSize);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    Result result;
+    result.name = name;
+    result.nsPerOp = samples.front();
+    result.medianNs = samples[samples.size() / 2];
+    return result;
+}
+
+static std::vector<Result> runAll(Batch& batch, unsigned int repetitions, const std::string& filter)
+{
+    const unsigned int n = (unsigned int)batch.progressions.size();
+    std::vector<std::pair<std::string, std::function<float()>>> benchmarks = {
+        { "transformation_interpolate", [&]() {
+            float acc = 0;
+            for (unsigned int i = 0; i < n; i++)
+                acc += Transformation::interpolate(batch.transformsA[i], batch.transformsB[i], batch.progressions[i]).position().x;
+            return acc;
+        } },
+        { "transformation_to_matrix", [&]() {
+            float acc = 0;
+            for (unsigned int i = 0; i < n; i++)
+                acc += batch.transformsA[i].toTransformMatrix()[3][0];
+            return acc;
+        } },
+        { "compose_trs", [&]() {
+            float acc = 0;
+            for (unsigned int i = 0; i < n; i++)
+                acc += composeTRS(batch.transformsA[i].position(), batch.transformsA[i].rotation(), batch.transformsA[i].scale())[3][0];
+            return acc;
+        } },
+        { "compose_trs_batch", [&]() {
+            composeTRSBatch(&batch.channels[0][0], &batch.channels[1][0], &batch.channels[2][0], &batch.channels[3][0],
+                &batch.channels[4][0], &batch.channels[5][0], &batch.channels[6][0], &batch.channels[7][0],
+                &batch.channels[8][0], &batch.channels[9][0], &batch.affineOutput[0], (unsigned int)batch.affines.size());
+            return batch.affineOutput[n - 1][3][0];
+        } },
+        { "concat_affine", [&]() {
+            float acc = 0;
+            for (unsigned int i = 0; i < n; i++)
+                acc += concatAffine(batch.affines[i], batch.affines[(i + 1) % n])[3][0];
+            return acc;
+        } },
+        { "concat_affine_batch", [&]() {
+            // Every transform with the next one, like the loop above
+            concatAffineBatch(&batch.affines[0], &batch.affines[1], &batch.affineOutput[0], n - 1);
+            return batch.affineOutput[n - 2][3][0];
+        } },
+        { "transformation_to_dual_quat", [&]() {
+            float acc = 0;
+            for (unsigned int i = 0; i < n; i++)
+                acc += batch.transformsA[i].toDualQuat().dual.x;
+            return acc;
+        } },
+        { "assimp_to_glm_matrix", [&]() {
+            float acc = 0;
+            for (unsigned int i = 0; i < n; i++)
+                acc += assimpToGlmMatrix(batch.assimpMatrices[i])[3][0];
+            return acc;
+        } },
+        { "quat_slerp", [&]() {
+            float acc = 0;
+            for (unsigned int i = 0; i < n; i++)
+                acc += glm::slerp(batch.quatsA[i], batch.quatsB[i], batch.progressions[i]).x;
+            return acc;
+        } },
+        { "quat_nlerp", [&]() {
+            float acc = 0;
+            for (unsigned int i = 0; i < n; i++)
+                acc += nlerp(batch.quatsA[i], batch.quatsB[i], batch.progressions[i]).x;
+            return acc;
+        } },
+        { "quat_nlerp_batch", [&]() {
+            nlerpBatch(&batch.quatsA[0], &batch.quatsB[0], &batch.progressions[0], &batch.quatOutput[0], n);
+            return batch.quatOutput[n - 1].x;
+        } },
+        { "lerp_batch", [&]() {
+            lerpBatch(&batch.channels[0][0], &batch.channels[1][0], &batch.progressions[0], &batch.floatOutput[0], n);
+            return batch.floatOutput[n - 1];
+        } },
+        { "quat_onlerp_batch", [&]() {
+            onlerpBatch(&batch.quatsA[0], &batch.quatsB[0], &batch.progressions[0], &batch.quatOutput[0], n);
+            return batch.quatOutput[n - 1].x;
+        } },
+        { "quat_multiply", [&]() {
+            float acc = 0;
+            for (unsigned int i = 0; i < n; i++)
+                acc += (batch.quatsA[i] * batch.quatsB[i]).x;
+            return acc;
+        } },
+        { "quat_multiply_batch", [&]() {
+            multiplyQuatBatch(&batch.quatsA[0], &batch.quatsB[0], &batch.quatOutput[0], n);
+            return batch.quatOutput[n - 1].x;
+        } },
+        { "blend4_matrix", [&]() {
+            float acc = 0;
+            for (unsigned int i = 0; i < n; i++) {
+                const glm::ivec4& ids = batch.boneIds[i];
+                const glm::vec4& weights = batch.boneWeights[i];
+                glm::mat4 blend = batch.palette[ids.x] * weights.x + batch.palette[ids.y] * weights.y
+                    + batch.palette[ids.z] * weights.z + batch.palette[ids.w] * weights.w;
+                acc += blend[3][0];
+            }
+            return acc;
+        } },
+        { "blend4_matrix_batch", [&]() {
+            blendMatrices4(&batch.palette[0], &batch.boneIds[0], &batch.boneWeights[0], sizeof(glm::vec4),
+                &batch.matrixOutput[0], sizeof(glm::mat4), n);
+            return batch.matrixOutput[n - 1][3][0];
+        } },
+        { "blend4_dual_quat", [&]() {
+            float acc = 0;
+            for (unsigned int i = 0; i < n; i++) {
+                const glm::ivec4& ids = batch.boneIds[i];
+                const glm::vec4& weights = batch.boneWeights[i];
+                const glm::fdualquat& first = batch.dualPalette[ids.x];
+                glm::quat real = first.real * weights.x;
+                glm::quat dual = first.dual * weights.x;
+                for (int k = 1; k < 4; k++) {
+                    const glm::fdualquat& dq = batch.dualPalette[ids[k]];
+                    float weight = glm::dot(first.real, dq.real) < 0.f ? -weights[k] : weights[k];
+                    real = real + dq.real * weight;
+                    dual = dual + dq.dual * weight;
+                }
+                acc += glm::normalize(glm::fdualquat(real, dual)).dual.x;
+            }
+            return acc;
+        } },
+    };
+
+    std::vector<Result> results;
+    for (const std::pair<std::string, std::function<float()>>& benchmark : benchmarks) {
+        if (benchmark.first.find(filter) != std::string::npos)
+            results.push_back(measure(benchmark.first, n, repetitions, benchmark.second));
+    }
+    return results;
+}
+
+/*
+* Largest difference to the reference, relative when the reference is above 1
+*/
+static float maxError(const float* values, const float* reference, unsigned int count)
+{
+    float res = 0.f;
+    for (unsigned int i = 0; i < count; i++)
+        res = std::max(res, std::abs(values[i] - reference[i]) / std::max(1.f, std::abs(reference[i])));
+    return res;
+}
+
+/*
+* count transforms, entry k = bone * width + lane, from and to the lanes layout of the *Lanes kernels
+*/
+static void toLanes(const glm::mat4x3* affines, unsigned int width, unsigned int count, float* lanes)
+{
+    for (unsigned int k = 0; k < count; k++)
+        for (unsigned int e = 0; e < 12; e++)
+            lanes[(k / width) * 12 * width + e * width + k % width] = (&affines[k][0][0])[e];
+}
+
+static void fromLanes(const float* lanes, unsigned int width, unsigned int count, glm::mat4* matrices)
+{
+    for (unsigned int k = 0; k < count; k++) {
+        glm::mat4x3 affine;
+        for (unsigned int e = 0; e < 12; e++)
+            (&affine[0][0])[e] = lanes[(k / width) * 12 * width + e * width + k % width];
+        matrices[k] = affineToMat4(affine);
+    }
+}
+
+/*
+* Runs the batched kernels of every supported SIMD level and compares them with the glm operations they replace
+*/
+static bool verifyKernels(Batch& batch)
+{
+    const float TOLERANCE = 1e-5f;
+    const unsigned int n = (unsigned int)batch.progressions.size();
+
+    std::vector<glm::mat4> composeReference(n), concatReference(n - 1), blendReference(n);
+    std::vector<glm::quat> multiplyReference(n), nlerpReference(n), onlerpReference(n);
+    std::vector<float> lerpReference(n);
+    for (unsigned int i = 0; i < n; i++) {
+        const Transformation& transform = batch.transformsA[i];
+        composeReference[i] = glm::translate(glm::mat4(1.f), transform.position()) * glm::toMat4(transform.rotation())
+            * glm::scale(glm::mat4(1.f), transform.scale());
+        if (i + 1 < n)
+            concatReference[i] = glm::mat4(batch.affines[i]) * glm::mat4(batch.affines[i + 1]);
+        multiplyReference[i] = batch.quatsA[i] * batch.quatsB[i];
+        glm::quat end = glm::dot(batch.quatsA[i], batch.quatsB[i]) < 0.f ? -batch.quatsB[i] : batch.quatsB[i];
+        nlerpReference[i] = glm::normalize(glm::lerp(batch.quatsA[i], end, batch.progressions[i]));
+        float progression = onlerpProgression(std::abs(glm::dot(batch.quatsA[i], batch.quatsB[i])), batch.progressions[i]);
+        onlerpReference[i] = glm::normalize(glm::lerp(batch.quatsA[i], end, progression));
+        lerpReference[i] = glm::mix(batch.channels[0][i], batch.channels[1][i], batch.progressions[i]);
+
+        const glm::ivec4& ids = batch.boneIds[i];
+        const glm::vec4& weights = batch.boneWeights[i];
+        blendReference[i] = batch.palette[ids.x] * weights.x + batch.palette[ids.y] * weights.y
+            + batch.palette[ids.z] * weights.z + batch.palette[ids.w] * weights.w;
+    }
+
+    const SimdLevel initial = simdLevel();
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::NEON };
+    std::vector<glm::mat4> affines(n);
+    bool success = true;
+    std::cout << std::scientific << std::setprecision(2);
+    for (SimdLevel level : levels) {
+        if (!setSimdLevel(level))
+            continue;
+
+        composeTRSBatch(&batch.channels[0][0], &batch.channels[1][0], &batch.channels[2][0], &batch.channels[3][0],
+            &batch.channels[4][0], &batch.channels[5][0], &batch.channels[6][0], &batch.channels[7][0],
+            &batch.channels[8][0], &batch.channels[9][0], &batch.affineOutput[0], (unsigned int)batch.affines.size());
+        for (unsigned int i = 0; i < n; i++)
+            affines[i] = affineToMat4(batch.affineOutput[i]);
+        float composeError = maxError(&affines[0][0][0], &composeReference[0][0][0], 16 * n);
+
+        concatAffineBatch(&batch.affines[0], &batch.affines[1], &batch.affineOutput[0], n - 1);
+        for (unsigned int i = 0; i + 1 < n; i++)
+            affines[i] = affineToMat4(batch.affineOutput[i]);
+        float concatError = maxError(&affines[0][0][0], &concatReference[0][0][0], 16 * (n - 1));
+
+        multiplyQuatBatch(&batch.quatsA[0], &batch.quatsB[0], &batch.quatOutput[0], n);
+        float multiplyError = maxError(&batch.quatOutput[0].x, &multiplyReference[0].x, 4 * n);
+
+        nlerpBatch(&batch.quatsA[0], &batch.quatsB[0], &batch.progressions[0], &batch.quatOutput[0], n);
+        float nlerpError = maxError(&batch.quatOutput[0].x, &nlerpReference[0].x, 4 * n);
+
+        onlerpBatch(&batch.quatsA[0], &batch.quatsB[0], &batch.progressions[0], &batch.quatOutput[0], n);
+        float onlerpError = maxError(&batch.quatOutput[0].x, &onlerpReference[0].x, 4 * n);
+
+        lerpBatch(&batch.channels[0][0], &batch.channels[1][0], &batch.progressions[0], &batch.floatOutput[0], n);
+        float lerpError = maxError(&batch.floatOutput[0], &lerpReference[0], n);
+
+        blendMatrices4(&batch.palette[0], &batch.boneIds[0], &batch.boneWeights[0], sizeof(glm::vec4),
+            &batch.matrixOutput[0], sizeof(glm::mat4), n);
+        float blendError = maxError(&batch.matrixOutput[0][0][0], &blendReference[0][0][0], 16 * n);
+
+        std::vector<std::pair<std::string, float>> errors = { { "compose_trs_batch", composeError }, { "concat_affine_batch", concatError },
+            { "quat_multiply_batch", multiplyError }, { "quat_nlerp_batch", nlerpError },
+            { "quat_onlerp_batch", onlerpError }, { "lerp_batch", lerpError }, { "blend4_matrix_batch", blendError } };
+
+        // 12 lanes is not a multiple of 8, the AVX2 kernels fall back to SSE2 for it
+        for (unsigned int width : { 4u, 8u, 12u }) {
+            const unsigned int bones = n / width, count = bones * width;
+            if (bones < 2)
+                continue;
+            std::vector<float> lanes(12 * count), next(12 * count), output(12 * count);
+
+            composeTRSLanes(&batch.channels[0][0], &batch.channels[1][0], &batch.channels[2][0], &batch.channels[3][0],
+                &batch.channels[4][0], &batch.channels[5][0], &batch.channels[6][0], &batch.channels[7][0],
+                &batch.channels[8][0], &batch.channels[9][0], &output[0], count, width);
+            fromLanes(&output[0], width, count, &affines[0]);
+            float composeLanesError = maxError(&affines[0][0][0], &composeReference[0][0][0], 16 * count);
+
+            // Each bone by the next one, lane by lane
+            const unsigned int concatCount = count - width;
+            std::vector<glm::mat4> concatLanesReference(concatCount);
+            for (unsigned int k = 0; k < concatCount; k++)
+                concatLanesReference[k] = glm::mat4(batch.affines[k]) * glm::mat4(batch.affines[k + width]);
+            toLanes(&batch.affines[0], width, concatCount, &lanes[0]);
+            toLanes(&batch.affines[width], width, concatCount, &next[0]);
+            concatAffineLanes(&lanes[0], &next[0], &output[0], width, bones - 1);
+            fromLanes(&output[0], width, concatCount, &affines[0]);
+            float concatLanesError = maxError(&affines[0][0][0], &concatLanesReference[0][0][0], 16 * concatCount);
+
+            errors.push_back({ "compose_trs_lanes w" + std::to_string(width), composeLanesError });
+            errors.push_back({ "concat_affine_lanes w" + std::to_string(width), concatLanesError });
+        }
+
+        for (const std::pair<std::string, float>& error : errors) {
+            bool valid = error.second <= TOLERANCE;
+            success &= valid;
+            std::cout << std::left << std::setw(28) << error.first << std::setw(8) << simdLevelName(level) << std::right
+                << " max error " << error.second << (valid ? "" : "  MISMATCH") << std::endl;
+        }
+    }
+    std::cout.unsetf(std::ios_base::floatfield);
+    setSimdLevel(initial);
+    return success;
+}
+
+/*
+* A crowd with more due instances than the update cap: every instance has to be served within
+* ceil(instances / cap) frames of its last update, and the cap must hold on every frame
+*/
+static bool verifyBudget()
+{
+    const unsigned int INSTANCES = 100, MAX_UPDATES = 8, FRAMES = 1000;
+    const unsigned int bound = (INSTANCES + MAX_UPDATES - 1) / MAX_UPDATES;
+
+    AnimationBudget budget(MAX_UPDATES);
+    std::vector<unsigned int> handles(INSTANCES), lastUpdate(INSTANCES, 0);
+    for (unsigned int& handle : handles)
+        handle = budget.add();
+
+    unsigned int longestWait = 0, busiestFrame = 0;
+    for (unsigned int frame = 1; frame <= FRAMES; frame++) {
+        budget.beginFrame();
+        for (unsigned int i = 0; i < INSTANCES; i++) {
+            // Every instance at full rate, so all of them are due on every frame
+            if (budget.shouldUpdate(handles[i], 0.f, true))
+                lastUpdate[i] = frame;
+            longestWait = std::max(longestWait, frame - lastUpdate[i]);
+        }
+        busiestFrame = std::max(busiestFrame, budget.updatesThisFrame());
+    }
+
+    bool valid = longestWait <= bound && busiestFrame <= MAX_UPDATES;
+    std::cout << std::left << std::setw(28) << "animation_budget" << std::right << "longest wait " << longestWait
+        << " frames (bound " << bound << "), busiest frame " << busiestFrame << " updates (cap " << MAX_UPDATES << ")"
+        << (valid ? "" : "  STARVED") << std::endl;
+    return valid;
+}
+
+static bool verifyPoseCache()
+{
+    const unsigned int CAPACITY = 64, REQUESTS = 200, FRAMES = 4, BONES = 4;
+    const float STEP = 0.01f;
+
+    PoseCache cache(STEP, CAPACITY);
+    unsigned int stale = 0, held = 0;
+    for (unsigned int frame = 0; frame < FRAMES; frame++) {
+        cache.beginFrame();
+        // Every palette of the frame is kept by reference, past the sweeps and overflows of the later get()
+        std::vector<std::pair<const std::vector<glm::mat4>*, float>> palettes;
+        for (unsigned int i = 0; i < REQUESTS; i++) {
+            // Half of the requests repeat a time of the frame, the times shift from frame to frame
+            const float time = float(frame * REQUESTS / 2 + (i % 2 ? i / 2 : i)) * STEP;
+            const std::vector<glm::mat4>& palette = cache.get(0, time, 0, BONES,
+                [](float snapped, std::vector<glm::mat4>& pose) { pose[BONES - 1][3][0] = snapped; });
+            palettes.push_back(std::make_pair(&palette, cache.snap(time)));
+        }
+        for (const std::pair<const std::vector<glm::mat4>*, float>& palette : palettes) {
+            if (palette.first->size() != BONES || (*palette.first)[BONES - 1][3][0] != palette.second)
+                stale++;
+        }
+        held += (unsigned int)palettes.size();
+    }
+
+    bool valid = stale == 0 && cache.evictions() > 0;
+    std::cout << std::left << std::setw(28) << "pose_cache" << std::right << stale << " of " << held
+        << " palettes changed within their frame, " << cache.evictions() << " evictions, hit rate "
+        << cache.hitRate() << (valid ? "" : "  STALE") << std::endl;
+    return valid;
+}
+
+struct JobStress
+{
+    std::atomic<unsigned int> items;
+    std::atomic<unsigned int> continued;
+    std::atomic<unsigned int> errors;
+    unsigned int expected;
+};
+
+static void countItems(void* data, unsigned int begin, unsigned int end)
+{
+    static_cast<JobStress*>(data)->items.fetch_add(end - begin);
+}
+
+static void checkItems(void* data, unsigned int, unsigned int)
+{
+    JobStress& stress = *static_cast<JobStress*>(data);
+    if (stress.items.load() != stress.expected)
+        stress.errors.fetch_add(1);
+    stress.continued.fetch_add(1);
+}
+
+static bool verifyJobSystem()
+{
+    // Enough children to have every slot of the ring pending at once, and more continuations than a job holds
+    const unsigned int ROUNDS = 20, CHILDREN = JobSystem::JOB_CAPACITY + 256, ITEMS = 64, GRAIN = 4;
+    const unsigned int CONTINUATIONS = 7, COUNT = 100000;
+    const unsigned int threadCounts[] = { 2, 8 };
+
+    bool valid = true;
+    for (unsigned int threads : threadCounts) {
+        JobSystem jobs(threads);
+        unsigned int failures = 0;
+        for (unsigned int round = 0; round < ROUNDS; round++) {
+            // Graph: children split down to the grain, continuations of their group checking they all ran
+            JobStress stress;
+            stress.items.store(0);
+            stress.continued.store(0);
+            stress.errors.store(0);
+            stress.expected = (round % 2 ? CHILDREN : 64) * ITEMS;
+
+            JobSystem::Job* group = jobs.create(nullptr, nullptr);
+            JobSystem::Job* done = jobs.create(nullptr, nullptr);
+            std::vector<JobSystem::Job*> children(stress.expected / ITEMS);
+            for (JobSystem::Job*& child : children)
+                child = jobs.create(&countItems, &stress, 0, ITEMS, GRAIN, group);
+            for (unsigned int i = 0; i < CONTINUATIONS; i++)
+                jobs.then(group, jobs.create(&checkItems, &stress, 0, 1, 0, done));
+            for (JobSystem::Job* child : children)
+                jobs.run(child);
+            jobs.run(group);
+            jobs.run(done);
+            jobs.wait(done);
+            if (stress.items.load() != stress.expected || stress.continued.load() != CONTINUATIONS || stress.errors.load())
+                failures++;
+
+            // parallelFor: every item visited once
+            std::vector<unsigned int> visits(COUNT, 0);
+            jobs.parallelFor(COUNT, 256, [&visits](unsigned int begin, unsigned int end) {
+                for (unsigned int i = begin; i < end; i++)
+                    visits[i]++;
+            });
+            if (std::count(visits.begin(), visits.end(), 1u) != COUNT)
+                failures++;
+        }
+
+        std::cout << std::left << std::setw(28) << ("job_system " + std::to_string(threads) + " threads") << std::right
+            << failures << " of " << ROUNDS * 2 << " graphs and loops wrong" << (failures ? "  FAILED" : "") << std::endl;
+        valid = valid && failures == 0;
+    }
+    return valid;
+}
+
+static void writeJson(const std::string& path, const std::vector<Result>& results, unsigned int batchSize)
+{
+    std::ofstream file(path);
+    if (!file) {
+        std::cout << "ERROR::MICRO_BENCHMARK::OUTPUT_NOT_WRITABLE " << path << std::endl;
+        return;
+    }
+    file << std::setprecision(6);
+    file << "{\n  \"batch\": " << batchSize << ",\n  \"benchmarks\": [\n";
+    for (unsigned int i = 0; i < results.size(); i++) {
+        file << "    { \"name\": \"" << results[i].name << "\", \"ns_per_op\": " << results[i].nsPerOp
+            << ", \"median_ns\": " << results[i].medianNs << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+}
+
+/*
+* Reads back the files written by writeJson, only name and ns_per_op matter
+*/
+static bool readBaseline(const std::string& path, std::map<std::string, double>& baseline)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "ERROR::MICRO_BENCHMARK::BASELINE_NOT_FOUND " << path << std::endl;
+        return false;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    const std::string content = stream.str();
+
+    size_t pos = 0;
+    while ((pos = content.find("\"name\"", pos)) != std::string::npos) {
+        size_t begin = content.find('"', content.find(':', pos)) + 1;
+        size_t end = content.find('"', begin);
+        size_t value = content.find("\"ns_per_op\"", end);
+        if (begin == 0 || end == std::string::npos || value == std::string::npos)
+            break;
+        baseline[content.substr(begin, end - begin)] = std::atof(content.c_str() + content.find(':', value) + 1);
+        pos = end;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int batchSize = 1 << 16;
+    unsigned int repetitions = 9;
+    float threshold = 0.10f;
+    bool verify = false;
+    std::string filter, jsonPath, baselinePath;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--batch" && hasValue)
+            batchSize = std::max(2, std::atoi(argv[++i]));
+        else if (arg == "--repetitions" && hasValue)
+            repetitions = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--filter" && hasValue)
+            filter = argv[++i];
+        else if (arg == "--json" && hasValue)
+            jsonPath = argv[++i];
+        else if (arg == "--baseline" && hasValue)
+            baselinePath = argv[++i];
+        else if (arg == "--threshold" && hasValue)
+            threshold = float(std::atof(argv[++i]));
+        else if (arg == "--simd" && hasValue) {
+            SimdLevel level;
+            if (!parseSimdLevel(argv[++i], level) || !setSimdLevel(level)) {
+                std::cout << "ERROR::MICRO_BENCHMARK::UNSUPPORTED_SIMD_LEVEL " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "--verify")
+            verify = true;
+        else {
+            std::cout << "Unknown argument " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    if (!baselinePath.empty() && !readBaseline(baselinePath, baseline))
+        return EXIT_FAILURE;
+
+    Batch batch = makeBatch(batchSize);
+    if (verify) {
+        bool kernels = verifyKernels(batch);
+        bool budget = verifyBudget();
+        bool poseCache = verifyPoseCache();
+        bool jobSystem = verifyJobSystem();
+        return kernels && budget && poseCache && jobSystem ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    std::cout << "SIMD level: " << simdLevelName(simdLevel()) << std::endl;
+    std::vector<Result> results = runAll(batch, repetitions, filter);
+
+    bool regressed = false;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "benchmark                      ns/op   median" << (baseline.empty() ? "" : "  baseline   change") << std::endl;
+    for (const Result& result : results) {
+        std::cout << std::left << std::setw(28) << result.name << std::right
+            << std::setw(8) << result.nsPerOp << std::setw(9) << result.medianNs;
+
+        std::map<std::string, double>::const_iterator it = baseline.find(result.name);
+        if (it != baseline.end() && it->second > 0) {
+            double change = result.nsPerOp / it->second - 1.0;
+            bool slower = change > threshold;
+            regressed |= slower;
+            std::cout << std::setw(10) << it->second << std::setw(8) << std::showpos << change * 100.0 << std::noshowpos << "%"
+                << (slower ? "  REGRESSION" : "");
+        }
+        std::cout << std::endl;
+    }
+
+    if (!jsonPath.empty())
+        writeJson(jsonPath, results, batchSize);
+    return regressed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
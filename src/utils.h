@@ -7,39 +7,28 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/dual_quaternion.hpp>
 #include <assimp/scene.h>
 
 #include "texture.h"
 #include "shader.h"
 #include "vao.h"
+#include "profiler.h"
 #include "animation.h"
+#include "animation_library.h"
 #include "bone.h"
-
-inline glm::mat4 assimpToGlmMatrix(aiMatrix4x4 mat) {
-	glm::mat4 m;
-	for (int y = 0; y < 4; y++)
-	{
-		for (int x = 0; x < 4; x++)
-		{
-			m[x][y] = mat[y][x];
-		}
-	}
-	return m;
-}
-
-inline glm::vec3 assimpToGlmVec3(aiVector3D vec) {
-	return glm::vec3(vec.x, vec.y, vec.z);
-}
-
-inline glm::quat assimpToGlmQuat(aiQuaternion quat) {
-	glm::quat q;
-	q.x = quat.x;
-	q.y = quat.y;
-	q.z = quat.z;
-	q.w = quat.w;
-
-	return q;
-}
+#include "bounds.h"
+#include "importer.h"
+#include "animation_budget.h"
+#include "skeleton_lod.h"
+#include "flat_skeleton.h"
+#include "frame_arena.h"
+#include "allocation_tracker.h"
+#include "inertialization.h"
+#include "local_pose.h"
+#include "pose.h"
+#include "pose_blend.h"
+#include "skinning.h"
 
 struct FreeCamera
 {
@@ -104,14 +93,16 @@ struct FreeCamera
 	}
 };
 
-int WIDTH = 800;
-int HEIGHT = 600;
+// Framebuffer size, defined in main.cpp
+extern int WIDTH;
+extern int HEIGHT;
 
 enum class Mode
 {
 	CPU,
 	GPU,
-	GPU_DUAL
+	GPU_DUAL,
+	VAT
 };
 
 struct AppState
@@ -126,178 +117,181 @@ struct AppState
 };
 
 
-struct AnimPackage
+/*
+* Per-frame systems shared by the loops
+*/
+struct FrameContext
 {
-	AnimPackage(Shader s, Vao v, Animation a, Bone b, int c, glm::mat4 g = glm::mat4(1)) :
-		shader(s), vao(v), texture(Texture::DEFAULT()), animation(a), skeleton(b), boneCount(c), globalInvTr(g)
-	{}
-
-	Shader shader;
-	Vao vao;
-	Texture texture;
-	Animation animation;
-	Bone skeleton;
-	GLuint boneCount;
-	glm::mat4 globalInvTr;
+	AnimationBudget budget;
+	Profiler profiler;
+	// Scratch memory of the current frame, reset at its start
+	FrameArena arena;
+	AllocationTracker allocations;
+	// Offsets left by the last animation switch, shared since switching modes switches packages
+	Inertializer transition;
 };
 
-struct Vertex {
-	glm::vec3 position;
-	glm::vec3 normal;
-	glm::vec2 uv;
-	glm::ivec4 boneIds = glm::ivec4(0);
-	glm::vec4 boneWeights = glm::vec4(0.0f);
+/*
+* What the update half of a frame reads, filled on the GL thread where input is polled
+*/
+struct FrameInput
+{
+	// Wall clock, paces the transitions, and animation time
+	float clock = 0;
+	float time = 0;
+	Mode mode = Mode::CPU;
+	FreeCamera camera = FreeCamera(glm::vec3(0.f));
+	float aspect = 1;
+	// Animation switches so far, each new one starts a transition
+	unsigned int switches = 0;
 };
 
+/*
+* What the draw half of a frame needs, written by the update half. Reused from frame to
+* frame, so its storage stops growing after the first frames
+*/
+struct PoseFrame
+{
+	FrameInput input;
+	glm::mat4 viewProjection = glm::mat4(1);
+	bool visible = false;
+	// Palette of the character, or those of the visible crowd instances one after the other
+	std::vector<glm::mat4> pose;
+	std::vector<glm::fdualquat> dualPose;
+	// Model matrices of the visible crowd instances, in the order of their palettes
+	std::vector<glm::mat4> instanceModels;
+	// Vertices skinned by the CPU path, and the pose version they were skinned from
+	std::vector<VertexCPU> skinned;
+	unsigned int skinnedVersion = 0;
+	glm::ivec2 vatFrames = glm::ivec2(0);
+	float vatBlend = 0;
+};
 
-bool readSkeleton(Bone& boneOutput, aiNode* node, std::unordered_map<std::string, std::pair<int, glm::mat4>>& boneInfoTable) {	
-	if (boneInfoTable.find(node->mName.C_Str()) != boneInfoTable.end()) {
-		boneOutput.setName(node->mName.C_Str());
-		boneOutput.setId(boneInfoTable[boneOutput.name()].first);
-		boneOutput.setOffset(boneInfoTable[boneOutput.name()].second);
+// One skeleton level per default AnimationBudget tier
+const unsigned int SKELETON_LOD_LEVELS = 4;
+// Phases of an additive layer covered by the culling bounds when it does not last as long as the clip
+const unsigned int ADDITIVE_BOUNDS_PHASES = 8;
 
-		for (int i = 0; i < node->mNumChildren; i++) {
-			Bone child;
-			readSkeleton(child, node->mChildren[i], boneInfoTable);
-			boneOutput.addChild(child);
-		}
-		return true;
-	}
+/*
+* One character of a crowd drawn by a single instanced call: its placement, its own clip
+* time and budget slot, and the last pose it evaluated
+*/
+struct CrowdInstance
+{
+	glm::mat4 model = glm::mat4(1);
+	float timeOffset = 0;
+	unsigned int budgetHandle = 0;
+	std::vector<glm::mat4> pose;
+};
 
-	for (int i = 0; i < node->mNumChildren; i++) {
-		if (readSkeleton(boneOutput, node->mChildren[i], boneInfoTable)) {
-			return true;
-		}
+struct AnimPackage
+{
+	AnimPackage(Shader s, Vao v, AnimationLibrary& l, unsigned int a, Bone b, int c, glm::mat4 g = glm::mat4(1)) :
+		shader(s), vao(v), texture(Texture::DEFAULT()), library(&l), clip(a), skeleton(b), boneCount(c), globalInvTr(g),
+		paletteFromLocal(nullptr), additiveClip(-1), additiveWeight(1.f),
+		pose(c, glm::mat4(1)), dualPose(c, glm::fdualquat(glm::quat(1.f, 0.f, 0.f, 0.f), glm::quat(0.f, 0.f, 0.f, 0.f))),
+		budgetHandle(0), poseVersion(0)
+	{
+		flatSkeleton.build(skeleton);
 	}
 
-	return false;
-}
-
-void loadAnimation(const aiScene* scene, Bone bone, Animation& animation) {
-	aiAnimation* anim = scene->mAnimations[0];
-
-	if (anim->mTicksPerSecond != 0.0f)
-		animation.setTPS(anim->mTicksPerSecond);
-	else
-		animation.setTPS(1);
-
-	animation.setDuration(anim->mDuration * anim->mTicksPerSecond);
+	inline Animation& animation() { return *library->get(clip); }
 
-	for (int i = 0; i < anim->mNumChannels; i++) {
-		std::vector<KeyFrame> keyFrames;
-		aiNodeAnim* channel = anim->mChannels[i];
-
-		unsigned int numPositions = channel->mNumPositionKeys;
-		unsigned int numRotations = channel->mNumRotationKeys;
-		unsigned int numScales = channel->mNumScalingKeys;
-
-		unsigned int nbKeyFrames = std::max(std::max(numPositions, numRotations), numScales);
-		for (unsigned int i = 0; i < nbKeyFrames; i++)
+	/*
+	* Local pose of the clip at time into localPose, with the additive layer at additiveTime applied
+	*/
+	void sampleLocal(float time, float additiveTime, const std::vector<bool>* kept)
+	{
+		sampleLocalPose(animation(), flatSkeleton, time, localPose, kept);
+		if (additiveClip >= 0 && additiveWeight > 0.f)
 		{
-			unsigned int idxPos = std::min(i, numPositions - 1);
-			unsigned int idxRot = std::min(i, numRotations - 1);
-			unsigned int idxScale = std::min(i, numScales - 1);
-
-			KeyFrame keyFrame;
-			keyFrame.transform = Transformation(
-				assimpToGlmVec3(channel->mPositionKeys[idxPos].mValue),
-				assimpToGlmQuat(channel->mRotationKeys[idxRot].mValue),
-				assimpToGlmVec3(channel->mScalingKeys[idxScale].mValue));
-
-			keyFrame.timeStamp = channel->mPositionKeys[i].mTime;
-			keyFrames.push_back(keyFrame);
+			sampleLocalPose(*library->get(additiveClip), flatSkeleton, additiveTime, additivePose, kept);
+			additiveWeights.assign(localPose.padded(), additiveWeight);
+			addLocalPose(localPose, additivePose, &additiveWeights[0], localPose);
 		}
-		for (const KeyFrame& k : keyFrames)
-			animation.addBoneKeyFrame(channel->mNodeName.C_Str(), k);
 	}
-}
-
-void loadModel(const aiScene* scene, aiMesh* mesh, std::vector<Vertex>& verticesOutput, std::vector<GLuint>& indicesOutput, Bone& skeletonOutput, GLuint& nBoneCount) {
-	verticesOutput = {};
-	indicesOutput = {};
-
-	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-		//process position 
-		Vertex vertex;
-		glm::vec3 vector;
-		vector.x = mesh->mVertices[i].x;
-		vector.y = mesh->mVertices[i].y;
-		vector.z = mesh->mVertices[i].z;
-		vertex.position = vector;
-		//process normal
-		vector.x = mesh->mNormals[i].x;
-		vector.y = mesh->mNormals[i].y;
-		vector.z = mesh->mNormals[i].z;
-		vertex.normal = vector;
-		//process uv
-		glm::vec2 vec;
-		vec.x = mesh->mTextureCoords[0][i].x;
-		vec.y = mesh->mTextureCoords[0][i].y;
-		vertex.uv = vec;
 
-		vertex.boneIds = glm::ivec4(0);
-		vertex.boneWeights = glm::vec4(0.0f);
-
-		verticesOutput.push_back(vertex);
+	/*
+	* Same with the layer at the time of the clip, as played
+	*/
+	void sampleLocal(float time, const std::vector<bool>* kept)
+	{
+		sampleLocal(time, time, kept);
 	}
 
-	std::unordered_map<std::string, std::pair<int, glm::mat4>> boneInfo = {};
-	std::vector<GLuint> boneCounts;
-	boneCounts.resize(verticesOutput.size(), 0);
-	nBoneCount = mesh->mNumBones;
-
-	for (int i = 0; i < nBoneCount; i++) {
-		aiBone* bone = mesh->mBones[i];
-		glm::mat4 m = assimpToGlmMatrix(bone->mOffsetMatrix);
-		boneInfo[bone->mName.C_Str()] = { i, m };
-
-		for (int j = 0; j < bone->mNumWeights; j++) {
-			GLuint id = bone->mWeights[j].mVertexId;
-			float weight = bone->mWeights[j].mWeight;
-			boneCounts[id]++;
-			switch (boneCounts[id]) {
-			case 1:
-				verticesOutput[id].boneIds.x = i;
-				verticesOutput[id].boneWeights.x = weight;
-				break;
-			case 2:
-				verticesOutput[id].boneIds.y = i;
-				verticesOutput[id].boneWeights.y = weight;
-				break;
-			case 3:
-				verticesOutput[id].boneIds.z = i;
-				verticesOutput[id].boneWeights.z = weight;
-				break;
-			case 4:
-				verticesOutput[id].boneIds.w = i;
-				verticesOutput[id].boneWeights.w = weight;
-				break;
-			default:
-				//std::cout << "err: unable to allocate bone to vertex" << std::endl;
-				break;
-
-			}
-		}
+	/*
+	* Same with the running transition applied
+	*/
+	void sampleLocal(float time, const std::vector<bool>* kept, Inertializer& transition)
+	{
+		sampleLocal(time, kept);
+		transition.apply(localPose);
 	}
 
-	for (int i = 0; i < verticesOutput.size(); i++) {
-		glm::vec4& boneWeights = verticesOutput[i].boneWeights;
-		float totalWeight = boneWeights.x + boneWeights.y + boneWeights.z + boneWeights.w;
-		if (totalWeight > 0.0f) {
-			verticesOutput[i].boneWeights = glm::vec4(
-				boneWeights.x / totalWeight,
-				boneWeights.y / totalWeight,
-				boneWeights.z / totalWeight,
-				boneWeights.w / totalWeight
-			);
+	/*
+	* Culling bounds of the clip as drawn, additive layer included, from boneBounds and the
+	* palette of the mode. To call again whenever the layer changes
+	*/
+	void buildBounds()
+	{
+		if (!paletteFromLocal)
+			return;
+		const float duration = library->duration(clip);
+		const bool layered = additiveClip >= 0 && additiveWeight > 0.f;
+		// A layer of another length drifts against the clip, each sample is taken at several of its phases
+		const unsigned int phases = layered && library->duration(additiveClip) != duration ? ADDITIVE_BOUNDS_PHASES : 1;
+		for (unsigned int phase = 0; phase < phases; phase++)
+		{
+			float offset = phase * (layered ? library->duration(additiveClip) : 0.f) / phases;
+			ClipBounds sampled;
+			sampled.build(boneBounds, duration, [this, offset](float time, std::vector<glm::mat4>& palette) {
+				sampleLocal(time, time + offset, nullptr);
+				paletteFromLocal(*this, palette);
+			});
+			if (phase == 0)
+				bounds = sampled;
+			else
+				bounds.extend(sampled);
 		}
 	}
 
-	for (int i = 0; i < mesh->mNumFaces; i++) {
-		aiFace& face = mesh->mFaces[i];
-		for (unsigned int j = 0; j < face.mNumIndices; j++)
-			indicesOutput.push_back(face.mIndices[j]);
-	}
+	Shader shader;
+	Vao vao;
+	Texture texture;
+	// Clip played from the skeleton's library, decoded on demand
+	AnimationLibrary* library;
+	unsigned int clip;
+	Bone skeleton;
+	FlatSkeleton flatSkeleton;
+	GLuint boneCount;
+	glm::mat4 globalInvTr;
+	ClipBounds bounds;
+	// Bind-space extents of each bone, and the palette of the mode built from localPose, for the bounds
+	std::vector<AABB> boneBounds;
+	void (*paletteFromLocal)(AnimPackage& package, std::vector<glm::mat4>& palette);
+	SkeletonLOD skeletonLOD;
+
+	// Local transforms of the last evaluated pose, before the hierarchy
+	LocalPose localPose;
+	// Additive clip of the library layered over the played one, -1 for none
+	int additiveClip;
+	float additiveWeight;
+	LocalPose additivePose;
+	std::vector<float> additiveWeights;
+	// Last evaluated pose, drawn again on frames the budget skips
+	std::vector<glm::mat4> pose;
+	std::vector<glm::fdualquat> dualPose;
+	unsigned int budgetHandle;
+	// Characters drawn together in place of the single one, by the modes that support it
+	std::vector<CrowdInstance> crowd;
+	// Incremented each time pose or dualPose is evaluated
+	unsigned int poseVersion;
+};
 
-	readSkeleton(skeletonOutput, scene->mRootNode, boneInfo);
-}
\ No newline at end of file
+/*
+* Matrix palette of the package's local pose, as the CPU and GPU modes draw it
+*/
+static void matrixPaletteFromLocal(AnimPackage& package, std::vector<glm::mat4>& palette)
+{
+	getPoseFromLocal(package.localPose, package.flatSkeleton, palette, package.globalInvTr);
+}
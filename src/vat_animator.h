@@ -0,0 +1,189 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "utils.h"
+#include "animation.h"
+
+#include "vao.h"
+#include "shader.h"
+#include "shader_variants.h"
+#include "pose.h"
+#include "vertex_animation.h"
+
+// Clip baked for the VAT mode and the buffer texture it is read from
+static VertexAnimation vertexAnimation;
+static GLuint vatBufferId = 0;
+static GLuint vatTextureId = 0;
+
+// Playback rate of the bake made at startup, in frames per unit of animation time
+static const float VAT_FRAME_RATE = 60.f;
+
+static Vao createVertexArrayVAT(std::vector<Vertex>& vertices, std::vector<GLuint> indices) {
+    Vao vao(true);
+
+    GLuint& vboId = vao.vboId();
+    GLuint& eboId = vao.eboId();
+    glGenBuffers(1, &vboId);
+
+    // Positions and normals come from the texture, the bind ones stay for the shared attribute layout
+    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, uv));
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboId);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+
+    vao.setVertexCount(indices.size());
+    vao.unbind();
+
+    return vao;
+}
+
+static glm::mat4 modelMatrixVAT()
+{
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
+    modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 1.0f, 0.0f));
+    return modelMatrix;
+}
+
+/*
+* Culling and frame selection, no GL call: may run on the simulation thread
+*/
+static void VATUpdate(const FrameInput& input, AnimPackage& anim, FrameContext& frame, PoseFrame& out)
+{
+    (void)anim;
+    (void)frame;
+    glm::mat4 projectionMatrix = glm::perspective(glm::radians(input.camera._zoom), input.aspect, 0.01f, 100.0f);
+    glm::mat4 viewMatrix = input.camera.view_matrix();
+    out.viewProjection = projectionMatrix * viewMatrix;
+
+    // Nothing to evaluate: the bake bounds cover the whole clip
+    out.visible = Frustum(out.viewProjection * modelMatrixVAT()).intersects(vertexAnimation.bounds());
+    if (!out.visible)
+        return;
+
+    unsigned int first, second;
+    vertexAnimation.frames(input.time, first, second, out.vatBlend);
+    out.vatFrames = glm::ivec2(first, second);
+}
+
+static void VATDraw(AnimPackage& anim, const PoseFrame& in, FrameContext& frame)
+{
+    glClearColor(0.f, 0.f, 0.f, 1.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (!in.visible)
+        return;
+
+    glm::mat4 modelMatrix = modelMatrixVAT();
+
+    anim.shader.start();
+    anim.shader.loadMatrix4("view_projection_matrix", glm::value_ptr(in.viewProjection));
+    anim.shader.loadMatrix4("model_matrix", glm::value_ptr(modelMatrix));
+    {
+        ProfileScope scope(frame.profiler, ProfileStage::Upload, true);
+        anim.shader.loadIVec2("vat_frames", in.vatFrames);
+        anim.shader.loadFloat("vat_blend", in.vatBlend);
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    anim.texture.load();
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, vatTextureId);
+
+    anim.vao.bind();
+    {
+        ProfileScope scope(frame.profiler, ProfileStage::Draw, true);
+        glDrawElements(GL_TRIANGLES, anim.vao.getVertexCount(), GL_UNSIGNED_INT, 0);
+    }
+    anim.vao.unbind();
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+    anim.shader.stop();
+}
+
+/*
+* Loads the bake from file when given and matching the mesh, bakes the clip otherwise
+*/
+static AnimPackage initVAT(const aiScene* scene, aiMesh* mesh, AnimationLibrary& library, unsigned int clip, ShaderVariants& shaders,
+    const std::string& file = "")
+{
+    std::cout << "Init anim with vertex animation texture" << std::endl;
+
+    std::vector<Vertex> vertices = {};
+    std::vector<GLuint> indices = {};
+    GLuint boneCount = 0;
+    Bone skeleton;
+
+    glm::mat4 globalInverseTransform = assimpToGlmMatrix(scene->mRootNode->mTransformation);
+    globalInverseTransform = glm::inverse(globalInverseTransform);
+
+    loadModel(scene, mesh, vertices, indices, skeleton, boneCount);
+
+    Vao vao = createVertexArrayVAT(vertices, indices);
+
+    SkinningVariant variant;
+    variant.method = SkinningMethod::VAT;
+    Shader shader = shaders.get(variant);
+
+    AnimPackage package(shader, vao, library, clip, skeleton, boneCount, globalInverseTransform);
+
+    bool loaded = !file.empty() && vertexAnimation.load(file);
+    if (loaded && vertexAnimation.vertexCount() != vertices.size())
+    {
+        std::cout << "ERROR::VERTEX_ANIMATION::VERTEX_COUNT " << file << " has " << vertexAnimation.vertexCount()
+            << " vertices, the mesh " << vertices.size() << ", baking instead" << std::endl;
+        loaded = false;
+    }
+    if (!loaded)
+        vertexAnimation.bake(package.animation(), package.flatSkeleton, vertices, boneCount, globalInverseTransform, VAT_FRAME_RATE);
+
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    if (size_t(vertexAnimation.frameCount()) * vertexAnimation.vertexCount() > size_t(maxTexels))
+        std::cout << "WARNING::VERTEX_ANIMATION::TEXTURE_TOO_LARGE " << vertexAnimation.frameCount() << " frames of "
+            << vertexAnimation.vertexCount() << " vertices over the " << maxTexels << " texels of a buffer texture" << std::endl;
+
+    glGenBuffers(1, &vatBufferId);
+    glBindBuffer(GL_TEXTURE_BUFFER, vatBufferId);
+    glBufferData(GL_TEXTURE_BUFFER, vertexAnimation.bytes(), vertexAnimation.texels(), GL_STATIC_DRAW);
+    glGenTextures(1, &vatTextureId);
+    glBindTexture(GL_TEXTURE_BUFFER, vatTextureId);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA16, vatBufferId);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    std::cout << "Vertex animation: " << vertexAnimation.frameCount() << " frames at " << vertexAnimation.frameRate()
+        << " Hz, " << vertexAnimation.bytes() / 1024 << " KB" << std::endl;
+    return package;
+}
+
+/*
+* Constant uniforms of the bake, once the program is linked
+*/
+static void setupVAT(AnimPackage& package)
+{
+    const AABB& bounds = vertexAnimation.bounds();
+    package.shader.start();
+    package.shader.loadInt("vat_texels", 1);
+    package.shader.loadInt("vat_vertex_count", GLint(vertexAnimation.vertexCount()));
+    package.shader.loadVec3("vat_min", bounds.min);
+    package.shader.loadVec3("vat_extent", glm::max(bounds.max - bounds.min, glm::vec3(1e-6f)));
+    package.shader.stop();
+}
+
+static void cleanUpVAT()
+{
+    glDeleteTextures(1, &vatTextureId);
+    glDeleteBuffers(1, &vatBufferId);
+}